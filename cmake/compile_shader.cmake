@@ -0,0 +1,143 @@
+# Compiles a single GLSL shader to SPIR-V, run in script mode by target_add_shaders:
+#   cmake -DGLSLANG=... -DINPUT=... -DOUTPUT=... [-D...] -P compile_shader.cmake
+#
+# On top of plain glslangValidator this
+#  - skips compilation when neither the flags nor the contents of the shader and its
+#    includes changed since the last run, e.g. after switching git branches back and forth,
+#  - bakes specialization constants into variants and, if OPTIMIZE is set,
+#    runs the spirv-opt performance passes and strips debug info,
+#    reporting the instruction count before and after.
+#
+# Lists (INCLUDE_DIRS, DEFINES, SPEC_CONSTANTS) use | as a separator.
+
+cmake_minimum_required(VERSION 3.20)
+
+string(REPLACE "|" ";" INCLUDE_DIRS "${INCLUDE_DIRS}")
+string(REPLACE "|" ";" DEFINES "${DEFINES}")
+string(REPLACE "|" ";" SPEC_CONSTANTS "${SPEC_CONSTANTS}")
+
+cmake_path(GET OUTPUT FILENAME shader_name)
+
+set(depfile "${OUTPUT}.d")
+set(hashfile "${OUTPUT}.hash")
+
+# Everything that influences the result except for the sources themselves
+set(flags "${GLSLANG};${SPIRV_OPT};${INCLUDE_DIRS};${DEFINES};${SPEC_CONSTANTS};${OPTIMIZE};${DEBUG_INFO}")
+
+# Sources are the input and everything it included the last time it was compiled.
+# A new include always means a change to one of the old sources, so this list is never stale.
+function(read_depfile_sources out_var)
+  set(sources "${INPUT}")
+  if(EXISTS "${depfile}")
+    file(READ "${depfile}" contents)
+    string(REPLACE "\\\n" " " contents "${contents}")
+    string(REPLACE "\\ " "<SPACE>" contents "${contents}")
+    string(REGEX MATCHALL "[^ \t\r\n]+" tokens "${contents}")
+    # The first token is the target
+    list(POP_FRONT tokens)
+    foreach(token ${tokens})
+      string(REPLACE "<SPACE>" " " token "${token}")
+      list(APPEND sources "${token}")
+    endforeach()
+  endif()
+  set(${out_var} "${sources}" PARENT_SCOPE)
+endfunction()
+
+function(compute_content_hash out_var)
+  read_depfile_sources(sources)
+  set(hashes "${flags}")
+  foreach(source ${sources})
+    if(NOT EXISTS "${source}")
+      set(${out_var} "" PARENT_SCOPE)
+      return()
+    endif()
+    file(SHA256 "${source}" source_hash)
+    list(APPEND hashes "${source}=${source_hash}")
+  endforeach()
+  string(SHA256 result "${hashes}")
+  set(${out_var} "${result}" PARENT_SCOPE)
+endfunction()
+
+function(count_instructions spirv_path out_var)
+  file(READ "${spirv_path}" hex HEX)
+  string(LENGTH "${hex}" hex_length)
+  # Skip the 5-word header, every word is 8 hex digits
+  set(offset 40)
+  set(count 0)
+  while(offset LESS hex_length)
+    # Little-endian words, the high half of the first word is the instruction's word count
+    math(EXPR hi_offset "${offset} + 6")
+    math(EXPR lo_offset "${offset} + 4")
+    string(SUBSTRING "${hex}" ${hi_offset} 2 hi)
+    string(SUBSTRING "${hex}" ${lo_offset} 2 lo)
+    math(EXPR word_count "0x${hi}${lo}")
+    if(word_count EQUAL 0)
+      break()
+    endif()
+    math(EXPR offset "${offset} + ${word_count} * 8")
+    math(EXPR count "${count} + 1")
+  endwhile()
+  set(${out_var} ${count} PARENT_SCOPE)
+endfunction()
+
+if(EXISTS "${OUTPUT}" AND EXISTS "${hashfile}")
+  compute_content_hash(current_hash)
+  file(READ "${hashfile}" previous_hash)
+  if(current_hash AND current_hash STREQUAL previous_hash)
+    # Let the build system know that the output is up to date
+    file(TOUCH_NOCREATE "${OUTPUT}")
+    message(VERBOSE "${shader_name}: sources unchanged, skipping compilation")
+    return()
+  endif()
+endif()
+
+set(glslang_args)
+foreach(dir ${INCLUDE_DIRS})
+  list(APPEND glslang_args "-I${dir}")
+endforeach()
+foreach(define ${DEFINES})
+  list(APPEND glslang_args "-D${define}")
+endforeach()
+if(DEBUG_INFO)
+  list(APPEND glslang_args "-g")
+endif()
+
+execute_process(
+  COMMAND "${GLSLANG}" ${glslang_args} -V "${INPUT}" -o "${OUTPUT}" --depfile "${depfile}"
+  RESULT_VARIABLE result
+)
+if(NOT result EQUAL 0)
+  file(REMOVE "${OUTPUT}" "${hashfile}")
+  message(FATAL_ERROR "Failed to compile ${INPUT}")
+endif()
+
+set(opt_args)
+if(SPEC_CONSTANTS)
+  list(JOIN SPEC_CONSTANTS " " spec_values)
+  list(APPEND opt_args "--set-spec-const-default-value=${spec_values}" --freeze-spec-const)
+endif()
+if(OPTIMIZE AND SPIRV_OPT)
+  # Descriptor bindings and remaining spec constants are part of the interface
+  # with the application, so they must survive the optimization.
+  list(APPEND opt_args -O --preserve-bindings --preserve-spec-constants --strip-debug)
+endif()
+
+if(opt_args)
+  count_instructions("${OUTPUT}" before)
+
+  execute_process(
+    COMMAND "${SPIRV_OPT}" ${opt_args} "${OUTPUT}" -o "${OUTPUT}"
+    RESULT_VARIABLE result
+  )
+  if(NOT result EQUAL 0)
+    file(REMOVE "${OUTPUT}" "${hashfile}")
+    message(FATAL_ERROR "spirv-opt failed on ${OUTPUT}")
+  endif()
+
+  count_instructions("${OUTPUT}" after)
+  math(EXPR delta "${after} - ${before}")
+  message(STATUS "${shader_name}: ${before} -> ${after} instructions (${delta})")
+endif()
+
+compute_content_hash(new_hash)
+file(WRITE "${hashfile}" "${new_hash}")
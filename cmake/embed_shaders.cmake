@@ -0,0 +1,71 @@
+# Generates a C++ source with the contents of SPIR-V binaries, run in script mode
+# by target_embed_shaders:
+#   cmake -DINPUTS=a.spv|b.spv -DOUTPUT=embedded.cpp -P embed_shaders.cmake
+
+cmake_minimum_required(VERSION 3.20)
+
+string(REPLACE "|" ";" INPUTS "${INPUTS}")
+
+set(arrays "")
+set(entries "")
+set(index 0)
+foreach(input ${INPUTS})
+  cmake_path(GET input FILENAME name)
+  file(READ "${input}" hex HEX)
+  # SPIR-V is a stream of little-endian 32 bit words
+  string(REGEX REPLACE "(..)(..)(..)(..)" "0x\\4\\3\\2\\1u," words "${hex}")
+  string(APPEND arrays "constexpr std::uint32_t SHADER_${index}[] = {${words}};\n")
+  string(APPEND entries "  {\"${name}\", SHADER_${index}},\n")
+  math(EXPR index "${index} + 1")
+endforeach()
+
+file(CONFIGURE OUTPUT "${OUTPUT}" CONTENT [=[
+// Generated by cmake/embed_shaders.cmake, do not edit!
+#include "render_utils/EmbeddedShaders.hpp"
+
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <utility>
+
+
+namespace
+{
+
+@arrays@
+const std::pair<std::string_view, std::span<const std::uint32_t>> SHADERS[] = {
+@entries@};
+
+} // namespace
+
+std::span<const std::uint32_t> find_embedded_shader(std::string_view name)
+{
+  for (const auto& [shaderName, code] : SHADERS)
+    if (shaderName == name)
+      return code;
+  return {};
+}
+
+void write_embedded_shaders(const std::filesystem::path& dir)
+{
+  std::filesystem::create_directories(dir);
+  for (const auto& [shaderName, code] : SHADERS)
+  {
+    const auto path = dir / shaderName;
+    const std::string_view bytes{
+      reinterpret_cast<const char*>(code.data()), code.size_bytes()};
+
+    std::ifstream existing(path, std::ios::binary);
+    if (existing && std::string{std::istreambuf_iterator<char>(existing), {}} == bytes)
+      continue;
+    existing.close();
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+  }
+}
+]=] @ONLY)
+
+# file(CONFIGURE) keeps the old timestamp when nothing changed,
+# which would make the build system regenerate this over and over
+file(TOUCH "${OUTPUT}")
@@ -12,6 +12,11 @@ define_property(TARGET PROPERTY INTERFACE_SHADER_INCLUDE_DIRECTORIES
 )
 
 find_program(glslang_validator glslangValidator)
+# Optional, enables optimized release shaders and specialization constant variants
+find_program(spirv_opt spirv-opt)
+
+set(SHADER_COMPILE_SCRIPT "${CMAKE_CURRENT_LIST_DIR}/compile_shader.cmake")
+set(SHADER_EMBED_SCRIPT "${CMAKE_CURRENT_LIST_DIR}/embed_shaders.cmake")
 
 # Wokrs same way as target_include_directories, i.e. PUBLIC/PRIVATE/INTERFACE are supported
 function(target_shader_include_directories tgt)
@@ -36,31 +41,67 @@ function(target_shader_include_directories tgt)
   endforeach(arg)
 endfunction()
 
+# Adds a command compiling a single GLSL file to SPIR-V, see compile_shader.cmake for details
+function(add_shader_compile_command tgt input_path output_path)
+  cmake_parse_arguments(PARSE_ARGV 3 arg "" "" "DEFINES;SPEC_CONSTANTS")
+
+  if(arg_SPEC_CONSTANTS AND NOT spirv_opt)
+    message(FATAL_ERROR "Shader variant ${output_path} sets specialization constants, but spirv-opt was not found.")
+  endif()
+
+  set(incl_dirs "$<TARGET_GENEX_EVAL:${tgt},$<TARGET_PROPERTY:${tgt},SHADER_INCLUDE_DIRECTORIES>>")
+
+  # NOTE: lists are passed with | as a separator, as ; would split the arguments
+  list(JOIN arg_DEFINES "|" defines)
+  list(JOIN arg_SPEC_CONSTANTS "|" spec_constants)
+  set(compile_args
+    "-DGLSLANG=${glslang_validator}"
+    "-DSPIRV_OPT=${spirv_opt}"
+    "-DINPUT=${input_path}"
+    "-DOUTPUT=${output_path}"
+    "-DINCLUDE_DIRS=$<JOIN:${incl_dirs},|>"
+    "-DDEFINES=${defines}"
+    "-DSPEC_CONSTANTS=${spec_constants}"
+  )
+
+  cmake_path(GET output_path PARENT_PATH output_dir)
+
+  add_custom_command(
+      OUTPUT ${output_path}
+      COMMAND ${CMAKE_COMMAND} -E make_directory ${output_dir}
+      COMMAND ${CMAKE_COMMAND}
+        ${compile_args}
+        "-DOPTIMIZE=$<CONFIG:Release,MinSizeRel>"
+        "-DDEBUG_INFO=$<CONFIG:Debug>"
+        -P ${SHADER_COMPILE_SCRIPT}
+      VERBATIM
+      DEPENDS ${input_path} ${SHADER_COMPILE_SCRIPT}
+      DEPFILE "${output_path}.d"
+    )
+
+  # The same command line, one argument per line, for in-app shader hot reloading.
+  # Hot reloaded binaries replace the built ones, so they must be built with the same flags,
+  # otherwise the build system would take e.g. an unoptimized binary for an up to date one.
+  list(JOIN compile_args "\n" cmd_lines)
+  file(GENERATE
+    OUTPUT "${output_path}.cmd"
+    CONTENT "${CMAKE_COMMAND}\n${cmd_lines}\n-DOPTIMIZE=$<CONFIG:Release,MinSizeRel>\n-DDEBUG_INFO=$<CONFIG:Debug>\n-P\n${SHADER_COMPILE_SCRIPT}\n"
+    TARGET ${tgt}
+  )
+
+  set_property(TARGET ${tgt} APPEND PROPERTY SPIRV_BINARIES ${output_path})
+endfunction()
+
 function(target_add_shaders tgt)
   list(POP_FRONT ${ARGN})
 
   set(shader_binaries_dir "${CMAKE_CURRENT_BINARY_DIR}/shaders/")
 
-  set(incl_dirs "$<TARGET_GENEX_EVAL:${tgt},$<TARGET_PROPERTY:${tgt},SHADER_INCLUDE_DIRECTORIES>>")
-
   foreach(glsl_path ${ARGN})
+    cmake_path(GET glsl_path FILENAME glsl_name)
     set(input_path "${CMAKE_CURRENT_LIST_DIR}/${glsl_path}")
-    set(output_path "${shader_binaries_dir}/$<PATH:GET_FILENAME,${glsl_path}>.spv")
-    add_custom_command(
-        OUTPUT ${output_path}
-        COMMAND ${CMAKE_COMMAND} -E make_directory ${shader_binaries_dir}
-        COMMAND ${glslang_validator}
-          "$<$<BOOL:${incl_dirs}>:-I$<JOIN:${incl_dirs},;-I>>"
-          "$<$<CONFIG:Debug>:-g>"
-          -V
-          ${input_path}
-          -o ${output_path}
-          --depfile "${output_path}.d"
-        VERBATIM
-        COMMAND_EXPAND_LISTS
-        DEPENDS ${input_path}
-        DEPFILE "${output_path}.d"
-      )
+    set(output_path "${shader_binaries_dir}${glsl_name}.spv")
+    add_shader_compile_command(${tgt} ${input_path} ${output_path})
     list(APPEND SPIRV_BINARY_FILES ${output_path})
   endforeach(glsl_path)
 
@@ -79,3 +120,44 @@ function(target_add_shaders tgt)
       PRIVATE $<UPPER_CASE:${tgt}>_SHADERS_ROOT="${shader_binaries_dir}")
   endif()
 endfunction()
+
+# Compiles one more version of an already added shader, e.g.
+#   target_add_shader_variant(app shaders/simple.frag NAME simple_no_shadows
+#     DEFINES NO_SHADOWS SHADOW_SAMPLES=4
+#     SPEC_CONSTANTS 0:1 1:0.5)
+# The result lands next to the other shaders of the target as `<NAME>.spv`.
+# SPEC_CONSTANTS are `<constant_id>:<value>` pairs baked into the SPIR-V with spirv-opt.
+function(target_add_shader_variant tgt glsl_path)
+  cmake_parse_arguments(PARSE_ARGV 2 arg "" "NAME" "DEFINES;SPEC_CONSTANTS")
+
+  if(NOT TARGET ${tgt}_shaders)
+    message(FATAL_ERROR "Call target_add_shaders for ${tgt} before adding shader variants.")
+  endif()
+
+  set(input_path "${CMAKE_CURRENT_LIST_DIR}/${glsl_path}")
+  set(output_path "${CMAKE_CURRENT_BINARY_DIR}/shaders/${arg_NAME}.spv")
+  add_shader_compile_command(${tgt} ${input_path} ${output_path}
+    DEFINES ${arg_DEFINES}
+    SPEC_CONSTANTS ${arg_SPEC_CONSTANTS})
+
+  add_custom_target(${tgt}_shader_${arg_NAME} DEPENDS ${output_path})
+  add_dependencies(${tgt}_shaders ${tgt}_shader_${arg_NAME})
+endfunction()
+
+# Compiles all SPIR-V of the target into the executable itself, accessible through
+# find_embedded_shader from render_utils/EmbeddedShaders.hpp.
+# Must be called after all shaders and variants of the target were added.
+function(target_embed_shaders tgt)
+  get_target_property(binaries ${tgt} SPIRV_BINARIES)
+  set(output_path "${CMAKE_CURRENT_BINARY_DIR}/${tgt}_embedded_shaders.cpp")
+
+  list(JOIN binaries "|" inputs)
+  add_custom_command(
+      OUTPUT ${output_path}
+      COMMAND ${CMAKE_COMMAND} "-DINPUTS=${inputs}" "-DOUTPUT=${output_path}" -P ${SHADER_EMBED_SCRIPT}
+      VERBATIM
+      DEPENDS ${binaries} ${SHADER_EMBED_SCRIPT}
+    )
+
+  target_sources(${tgt} PRIVATE ${output_path})
+endfunction()
@@ -0,0 +1,86 @@
+#include "ProfilerWindow.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <utility>
+
+#include <imgui.h>
+
+
+ProfilerWindow::ProfilerWindow(std::filesystem::path trace_path)
+  : tracePath{std::move(trace_path)}
+{
+}
+
+void ProfilerWindow::draw(GpuProfiler& profiler)
+{
+  ImGui::Begin("GPU profiler");
+
+  if (!profiler.isSupported())
+  {
+    ImGui::TextUnformatted("Timestamp queries are not supported by the device");
+    ImGui::End();
+    return;
+  }
+
+  const auto scopes = profiler.getScopeStats();
+
+  // Bars are relative to the slowest top level scope, i.e. usually the whole frame
+  double longestMs = 0;
+  for (const auto& scope : scopes)
+    if (scope.depth == 0)
+      longestMs = std::max(longestMs, scope.averageMs);
+
+  constexpr ImGuiTableFlags TABLE_FLAGS =
+    ImGuiTableFlags_BordersInnerV | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingStretchProp;
+  if (ImGui::BeginTable("scopes", 3, TABLE_FLAGS))
+  {
+    ImGui::TableSetupColumn("Scope");
+    ImGui::TableSetupColumn("Average, ms");
+    ImGui::TableSetupColumn("Last, ms");
+    ImGui::TableHeadersRow();
+
+    for (const auto& scope : scopes)
+    {
+      ImGui::TableNextRow();
+
+      ImGui::TableNextColumn();
+      // Indenting by 0 means indenting by the default amount in ImGui
+      const float indent = static_cast<float>(scope.depth) * ImGui::GetStyle().IndentSpacing;
+      if (indent > 0)
+        ImGui::Indent(indent);
+      ImGui::TextUnformatted(scope.name.c_str());
+      if (indent > 0)
+        ImGui::Unindent(indent);
+
+      ImGui::TableNextColumn();
+      const float fraction = longestMs > 0 ? static_cast<float>(scope.averageMs / longestMs) : 0;
+      char label[32];
+      std::snprintf(label, sizeof(label), "%.3f", scope.averageMs);
+      ImGui::ProgressBar(fraction, ImVec2(-1, 0), label);
+
+      ImGui::TableNextColumn();
+      ImGui::Text("%.3f", scope.lastMs);
+    }
+
+    ImGui::EndTable();
+  }
+
+  auto& trace = get_trace_capture();
+  if (trace.isCapturing())
+    ImGui::TextUnformatted("Capturing a trace...");
+  else
+  {
+    ImGui::SliderInt("Frames to capture", &captureFrames, 1, 300);
+    if (ImGui::Button("Capture trace"))
+    {
+      // Keeps GPU zones aligned with CPU zones even if the clocks drifted apart
+      profiler.calibrate();
+      trace.start(tracePath, static_cast<std::uint32_t>(captureFrames));
+    }
+    ImGui::SameLine();
+    ImGui::Text("into %s", tracePath.string().c_str());
+  }
+
+  ImGui::End();
+}
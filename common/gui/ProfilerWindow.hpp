@@ -0,0 +1,23 @@
+#pragma once
+
+#include <filesystem>
+
+#include "profiling/GpuProfiler.hpp"
+
+
+/**
+ * ImGui window listing the GPU profiler's scopes as an indented tree with their
+ * last and average timings, plus a button that captures a Chrome trace of the next
+ * few frames. Must be drawn between ImGui::NewFrame and ImGui::Render.
+ */
+class ProfilerWindow
+{
+public:
+  explicit ProfilerWindow(std::filesystem::path trace_path = "trace.json");
+
+  void draw(GpuProfiler& profiler);
+
+private:
+  std::filesystem::path tracePath;
+  int captureFrames = 30;
+};
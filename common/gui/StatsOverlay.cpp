@@ -0,0 +1,147 @@
+#include "StatsOverlay.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <numeric>
+#include <string_view>
+
+#include <etna/GlobalContext.hpp>
+#include <imgui.h>
+
+
+static double to_mib(vk::DeviceSize bytes)
+{
+  return static_cast<double>(bytes) / (1024.0 * 1024.0);
+}
+
+void StatsOverlay::endFrame(const RenderStats& stats, const GpuProfiler& profiler)
+{
+  const auto now = std::chrono::steady_clock::now();
+  // There is nothing to measure against on the very first frame
+  const std::chrono::duration<float, std::milli> frameTime =
+    lastFrameEnd == std::chrono::steady_clock::time_point{} ? now - now : now - lastFrameEnd;
+  lastFrameEnd = now;
+
+  lastStats = stats;
+
+  historyOffset = (historyOffset + 1) % HISTORY_SIZE;
+  cpuFrameMs[historyOffset] = frameTime.count();
+
+  // GPU timings arrive late and not necessarily every frame, repeat the last one meanwhile
+  float gpuMs = gpuFrameMs[(historyOffset + HISTORY_SIZE - 1) % HISTORY_SIZE];
+  if (const auto gpuFrame = profiler.getResolvedFrame(); gpuFrame != lastGpuFrame)
+  {
+    lastGpuFrame = gpuFrame;
+    gpuMs = 0;
+    for (const auto& timing : profiler.getResolvedTimings())
+      if (timing.depth == 0)
+        gpuMs += static_cast<float>(timing.durationMs);
+  }
+  gpuFrameMs[historyOffset] = gpuMs;
+}
+
+void StatsOverlay::draw(const GpuProfiler& profiler)
+{
+  if (!visible)
+    return;
+
+  constexpr ImGuiWindowFlags WINDOW_FLAGS = ImGuiWindowFlags_NoDecoration |
+    ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoFocusOnAppearing |
+    ImGuiWindowFlags_NoNav;
+
+  ImGui::SetNextWindowPos(ImVec2(10, 10), ImGuiCond_FirstUseEver);
+  ImGui::SetNextWindowBgAlpha(0.75f);
+  if (!ImGui::Begin("Stats", &visible, WINDOW_FLAGS))
+  {
+    ImGui::End();
+    return;
+  }
+
+  // The history is a ring buffer, the oldest sample is right after the newest one
+  const int plotOffset = static_cast<int>((historyOffset + 1) % HISTORY_SIZE);
+  const auto drawGraph = [plotOffset](const char* label, const auto& history) {
+    const float avg = std::accumulate(history.begin(), history.end(), 0.0f) / HISTORY_SIZE;
+    const float max = *std::max_element(history.begin(), history.end());
+    char overlay[64];
+    std::snprintf(overlay, sizeof(overlay), "avg %.2f ms, max %.2f ms", avg, max);
+    ImGui::PlotLines(
+      label,
+      history.data(),
+      static_cast<int>(history.size()),
+      plotOffset,
+      overlay,
+      0.0f,
+      std::max(max * 1.2f, 1.0f),
+      ImVec2(240, 40));
+  };
+  drawGraph("CPU", cpuFrameMs);
+  if (profiler.isSupported())
+    drawGraph("GPU", gpuFrameMs);
+
+  ImGui::Separator();
+  ImGui::Text("Draw calls:      %u", lastStats.drawCalls);
+  ImGui::Text("Instances:       %u", lastStats.instances);
+  ImGui::Text("Triangles:       %llu", static_cast<unsigned long long>(lastStats.triangles));
+  ImGui::Text("Pipeline binds:  %u", lastStats.pipelineBinds);
+  ImGui::Text("Desc. binds:     %u", lastStats.descriptorBinds);
+  ImGui::Text("Uploaded:        %.1f KiB", static_cast<double>(lastStats.bytesUploaded) / 1024.0);
+
+  if (profiler.isSupported() && !profiler.getScopeStats().empty())
+  {
+    ImGui::Separator();
+    for (const auto& scope : profiler.getScopeStats())
+      if (scope.depth <= 1)
+        ImGui::Text(
+          "%s%-16s %6.3f ms", scope.depth == 0 ? "" : "  ", scope.name.c_str(), scope.averageMs);
+  }
+
+  ImGui::Separator();
+  drawMemoryBudgets();
+
+  ImGui::End();
+}
+
+void StatsOverlay::drawMemoryBudgets()
+{
+  auto& ctx = etna::get_context();
+  const auto physicalDevice = ctx.getPhysicalDevice();
+
+  // VMA reads its budgets from the same extension, querying it directly does not need
+  // access to etna's allocator and also accounts for memory allocated outside of it.
+  if (!memoryBudgetSupported.has_value())
+  {
+    const auto extensions =
+      etna::unwrap_vk_result(physicalDevice.enumerateDeviceExtensionProperties());
+    memoryBudgetSupported =
+      std::any_of(extensions.begin(), extensions.end(), [](const vk::ExtensionProperties& ext) {
+        return std::string_view{ext.extensionName} == VK_EXT_MEMORY_BUDGET_EXTENSION_NAME;
+      });
+  }
+  const bool budgetSupported = *memoryBudgetSupported;
+
+  vk::PhysicalDeviceMemoryBudgetPropertiesEXT budget;
+  vk::PhysicalDeviceMemoryProperties2 properties;
+  if (budgetSupported)
+    properties.pNext = &budget;
+  physicalDevice.getMemoryProperties2(&properties);
+
+  const auto& memory = properties.memoryProperties;
+  for (std::uint32_t heap = 0; heap < memory.memoryHeapCount; ++heap)
+  {
+    const bool deviceLocal =
+      static_cast<bool>(memory.memoryHeaps[heap].flags & vk::MemoryHeapFlagBits::eDeviceLocal);
+    if (budgetSupported)
+      ImGui::Text(
+        "Heap %u (%s): %.0f / %.0f MiB",
+        heap,
+        deviceLocal ? "device" : "host",
+        to_mib(budget.heapUsage[heap]),
+        to_mib(budget.heapBudget[heap]));
+    else
+      ImGui::Text(
+        "Heap %u (%s): %.0f MiB, usage unknown",
+        heap,
+        deviceLocal ? "device" : "host",
+        to_mib(memory.memoryHeaps[heap].size));
+  }
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+#include "render_utils/RenderStats.hpp"
+#include "profiling/GpuProfiler.hpp"
+
+
+/**
+ * Compact ImGui panel with the renderer's per-frame counters, GPU time of the profiler's
+ * top level scopes, device memory budgets and graphs of recent frame times.
+ *
+ * Collecting a frame is a handful of stores into ring buffers, everything else,
+ * including querying memory budgets, only happens while the panel is visible.
+ */
+class StatsOverlay
+{
+public:
+  static constexpr std::size_t HISTORY_SIZE = 240;
+
+  // Call once per frame, CPU frame time is measured between consecutive calls
+  void endFrame(const RenderStats& stats, const GpuProfiler& profiler);
+
+  // Must be called between ImGui::NewFrame and ImGui::Render
+  void draw(const GpuProfiler& profiler);
+
+  void toggle() { visible = !visible; }
+  bool isVisible() const { return visible; }
+
+private:
+  void drawMemoryBudgets();
+
+private:
+  bool visible = false;
+
+  RenderStats lastStats;
+  std::chrono::steady_clock::time_point lastFrameEnd;
+
+  std::array<float, HISTORY_SIZE> cpuFrameMs{};
+  std::array<float, HISTORY_SIZE> gpuFrameMs{};
+  std::size_t historyOffset = 0;
+  std::optional<std::uint64_t> lastGpuFrame;
+
+  std::optional<bool> memoryBudgetSupported;
+};
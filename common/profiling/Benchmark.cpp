@@ -0,0 +1,150 @@
+#include "Benchmark.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <fstream>
+#include <numeric>
+
+#include <etna/Assert.hpp>
+#include <fmt/format.h>
+#include <fmt/std.h>
+#include <spdlog/spdlog.h>
+
+
+BenchmarkOptions parse_benchmark_options(int argc, char** argv)
+{
+  BenchmarkOptions result;
+
+  const auto nextArg = [&](int& i, std::string_view option) -> std::string_view {
+    ETNA_VERIFYF(i + 1 < argc, "{} expects a value", option);
+    return argv[++i];
+  };
+
+  for (int i = 1; i < argc; ++i)
+  {
+    const std::string_view arg = argv[i];
+
+    if (arg == "--benchmark")
+      result.cameraPath = nextArg(i, arg);
+    else if (arg == "--report")
+      result.reportPath = nextArg(i, arg);
+    else if (arg == "--trace")
+      result.tracePath = nextArg(i, arg);
+    else if (arg == "--record-path")
+      result.recordPath = nextArg(i, arg);
+    else if (arg == "--warmup")
+    {
+      const std::string_view value = nextArg(i, arg);
+      const auto [end, errc] =
+        std::from_chars(value.data(), value.data() + value.size(), result.warmupFrames);
+      ETNA_VERIFYF(
+        errc == std::errc{} && end == value.data() + value.size(),
+        "--warmup expects a frame count, got '{}'",
+        value);
+    }
+  }
+
+  return result;
+}
+
+void BenchmarkReport::addSample(std::string_view metric, double value)
+{
+  auto it = std::find_if(
+    metrics.begin(), metrics.end(), [metric](const Metric& m) { return m.name == metric; });
+  if (it == metrics.end())
+    it = metrics.insert(metrics.end(), Metric{.name = std::string{metric}, .samples = {}});
+
+  it->samples.push_back(value);
+}
+
+BenchmarkReport::Summary BenchmarkReport::summarize(std::vector<double> samples)
+{
+  if (samples.empty())
+    return Summary{};
+
+  std::sort(samples.begin(), samples.end());
+
+  // Nearest-rank percentiles, these are always values that were actually observed
+  const auto percentile = [&samples](double p) {
+    const auto rank = static_cast<std::size_t>(std::ceil(p / 100.0 * samples.size()));
+    return samples[std::clamp<std::size_t>(rank, 1, samples.size()) - 1];
+  };
+
+  return Summary{
+    .count = samples.size(),
+    .mean = std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size(),
+    .min = samples.front(),
+    .p50 = percentile(50),
+    .p95 = percentile(95),
+    .p99 = percentile(99),
+    .max = samples.back(),
+  };
+}
+
+void BenchmarkReport::write(const std::filesystem::path& path) const
+{
+  std::vector<Summary> summaries;
+  summaries.reserve(metrics.size());
+  for (const auto& metric : metrics)
+    summaries.push_back(summarize(metric.samples));
+
+  for (std::size_t i = 0; i < metrics.size(); ++i)
+    spdlog::info(
+      "{}: p50 {:.3f}, p95 {:.3f}, p99 {:.3f}",
+      metrics[i].name,
+      summaries[i].p50,
+      summaries[i].p95,
+      summaries[i].p99);
+
+  if (!path.parent_path().empty())
+    std::filesystem::create_directories(path.parent_path());
+
+  auto csvPath = path;
+  csvPath += ".csv";
+  std::ofstream csv(csvPath);
+  ETNA_VERIFYF(csv.is_open(), "Unable to write benchmark report {}", csvPath);
+
+  csv << "metric,count,mean,min,p50,p95,p99,max\n";
+  for (std::size_t i = 0; i < metrics.size(); ++i)
+  {
+    const auto& s = summaries[i];
+    csv << fmt::format(
+      "{},{},{},{},{},{},{},{}\n",
+      metrics[i].name,
+      s.count,
+      s.mean,
+      s.min,
+      s.p50,
+      s.p95,
+      s.p99,
+      s.max);
+  }
+
+  auto jsonPath = path;
+  jsonPath += ".json";
+  std::ofstream json(jsonPath);
+  ETNA_VERIFYF(json.is_open(), "Unable to write benchmark report {}", jsonPath);
+
+  // Metric names are generated by us and never need escaping
+  json << "{\n  \"metrics\": {";
+  for (std::size_t i = 0; i < metrics.size(); ++i)
+  {
+    const auto& s = summaries[i];
+    json << fmt::format(
+      "{}\n    \"{}\": {{\"count\": {}, \"mean\": {}, \"min\": {}, \"p50\": {}, \"p95\": {}, "
+      "\"p99\": {}, \"max\": {}}}",
+      i == 0 ? "" : ",",
+      metrics[i].name,
+      s.count,
+      s.mean,
+      s.min,
+      s.p50,
+      s.p95,
+      s.p99,
+      s.max);
+  }
+  json << "\n  }\n}\n";
+
+  spdlog::info("Benchmark report written to {} and {}", csvPath, jsonPath);
+}
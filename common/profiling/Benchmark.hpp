@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+/**
+ * Command line switches of the camera path benchmark:
+ *   --benchmark PATH     replay the camera path stored in PATH and report timings
+ *   --report PATH        where to write the report, .csv and .json are appended
+ *   --warmup N           frames rendered at the start of the path before measuring
+ *   --trace PATH         also capture a Chrome trace of all measured frames into PATH
+ *   --record-path PATH   interactive mode only, allows recording a camera path into PATH
+ */
+struct BenchmarkOptions
+{
+  std::filesystem::path cameraPath;
+  std::filesystem::path reportPath = "benchmark";
+  std::uint32_t warmupFrames = 10;
+  std::filesystem::path tracePath;
+  std::filesystem::path recordPath;
+  // The path is replayed with a fixed time step, so every run renders the same frames
+  float timeStep = 1.0f / 60.0f;
+
+  bool enabled() const { return !cameraPath.empty(); }
+};
+
+// Unknown arguments are ignored, malformed known ones are fatal
+BenchmarkOptions parse_benchmark_options(int argc, char** argv);
+
+/**
+ * Collects per-frame samples of named metrics and summarizes them with percentiles.
+ * Metrics are reported in order of their first appearance.
+ */
+class BenchmarkReport
+{
+public:
+  struct Summary
+  {
+    std::size_t count;
+    double mean;
+    double min;
+    double p50;
+    double p95;
+    double p99;
+    double max;
+  };
+
+  void addSample(std::string_view metric, double value);
+
+  // Logs a short summary, and writes all of the summaries into path.csv and path.json
+  void write(const std::filesystem::path& path) const;
+
+private:
+  struct Metric
+  {
+    std::string name;
+    std::vector<double> samples;
+  };
+
+  static Summary summarize(std::vector<double> samples);
+
+private:
+  std::vector<Metric> metrics;
+};
@@ -0,0 +1,304 @@
+#include "GpuProfiler.hpp"
+
+#include <algorithm>
+#include <utility>
+
+#include <etna/GlobalContext.hpp>
+#include <spdlog/spdlog.h>
+
+
+GpuProfiler::Scope::Scope(
+  GpuProfiler& gpu_profiler, vk::CommandBuffer cmd_buf, std::string_view name)
+  : profiler{gpu_profiler}
+  , cmdBuf{cmd_buf}
+{
+  profiler.beginScope(cmdBuf, name);
+}
+
+GpuProfiler::Scope::~Scope()
+{
+  profiler.endScope(cmdBuf);
+}
+
+GpuProfiler::GpuProfiler(std::uint32_t max_scopes_per_frame)
+  : maxScopes{max_scopes_per_frame}
+{
+  auto& ctx = etna::get_context();
+
+  const auto queueFamilies = ctx.getPhysicalDevice().getQueueFamilyProperties();
+  const std::uint32_t validBits = queueFamilies[ctx.getQueueFamilyIdx()].timestampValidBits;
+  if (validBits == 0)
+  {
+    spdlog::warn("GPU profiler: the queue does not support timestamps, timings are disabled");
+    return;
+  }
+
+  timestampPeriodNs = ctx.getPhysicalDevice().getProperties().limits.timestampPeriod;
+  timestampMask = validBits >= 64 ? ~std::uint64_t{0} : (std::uint64_t{1} << validBits) - 1;
+  timestampShift = 64 - std::min(validBits, 64u);
+
+  frames.resize(ctx.getMainWorkCount().multiBufferingCount());
+  for (auto& frame : frames)
+    frame.pool =
+      etna::unwrap_vk_result(ctx.getDevice().createQueryPoolUnique(vk::QueryPoolCreateInfo{
+        .queryType = vk::QueryType::eTimestamp,
+        .queryCount = 2 * maxScopes,
+      }));
+
+  calibrate();
+}
+
+void GpuProfiler::calibrate()
+{
+  if (!isSupported())
+    return;
+
+  auto& ctx = etna::get_context();
+  auto device = ctx.getDevice();
+
+  auto queryPool = etna::unwrap_vk_result(device.createQueryPoolUnique(vk::QueryPoolCreateInfo{
+    .queryType = vk::QueryType::eTimestamp,
+    .queryCount = 1,
+  }));
+  auto cmdPool = etna::unwrap_vk_result(device.createCommandPoolUnique(vk::CommandPoolCreateInfo{
+    .flags = vk::CommandPoolCreateFlagBits::eTransient,
+    .queueFamilyIndex = ctx.getQueueFamilyIdx(),
+  }));
+  auto cmdBufs =
+    etna::unwrap_vk_result(device.allocateCommandBuffersUnique(vk::CommandBufferAllocateInfo{
+      .commandPool = cmdPool.get(),
+      .level = vk::CommandBufferLevel::ePrimary,
+      .commandBufferCount = 1,
+    }));
+  const vk::CommandBuffer cmdBuf = cmdBufs.front().get();
+
+  ETNA_CHECK_VK_RESULT(cmdBuf.begin(vk::CommandBufferBeginInfo{
+    .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit,
+  }));
+  cmdBuf.resetQueryPool(queryPool.get(), 0, 1);
+  cmdBuf.writeTimestamp2(vk::PipelineStageFlagBits2::eAllCommands, queryPool.get(), 0);
+  ETNA_CHECK_VK_RESULT(cmdBuf.end());
+
+  auto fence = etna::unwrap_vk_result(device.createFenceUnique(vk::FenceCreateInfo{}));
+
+  // Frames in flight would delay the timestamp by up to a few frames
+  ETNA_CHECK_VK_RESULT(ctx.getQueue().waitIdle());
+
+  const auto submitted = TraceCapture::Clock::now();
+  ETNA_CHECK_VK_RESULT(ctx.getQueue().submit(
+    vk::SubmitInfo{
+      .commandBufferCount = 1,
+      .pCommandBuffers = &cmdBuf,
+    },
+    fence.get()));
+  ETNA_CHECK_VK_RESULT(device.waitForFences({fence.get()}, VK_TRUE, UINT64_MAX));
+  const auto finished = TraceCapture::Clock::now();
+
+  ETNA_CHECK_VK_RESULT(device.getQueryPoolResults(
+    queryPool.get(),
+    0,
+    1,
+    sizeof(calibrationTimestamp),
+    &calibrationTimestamp,
+    sizeof(calibrationTimestamp),
+    vk::QueryResultFlagBits::e64));
+
+  // The timestamp was written somewhere in between. The queue was idle, so this is only
+  // a submission round trip apart, well below a millisecond.
+  calibrationTime = submitted + (finished - submitted) / 2;
+}
+
+TraceCapture::Clock::time_point GpuProfiler::toCpuTime(std::uint64_t timestamp) const
+{
+  // Sign-extended, timestamps of frames resolved after a recalibration may precede it
+  const auto ticks =
+    static_cast<std::int64_t>((timestamp - calibrationTimestamp) << timestampShift) >>
+    timestampShift;
+  const std::chrono::duration<double, std::nano> offset{
+    static_cast<double>(ticks) * timestampPeriodNs};
+  return calibrationTime + std::chrono::duration_cast<TraceCapture::Clock::duration>(offset);
+}
+
+double GpuProfiler::getAverageMs(std::string_view name) const
+{
+  const auto it = std::find_if(scopeStats.begin(), scopeStats.end(), [name](const ScopeStats& s) {
+    return s.name == name;
+  });
+  return it == scopeStats.end() ? 0.0 : it->averageMs;
+}
+
+GpuProfiler::FrameQueries& GpuProfiler::currentFrame()
+{
+  return frames[etna::get_context().getMainWorkCount().batchIndex()];
+}
+
+void GpuProfiler::beginFrame(vk::CommandBuffer cmd_buf)
+{
+  if (!isSupported())
+    return;
+
+  ETNA_VERIFYF(openScopes.empty(), "GPU profiler scopes must not cross frame boundaries!");
+
+  auto& frame = currentFrame();
+  resolve(frame);
+
+  cmd_buf.resetQueryPool(frame.pool.get(), 0, 2 * maxScopes);
+  frame.scopes.clear();
+  frame.queryCount = 0;
+  frame.frameIndex = frameCount++;
+  frame.traced = get_trace_capture().beginGpuFrame();
+}
+
+void GpuProfiler::resolveFramesInFlight()
+{
+  if (!isSupported())
+    return;
+
+  std::vector<FrameQueries*> inFlight;
+  for (auto& frame : frames)
+    inFlight.push_back(&frame);
+  std::sort(inFlight.begin(), inFlight.end(), [](const FrameQueries* a, const FrameQueries* b) {
+    return a->frameIndex < b->frameIndex;
+  });
+
+  // Oldest first, so that the latest frame ends up being the resolved one
+  for (auto* frame : inFlight)
+  {
+    resolve(*frame);
+    frame->scopes.clear();
+    frame->queryCount = 0;
+  }
+}
+
+void GpuProfiler::beginScope(vk::CommandBuffer cmd_buf, std::string_view name)
+{
+  if (!isSupported())
+    return;
+
+  auto& frame = currentFrame();
+
+  // An overflowing scope is still pushed so that endScope stays balanced,
+  // but it is not measured.
+  if (frame.queryCount + 2 > 2 * maxScopes)
+  {
+    if (!std::exchange(overflowReported, true))
+      spdlog::warn("GPU profiler: more than {} scopes in a frame, ignoring the rest", maxScopes);
+    openScopes.push_back(~std::uint32_t{0});
+    return;
+  }
+
+  openScopes.push_back(static_cast<std::uint32_t>(frame.scopes.size()));
+  frame.scopes.push_back(PendingScope{
+    .name = std::string{name},
+    .depth = static_cast<std::uint32_t>(openScopes.size() - 1),
+    .beginQuery = frame.queryCount++,
+    .endQuery = 0,
+  });
+
+  cmd_buf.writeTimestamp2(
+    vk::PipelineStageFlagBits2::eAllCommands, frame.pool.get(), frame.scopes.back().beginQuery);
+}
+
+void GpuProfiler::endScope(vk::CommandBuffer cmd_buf)
+{
+  if (!isSupported())
+    return;
+
+  ETNA_VERIFYF(!openScopes.empty(), "GPU profiler scope ended without being begun!");
+
+  const std::uint32_t scopeIdx = openScopes.back();
+  openScopes.pop_back();
+
+  if (scopeIdx == ~std::uint32_t{0})
+    return;
+
+  auto& frame = currentFrame();
+  auto& scope = frame.scopes[scopeIdx];
+  scope.endQuery = frame.queryCount++;
+
+  cmd_buf.writeTimestamp2(
+    vk::PipelineStageFlagBits2::eAllCommands, frame.pool.get(), scope.endQuery);
+}
+
+void GpuProfiler::resolve(FrameQueries& frame)
+{
+  // Whatever happens below, the frame is done with as far as the trace is concerned
+  const bool traced = std::exchange(frame.traced, false);
+  auto& trace = get_trace_capture();
+  auto endTracedFrame = [&trace, traced]() {
+    if (traced)
+      trace.endGpuFrame();
+  };
+
+  if (frame.queryCount == 0)
+  {
+    endTracedFrame();
+    return;
+  }
+
+  std::vector<std::uint64_t> timestamps(frame.queryCount);
+  const auto result = etna::get_context().getDevice().getQueryPoolResults(
+    frame.pool.get(),
+    0,
+    frame.queryCount,
+    timestamps.size() * sizeof(std::uint64_t),
+    timestamps.data(),
+    sizeof(std::uint64_t),
+    vk::QueryResultFlagBits::e64);
+
+  // The frame's fence has been waited on, so this only happens if it was never submitted
+  if (result != vk::Result::eSuccess)
+  {
+    endTracedFrame();
+    return;
+  }
+
+  const auto toMs = [this](std::uint64_t ticks) {
+    return static_cast<double>(ticks & timestampMask) * timestampPeriodNs * 1e-6;
+  };
+
+  const std::uint64_t frameBegin = timestamps[frame.scopes.front().beginQuery];
+
+  resolved.clear();
+  for (const auto& scope : frame.scopes)
+    resolved.push_back(ScopeTiming{
+      .name = scope.name,
+      .depth = scope.depth,
+      .beginMs = toMs(timestamps[scope.beginQuery] - frameBegin),
+      .durationMs = toMs(timestamps[scope.endQuery] - timestamps[scope.beginQuery]),
+    });
+
+  resolvedFrame = frame.frameIndex;
+
+  updateStats();
+
+  if (traced)
+    for (const auto& scope : frame.scopes)
+      trace.addGpuZone(
+        scope.name,
+        toCpuTime(timestamps[scope.beginQuery]),
+        toCpuTime(timestamps[scope.endQuery]));
+  endTracedFrame();
+}
+
+void GpuProfiler::updateStats()
+{
+  scopeStats.clear();
+
+  for (const auto& timing : resolved)
+  {
+    auto& history = histories[timing.name];
+
+    auto& sample = history.samples[history.count % AVERAGE_WINDOW];
+    history.sum += timing.durationMs - sample;
+    sample = timing.durationMs;
+    ++history.count;
+
+    scopeStats.push_back(ScopeStats{
+      .name = timing.name,
+      .depth = timing.depth,
+      .lastMs = timing.durationMs,
+      .averageMs = history.sum / static_cast<double>(std::min(history.count, AVERAGE_WINDOW)),
+    });
+  }
+}
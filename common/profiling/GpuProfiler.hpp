@@ -0,0 +1,157 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <etna/Vulkan.hpp>
+
+#include "profiling/TraceCapture.hpp"
+
+
+/**
+ * Measures GPU time of named scopes with timestamp queries. Every frame in flight
+ * has its own query pool, and results of a frame are read when its slot comes around
+ * again, i.e. after the command manager waited for its fence, so reading them never
+ * stalls. Timings therefore lag behind by the amount of frames in flight.
+ *
+ * Scopes may be nested, but must not cross frame boundaries. When the queue does not
+ * support timestamps, all calls are no-ops and no timings are ever resolved.
+ *
+ * Besides the timings of the last resolved frame, averages over a window of recent frames
+ * are kept per scope name. Scopes of frames begun while a trace is being captured are also
+ * handed over to the TraceCapture once resolved, converted into the CPU clock domain.
+ */
+class GpuProfiler
+{
+public:
+  struct ScopeTiming
+  {
+    std::string name;
+    std::uint32_t depth;
+    // Relative to the start of the first scope of the frame
+    double beginMs;
+    double durationMs;
+  };
+
+  // Averages are keyed by scope name, so names should be unique within a frame
+  struct ScopeStats
+  {
+    std::string name;
+    std::uint32_t depth;
+    double lastMs;
+    double averageMs;
+  };
+
+  // Amount of frames that averages are computed over
+  static constexpr std::size_t AVERAGE_WINDOW = 64;
+
+  // Convenience RAII wrapper around beginScope/endScope
+  class Scope
+  {
+  public:
+    Scope(GpuProfiler& profiler, vk::CommandBuffer cmd_buf, std::string_view name);
+    ~Scope();
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+  private:
+    GpuProfiler& profiler;
+    vk::CommandBuffer cmdBuf;
+  };
+
+  explicit GpuProfiler(std::uint32_t max_scopes_per_frame = 64);
+
+  GpuProfiler(const GpuProfiler&) = delete;
+  GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+  bool isSupported() const { return timestampPeriodNs > 0; }
+
+  // Must be called at the very start of the frame's primary command buffer, after the
+  // per-frame command manager waited for the previous submission of the current slot.
+  void beginFrame(vk::CommandBuffer cmd_buf);
+
+  // Resolves the frames that are still in flight, so that a running trace capture gets
+  // their zones too. The GPU must be idle, e.g. call this right before shutting down.
+  void resolveFramesInFlight();
+
+  // Only valid outside of render passes of primary command buffers
+  void beginScope(vk::CommandBuffer cmd_buf, std::string_view name);
+  void endScope(vk::CommandBuffer cmd_buf);
+
+  // Timings of the most recently resolved frame, in order of scope begins
+  std::span<const ScopeTiming> getResolvedTimings() const { return resolved; }
+  // Index of the frame the resolved timings belong to, frames are counted by beginFrame
+  std::optional<std::uint64_t> getResolvedFrame() const { return resolvedFrame; }
+  std::uint64_t getFrameCount() const { return frameCount; }
+
+  // Scopes of the most recently resolved frame with their rolling averages
+  std::span<const ScopeStats> getScopeStats() const { return scopeStats; }
+  // 0 for scopes that were never resolved
+  double getAverageMs(std::string_view name) const;
+
+  // Measures the offset between GPU timestamps and the CPU clock by waiting for a single
+  // timestamp on the queue. Done on creation, redo it before long captures to avoid drift.
+  // Waits for the queue to become idle first, so it costs the frames in flight.
+  void calibrate();
+
+private:
+  struct PendingScope
+  {
+    std::string name;
+    std::uint32_t depth;
+    std::uint32_t beginQuery;
+    std::uint32_t endQuery;
+  };
+
+  struct History
+  {
+    std::array<double, AVERAGE_WINDOW> samples{};
+    std::size_t count = 0;
+    double sum = 0;
+  };
+
+  struct FrameQueries
+  {
+    vk::UniqueQueryPool pool;
+    std::vector<PendingScope> scopes;
+    std::uint32_t queryCount = 0;
+    std::uint64_t frameIndex = 0;
+    // Began while a trace was being captured, see TraceCapture::beginGpuFrame
+    bool traced = false;
+  };
+
+  void resolve(FrameQueries& frame);
+  void updateStats();
+  FrameQueries& currentFrame();
+  TraceCapture::Clock::time_point toCpuTime(std::uint64_t timestamp) const;
+
+private:
+  std::uint32_t maxScopes;
+  double timestampPeriodNs = 0;
+  std::uint64_t timestampMask = 0;
+  std::uint32_t timestampShift = 0;
+
+  // One per frame in flight, indexed by the batch index of the main work count
+  std::vector<FrameQueries> frames;
+  // Indices into the scopes of the current frame
+  std::vector<std::uint32_t> openScopes;
+  bool overflowReported = false;
+
+  std::uint64_t frameCount = 0;
+  std::vector<ScopeTiming> resolved;
+  std::optional<std::uint64_t> resolvedFrame;
+
+  std::unordered_map<std::string, History> histories;
+  std::vector<ScopeStats> scopeStats;
+
+  // A GPU timestamp and the CPU time it was taken at, measured by calibrate()
+  std::uint64_t calibrationTimestamp = 0;
+  TraceCapture::Clock::time_point calibrationTime;
+};
@@ -0,0 +1,169 @@
+#include "TraceCapture.hpp"
+
+#include <algorithm>
+#include <fstream>
+
+#include <etna/Assert.hpp>
+#include <fmt/format.h>
+#include <fmt/std.h>
+#include <spdlog/spdlog.h>
+
+#include "threading/ThreadPool.hpp"
+
+
+static std::string escape_json(std::string_view str)
+{
+  std::string result;
+  result.reserve(str.size());
+  for (char c : str)
+  {
+    if (c == '"' || c == '\\')
+      result.push_back('\\');
+    result.push_back(c);
+  }
+  return result;
+}
+
+TraceCapture& get_trace_capture()
+{
+  static TraceCapture capture;
+  return capture;
+}
+
+void TraceCapture::start(std::filesystem::path path, std::uint32_t frame_count)
+{
+  if (isCapturing())
+  {
+    spdlog::warn("A trace is already being captured into {}", outputPath);
+    return;
+  }
+
+  outputPath = std::move(path);
+  framesLeft = std::max(frame_count, 1u);
+  recordingCpu.store(true, std::memory_order_relaxed);
+}
+
+void TraceCapture::endFrame()
+{
+  if (!isRecordingCpu() || --framesLeft > 0)
+    return;
+
+  recordingCpu.store(false, std::memory_order_relaxed);
+  if (pendingGpuFrames == 0)
+    write();
+}
+
+bool TraceCapture::beginGpuFrame()
+{
+  if (!isRecordingCpu())
+    return false;
+
+  ++pendingGpuFrames;
+  return true;
+}
+
+void TraceCapture::endGpuFrame()
+{
+  ETNA_VERIFYF(pendingGpuFrames > 0, "A GPU frame ended without being begun!");
+
+  if (--pendingGpuFrames == 0 && !isRecordingCpu())
+    write();
+}
+
+void TraceCapture::addCpuZone(std::string_view name, Clock::time_point begin, Clock::time_point end)
+{
+  std::lock_guard lock{zonesMutex};
+  zones.push_back(Zone{
+    .name = std::string{name},
+    .gpu = false,
+    .thread = ThreadPool::current_thread_index(),
+    .begin = begin,
+    .end = end,
+  });
+}
+
+void TraceCapture::addGpuZone(std::string_view name, Clock::time_point begin, Clock::time_point end)
+{
+  std::lock_guard lock{zonesMutex};
+  zones.push_back(Zone{
+    .name = std::string{name},
+    .gpu = true,
+    .thread = 0,
+    .begin = begin,
+    .end = end,
+  });
+}
+
+void TraceCapture::write()
+{
+  std::vector<Zone> captured;
+  {
+    std::lock_guard lock{zonesMutex};
+    captured = std::exchange(zones, {});
+  }
+
+  if (captured.empty())
+  {
+    spdlog::warn("No zones were captured, not writing {}", outputPath);
+    return;
+  }
+
+  const auto origin =
+    std::min_element(captured.begin(), captured.end(), [](const Zone& a, const Zone& b) {
+      return a.begin < b.begin;
+    })->begin;
+  const auto toUs = [origin](Clock::time_point time) {
+    return std::chrono::duration<double, std::micro>(time - origin).count();
+  };
+
+  if (!outputPath.parent_path().empty())
+    std::filesystem::create_directories(outputPath.parent_path());
+
+  std::ofstream file(outputPath);
+  ETNA_VERIFYF(file.is_open(), "Unable to write trace {}", outputPath);
+
+  // CPU zones go into process 1 with a thread per pool worker, GPU zones into process 2
+  std::size_t maxThread = 0;
+  for (const auto& zone : captured)
+    maxThread = std::max(maxThread, zone.thread);
+
+  file << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+  file << R"({"name": "process_name", "ph": "M", "pid": 1, "args": {"name": "CPU"}},)" << '\n';
+  file << R"({"name": "process_name", "ph": "M", "pid": 2, "args": {"name": "GPU"}},)" << '\n';
+  for (std::size_t thread = 0; thread <= maxThread; ++thread)
+    file << fmt::format(
+      R"({{"name": "thread_name", "ph": "M", "pid": 1, "tid": {}, "args": {{"name": "{}"}}}},)",
+      thread,
+      thread == 0 ? std::string{"main"} : fmt::format("worker {}", thread))
+         << '\n';
+
+  for (std::size_t i = 0; i < captured.size(); ++i)
+  {
+    const auto& zone = captured[i];
+    file << fmt::format(
+      R"({{"name": "{}", "ph": "X", "pid": {}, "tid": {}, "ts": {:.3f}, "dur": {:.3f}}}{})",
+      escape_json(zone.name),
+      zone.gpu ? 2 : 1,
+      zone.thread,
+      toUs(zone.begin),
+      toUs(zone.end) - toUs(zone.begin),
+      i + 1 < captured.size() ? ",\n" : "\n");
+  }
+  file << "]}\n";
+
+  spdlog::info("Wrote {} trace zones into {}", captured.size(), outputPath);
+}
+
+CpuTraceScope::CpuTraceScope(const char* scope_name)
+  : name{scope_name}
+  , active{get_trace_capture().isRecordingCpu()}
+{
+  if (active)
+    begin = TraceCapture::Clock::now();
+}
+
+CpuTraceScope::~CpuTraceScope()
+{
+  if (active)
+    get_trace_capture().addCpuZone(name, begin, TraceCapture::Clock::now());
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+/**
+ * Records CPU and GPU zones of a few frames and writes them as a trace.json file
+ * in the Chrome tracing format, viewable in chrome://tracing or ui.perfetto.dev.
+ * Unlike Tracy, this does not need a running server, so it also works on build machines.
+ *
+ * CPU zones come from TRACE_CPU_SCOPE, GPU zones are added by GpuProfiler after
+ * converting GPU timestamps into the CPU clock domain. When nothing is being captured,
+ * a scope costs a single relaxed atomic load.
+ *
+ * GPU zones of a frame only become available a few frames after it was recorded, so the
+ * profiler tags frames recorded during the capture and the trace is written once the last
+ * tagged frame was resolved. This way CPU and GPU zones cover the same frames.
+ */
+class TraceCapture
+{
+public:
+  using Clock = std::chrono::steady_clock;
+
+  // Zones are recorded for the next frame_count frames, then the trace is written into path
+  void start(std::filesystem::path path, std::uint32_t frame_count);
+  // Also true while waiting for GPU zones of the captured frames
+  bool isCapturing() const { return isRecordingCpu() || pendingGpuFrames > 0; }
+  bool isRecordingCpu() const { return recordingCpu.load(std::memory_order_relaxed); }
+
+  // Must be called once per frame from the main thread
+  void endFrame();
+
+  // Called from the main thread by GpuProfiler when it begins recording a frame,
+  // returns whether GPU zones of the frame belong to the capture
+  bool beginGpuFrame();
+  // Called for every frame beginGpuFrame returned true for, once its zones were added,
+  // or once it is clear that they never will be
+  void endGpuFrame();
+
+  // Both are thread safe
+  void addCpuZone(std::string_view name, Clock::time_point begin, Clock::time_point end);
+  void addGpuZone(std::string_view name, Clock::time_point begin, Clock::time_point end);
+
+private:
+  struct Zone
+  {
+    std::string name;
+    bool gpu;
+    std::size_t thread;
+    Clock::time_point begin;
+    Clock::time_point end;
+  };
+
+  void write();
+
+private:
+  std::atomic<bool> recordingCpu = false;
+  // Frames that were recorded during the capture, but whose GPU zones were not added yet
+  std::uint32_t pendingGpuFrames = 0;
+
+  std::mutex zonesMutex;
+  std::vector<Zone> zones;
+
+  std::filesystem::path outputPath;
+  std::uint32_t framesLeft = 0;
+};
+
+TraceCapture& get_trace_capture();
+
+class CpuTraceScope
+{
+public:
+  explicit CpuTraceScope(const char* scope_name);
+  ~CpuTraceScope();
+
+  CpuTraceScope(const CpuTraceScope&) = delete;
+  CpuTraceScope& operator=(const CpuTraceScope&) = delete;
+
+private:
+  const char* name;
+  bool active;
+  TraceCapture::Clock::time_point begin;
+};
+
+#define TRACE_CONCAT_IMPL(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_IMPL(a, b)
+#define TRACE_CPU_SCOPE(name) CpuTraceScope TRACE_CONCAT(cpuTraceScope, __LINE__){name}
@@ -0,0 +1,762 @@
+#include "RenderGraph.hpp"
+
+#include <algorithm>
+#include <array>
+#include <iterator>
+
+#include <fmt/format.h>
+#include <tracy/Tracy.hpp>
+#include <etna/Assert.hpp>
+#include <etna/Etna.hpp>
+#include <etna/GlobalContext.hpp>
+
+
+namespace
+{
+
+struct AccessInfo
+{
+  vk::PipelineStageFlags2 stages;
+  vk::AccessFlags2 access;
+  vk::ImageLayout layout;
+  vk::ImageUsageFlags usage;
+};
+
+AccessInfo get_access_info(RenderGraph::Access access)
+{
+  using Stage = vk::PipelineStageFlagBits2;
+  using Acc = vk::AccessFlagBits2;
+  using Layout = vk::ImageLayout;
+  using Usage = vk::ImageUsageFlagBits;
+
+  // NOTE: must be kept in the same order as RenderGraph::Access
+  static const std::array<AccessInfo, 9> INFOS{{
+    // ColorAttachment
+    {Stage::eColorAttachmentOutput,
+     Acc::eColorAttachmentRead | Acc::eColorAttachmentWrite,
+     Layout::eColorAttachmentOptimal,
+     Usage::eColorAttachment},
+    // DepthAttachment
+    {Stage::eEarlyFragmentTests | Stage::eLateFragmentTests,
+     Acc::eDepthStencilAttachmentRead | Acc::eDepthStencilAttachmentWrite,
+     Layout::eDepthStencilAttachmentOptimal,
+     Usage::eDepthStencilAttachment},
+    // DepthAttachmentReadOnly
+    {Stage::eEarlyFragmentTests | Stage::eLateFragmentTests,
+     Acc::eDepthStencilAttachmentRead,
+     Layout::eDepthStencilAttachmentOptimal,
+     Usage::eDepthStencilAttachment},
+    // SampledInFragment
+    {Stage::eFragmentShader, Acc::eShaderSampledRead, Layout::eShaderReadOnlyOptimal, Usage::eSampled},
+    // SampledInCompute
+    {Stage::eComputeShader, Acc::eShaderSampledRead, Layout::eShaderReadOnlyOptimal, Usage::eSampled},
+    // StorageInCompute
+    {Stage::eComputeShader,
+     Acc::eShaderStorageRead | Acc::eShaderStorageWrite,
+     Layout::eGeneral,
+     Usage::eStorage},
+    // StorageInFragment
+    {Stage::eFragmentShader, Acc::eShaderStorageRead, Layout::eGeneral, Usage::eStorage},
+    // TransferSrc
+    {Stage::eTransfer, Acc::eTransferRead, Layout::eTransferSrcOptimal, Usage::eTransferSrc},
+    // TransferDst
+    {Stage::eTransfer, Acc::eTransferWrite, Layout::eTransferDstOptimal, Usage::eTransferDst},
+  }};
+
+  return INFOS[static_cast<std::size_t>(access)];
+}
+
+const char* access_name(RenderGraph::Access access)
+{
+  // NOTE: must be kept in the same order as RenderGraph::Access
+  static constexpr std::array NAMES{
+    "color attachment",
+    "depth attachment",
+    "read-only depth attachment",
+    "sampled in fragment",
+    "sampled in compute",
+    "storage in compute",
+    "storage in fragment",
+    "transfer src",
+    "transfer dst",
+  };
+
+  return NAMES[static_cast<std::size_t>(access)];
+}
+
+bool is_buffer_access(RenderGraph::Access access)
+{
+  using Access = RenderGraph::Access;
+  return access == Access::StorageInCompute || access == Access::StorageInFragment ||
+    access == Access::TransferSrc || access == Access::TransferDst;
+}
+
+vk::ImageAspectFlags aspect_of(vk::Format format)
+{
+  switch (format)
+  {
+  case vk::Format::eD16Unorm:
+  case vk::Format::eD32Sfloat:
+  case vk::Format::eX8D24UnormPack32:
+    return vk::ImageAspectFlagBits::eDepth;
+  case vk::Format::eD16UnormS8Uint:
+  case vk::Format::eD24UnormS8Uint:
+  case vk::Format::eD32SfloatS8Uint:
+    return vk::ImageAspectFlagBits::eDepth | vk::ImageAspectFlagBits::eStencil;
+  default:
+    return vk::ImageAspectFlagBits::eColor;
+  }
+}
+
+constexpr std::uint32_t NONE = ~std::uint32_t{0};
+
+double to_mib(vk::DeviceSize bytes)
+{
+  return static_cast<double>(bytes) / (1024.0 * 1024.0);
+}
+
+} // namespace
+
+RenderGraph::ResourceId RenderGraph::PassBuilder::create(std::string name, ImageDesc desc)
+{
+  const auto id = static_cast<ResourceId>(graph.resources.size());
+  graph.resources.push_back(Resource{
+    .name = std::move(name),
+    .desc = desc,
+  });
+  return id;
+}
+
+void RenderGraph::PassBuilder::read(ResourceId id, Access access)
+{
+  graph.addUse(pass, id, access, true, false);
+}
+
+void RenderGraph::PassBuilder::write(ResourceId id, Access access)
+{
+  graph.addUse(pass, id, access, false, true);
+}
+
+void RenderGraph::PassBuilder::modify(ResourceId id, Access access)
+{
+  graph.addUse(pass, id, access, true, true);
+}
+
+void RenderGraph::PassBuilder::markSideEffect()
+{
+  graph.passes[pass].sideEffect = true;
+}
+
+void RenderGraph::PassBuilder::useAsyncCompute()
+{
+  graph.passes[pass].asyncCompute = true;
+}
+
+const etna::Image& RenderGraph::PassResources::getImage(ResourceId id) const
+{
+  const auto& res = graph.getResource(id);
+  if (res.imported)
+  {
+    ETNA_VERIFYF(res.importedImage != nullptr, "'{}' is not an etna image!", res.name);
+    return *res.importedImage;
+  }
+  return graph.pool[res.physical]->image;
+}
+
+vk::Image RenderGraph::PassResources::getVkImage(ResourceId id) const
+{
+  const auto& res = graph.getResource(id);
+  if (res.imported && res.importedImage == nullptr)
+    return res.importedVkImage;
+  return getImage(id).get();
+}
+
+vk::ImageView RenderGraph::PassResources::getView(ResourceId id) const
+{
+  const auto& res = graph.getResource(id);
+  if (res.imported && res.importedImage == nullptr)
+    return res.importedView;
+  return getImage(id).getView({});
+}
+
+const RenderGraph::ImageDesc& RenderGraph::PassResources::getDesc(ResourceId id) const
+{
+  return graph.getResource(id).desc;
+}
+
+void RenderGraph::reset()
+{
+  passes.clear();
+  resources.clear();
+  compiled = false;
+
+  for (auto& phys : pool)
+    phys->usedThisFrame = false;
+}
+
+RenderGraph::ResourceId RenderGraph::importImage(std::string name, const etna::Image& image)
+{
+  const auto id = static_cast<ResourceId>(resources.size());
+  resources.push_back(Resource{
+    .name = std::move(name),
+    .desc =
+      ImageDesc{
+        .extent = image.getExtent(),
+        .format = image.getFormat(),
+      },
+    .imported = true,
+    .importedImage = &image,
+  });
+  return id;
+}
+
+RenderGraph::ResourceId RenderGraph::importImage(
+  std::string name, vk::Image image, vk::ImageView view, ImageDesc desc)
+{
+  const auto id = static_cast<ResourceId>(resources.size());
+  resources.push_back(Resource{
+    .name = std::move(name),
+    .desc = desc,
+    .imported = true,
+    .importedVkImage = image,
+    .importedView = view,
+  });
+  return id;
+}
+
+RenderGraph::ResourceId RenderGraph::importBuffer(std::string name, const etna::Buffer& buffer)
+{
+  const auto id = static_cast<ResourceId>(resources.size());
+  resources.push_back(Resource{
+    .name = std::move(name),
+    .imported = true,
+    .importedBuffer = &buffer,
+  });
+  return id;
+}
+
+void RenderGraph::markOutput(ResourceId id)
+{
+  resources[static_cast<std::uint32_t>(id)].output = true;
+}
+
+void RenderGraph::addPass(std::string name, SetupFn setup, ExecuteFn execute)
+{
+  ETNA_VERIFYF(!compiled, "Cannot add passes to a compiled graph, call reset() first!");
+
+  const auto idx = static_cast<std::uint32_t>(passes.size());
+  passes.push_back(Pass{
+    .name = std::move(name),
+    .execute = std::move(execute),
+  });
+
+  PassBuilder builder{*this, idx};
+  setup(builder);
+}
+
+void RenderGraph::addUse(std::uint32_t pass, ResourceId id, Access access, bool reads, bool writes)
+{
+  ETNA_VERIFY(static_cast<std::uint32_t>(id) < resources.size());
+  ETNA_VERIFYF(
+    resources[static_cast<std::uint32_t>(id)].importedBuffer == nullptr || is_buffer_access(access),
+    "Pass '{}' uses buffer '{}' as {}, which only makes sense for images!",
+    passes[pass].name,
+    resources[static_cast<std::uint32_t>(id)].name,
+    access_name(access));
+
+  auto& uses = passes[pass].uses;
+  auto it = std::find_if(uses.begin(), uses.end(), [id](const Use& u) { return u.resource == id; });
+  if (it != uses.end())
+  {
+    ETNA_VERIFYF(
+      get_access_info(it->access).layout == get_access_info(access).layout,
+      "Pass '{}' uses '{}' in two incompatible ways!",
+      passes[pass].name,
+      resources[static_cast<std::uint32_t>(id)].name);
+    it->reads = it->reads || reads;
+    it->writes = it->writes || writes;
+    return;
+  }
+
+  uses.push_back(Use{
+    .resource = id,
+    .access = access,
+    .reads = reads,
+    .writes = writes,
+  });
+}
+
+const RenderGraph::Resource& RenderGraph::getResource(ResourceId id) const
+{
+  return resources[static_cast<std::uint32_t>(id)];
+}
+
+void RenderGraph::compile()
+{
+  ZoneScoped;
+
+  cullPasses();
+  computeLifetimes();
+  assignPhysicalImages();
+  computeTransitions();
+  assignEvents();
+
+  compiled = true;
+}
+
+void RenderGraph::cullPasses()
+{
+  // Walk backwards, tracking which resources still have consumers downstream.
+  std::vector<bool> live(resources.size());
+  for (std::size_t i = 0; i < resources.size(); ++i)
+    live[i] = resources[i].output;
+
+  for (auto it = passes.rbegin(); it != passes.rend(); ++it)
+  {
+    auto& pass = *it;
+
+    pass.culled = !pass.sideEffect &&
+      std::none_of(pass.uses.begin(), pass.uses.end(), [&live](const Use& use) {
+        return use.writes && live[static_cast<std::uint32_t>(use.resource)];
+      });
+
+    if (pass.culled)
+      continue;
+
+    // Whatever this pass overwrites is not needed from earlier passes anymore...
+    for (const auto& use : pass.uses)
+      if (use.writes && !use.reads)
+        live[static_cast<std::uint32_t>(use.resource)] = false;
+    // ...but whatever it reads is.
+    for (const auto& use : pass.uses)
+      if (use.reads)
+        live[static_cast<std::uint32_t>(use.resource)] = true;
+  }
+}
+
+void RenderGraph::computeLifetimes()
+{
+  for (std::uint32_t passIdx = 0; passIdx < passes.size(); ++passIdx)
+  {
+    if (passes[passIdx].culled)
+      continue;
+
+    for (const auto& use : passes[passIdx].uses)
+    {
+      auto& res = resources[static_cast<std::uint32_t>(use.resource)];
+      res.firstPass = std::min(res.firstPass, passIdx);
+      res.lastPass = std::max(res.lastPass, passIdx);
+      res.usage |= get_access_info(use.access).usage;
+    }
+  }
+}
+
+void RenderGraph::assignPhysicalImages()
+{
+  for (auto& phys : pool)
+  {
+    phys->usedThisFrame = false;
+    phys->busyUntilPass = 0;
+  }
+
+  std::vector<std::uint32_t> transients;
+  for (std::uint32_t i = 0; i < resources.size(); ++i)
+    if (!resources[i].imported && resources[i].firstPass != NONE)
+      transients.push_back(i);
+
+  std::stable_sort(transients.begin(), transients.end(), [this](std::uint32_t a, std::uint32_t b) {
+    return resources[a].firstPass < resources[b].firstPass;
+  });
+
+  auto& ctx = etna::get_context();
+
+  for (auto resIdx : transients)
+  {
+    auto& res = resources[resIdx];
+
+    auto it = std::find_if(pool.begin(), pool.end(), [&res](const auto& phys) {
+      return phys->desc == res.desc && phys->usage == res.usage &&
+        (!phys->usedThisFrame || phys->busyUntilPass < res.firstPass);
+    });
+
+    if (it == pool.end())
+    {
+      auto phys = std::make_unique<PhysicalImage>(PhysicalImage{
+        .desc = res.desc,
+        .usage = res.usage,
+        .image = ctx.createImage(etna::Image::CreateInfo{
+          .extent = res.desc.extent,
+          .name = "render_graph_" + res.name,
+          .format = res.desc.format,
+          .imageUsage = res.usage,
+          .layers = res.desc.layers,
+        }),
+      });
+      phys->size = ctx.getDevice().getImageMemoryRequirements(phys->image.get()).size;
+      pool.push_back(std::move(phys));
+      it = std::prev(pool.end());
+    }
+
+    (*it)->usedThisFrame = true;
+    (*it)->busyUntilPass = res.lastPass;
+    res.physical = static_cast<std::uint32_t>(std::distance(pool.begin(), it));
+  }
+}
+
+void RenderGraph::computeTransitions()
+{
+  struct TrackedState
+  {
+    bool known = false;
+    vk::ImageLayout layout = vk::ImageLayout::eUndefined;
+    bool writtenSinceBarrier = false;
+    bool readSinceBarrier = false;
+    // Buffers only, as etna does not track them
+    vk::PipelineStageFlags2 stages = {};
+    vk::AccessFlags2 access = {};
+    // The pass that used the resource since the last barrier, if there is only one
+    std::uint32_t user = NONE;
+  };
+
+  std::vector<TrackedState> states(resources.size());
+
+  for (std::uint32_t passIdx = 0; passIdx < passes.size(); ++passIdx)
+  {
+    auto& pass = passes[passIdx];
+    pass.transitions.clear();
+    if (pass.culled)
+      continue;
+
+    for (const auto& use : pass.uses)
+    {
+      const auto& res = getResource(use.resource);
+      const bool isBuffer = res.importedBuffer != nullptr;
+      const auto info = get_access_info(use.access);
+
+      if (pass.asyncCompute)
+      {
+        const vk::PipelineStageFlags2 asyncStages =
+          vk::PipelineStageFlagBits2::eComputeShader | vk::PipelineStageFlagBits2::eTransfer;
+        ETNA_VERIFYF(
+          (!use.writes || isBuffer) && !(info.stages & ~asyncStages),
+          "Async compute pass '{}' can't use '{}' as {}, it may only write buffers!",
+          pass.name,
+          res.name,
+          access_name(use.access));
+      }
+
+      auto& state = states[static_cast<std::uint32_t>(use.resource)];
+      // Buffers have no layout, they are only ever in the same state
+      const auto layout = isBuffer ? vk::ImageLayout::eUndefined : info.layout;
+
+      // Read-after-write and write-after-write need a memory dependency,
+      // write-after-read needs an execution dependency. Reads after reads in
+      // the same layout need nothing at all.
+      const bool hazard = state.writtenSinceBarrier || (use.writes && state.readSinceBarrier);
+      if ((!state.known && !isBuffer) || state.layout != layout || hazard)
+      {
+        const bool fromAsync = state.user != NONE && state.user != passIdx &&
+          passes[state.user].asyncCompute;
+        pass.transitions.push_back(Transition{
+          .resource = use.resource,
+          .oldLayout = state.layout,
+          .newLayout = layout,
+          .hazard = hazard,
+          .srcStages = state.stages,
+          .srcAccess = state.access,
+          .asyncProducer = isBuffer && fromAsync ? state.user : NONE,
+        });
+        state = TrackedState{.known = true, .layout = layout};
+      }
+
+      const bool firstUse = !state.writtenSinceBarrier && !state.readSinceBarrier;
+      state.user = firstUse || state.user == passIdx ? passIdx : NONE;
+      state.writtenSinceBarrier = state.writtenSinceBarrier || use.writes;
+      state.readSinceBarrier = state.readSinceBarrier || use.reads;
+      state.stages |= info.stages;
+      state.access |= info.access;
+    }
+  }
+}
+
+void RenderGraph::assignEvents()
+{
+  eventCount = 0;
+  for (auto& pass : passes)
+  {
+    pass.eventBarriers.clear();
+    pass.event = NONE;
+    pass.waitsFor.clear();
+  }
+
+  // A single wait covers all consumers, as they come after the first one
+  for (auto& pass : passes)
+    for (const auto& transition : pass.transitions)
+    {
+      if (transition.asyncProducer == NONE)
+        continue;
+
+      auto& producer = passes[transition.asyncProducer];
+      if (producer.event == NONE)
+      {
+        producer.event = eventCount++;
+        pass.waitsFor.push_back(transition.asyncProducer);
+      }
+
+      const auto use = std::find_if(pass.uses.begin(), pass.uses.end(), [&](const Use& u) {
+        return u.resource == transition.resource;
+      });
+      const auto info = get_access_info(use->access);
+      producer.eventBarriers.push_back(vk::BufferMemoryBarrier2{
+        .srcStageMask = transition.srcStages,
+        .srcAccessMask = transition.srcAccess,
+        .dstStageMask = info.stages,
+        .dstAccessMask = info.access,
+        .srcQueueFamilyIndex = vk::QueueFamilyIgnored,
+        .dstQueueFamilyIndex = vk::QueueFamilyIgnored,
+        .buffer = getResource(transition.resource).importedBuffer->get(),
+        .offset = 0,
+        .size = vk::WholeSize,
+      });
+    }
+}
+
+vk::Event RenderGraph::getEvent(std::uint32_t pass)
+{
+  auto& ctx = etna::get_context();
+  if (events.empty())
+    events.resize(ctx.getMainWorkCount().multiBufferingCount());
+
+  auto& frameEvents = events[ctx.getMainWorkCount().batchIndex()];
+  while (frameEvents.size() <= passes[pass].event)
+    frameEvents.push_back(etna::unwrap_vk_result(ctx.getDevice().createEventUnique(
+      vk::EventCreateInfo{.flags = vk::EventCreateFlagBits::eDeviceOnly})));
+  return frameEvents[passes[pass].event].get();
+}
+
+RenderGraph::PassResources RenderGraph::getResources() const
+{
+  ETNA_VERIFYF(compiled, "Render graph must be compiled before accessing its images!");
+  return PassResources{*this};
+}
+
+void RenderGraph::execute(vk::CommandBuffer cmd_buf, GpuProfiler* profiler)
+{
+  ETNA_VERIFYF(compiled, "Render graph must be compiled before execution!");
+
+  PassResources passResources{*this};
+
+  for (std::uint32_t passIdx = 0; passIdx < passes.size(); ++passIdx)
+  {
+    auto& pass = passes[passIdx];
+    if (pass.culled)
+      continue;
+
+    // Barriers are attributed to the pass that needs them
+    if (profiler != nullptr)
+      profiler->beginScope(cmd_buf, pass.name);
+
+    std::vector<vk::BufferMemoryBarrier2> bufferBarriers;
+    for (const auto& transition : pass.transitions)
+    {
+      const auto& res = getResource(transition.resource);
+      const auto use = std::find_if(pass.uses.begin(), pass.uses.end(), [&](const Use& u) {
+        return u.resource == transition.resource;
+      });
+      const auto info = get_access_info(use->access);
+
+      if (res.importedBuffer != nullptr)
+      {
+        // Results of async compute are synchronized through the event of their pass
+        if (transition.asyncProducer == NONE)
+          bufferBarriers.push_back(vk::BufferMemoryBarrier2{
+            .srcStageMask = transition.srcStages,
+            .srcAccessMask = transition.srcAccess,
+            .dstStageMask = info.stages,
+            .dstAccessMask = info.access,
+            .srcQueueFamilyIndex = vk::QueueFamilyIgnored,
+            .dstQueueFamilyIndex = vk::QueueFamilyIgnored,
+            .buffer = res.importedBuffer->get(),
+            .offset = 0,
+            .size = vk::WholeSize,
+          });
+        continue;
+      }
+
+      etna::set_state(
+        cmd_buf,
+        passResources.getVkImage(transition.resource),
+        info.stages,
+        info.access,
+        info.layout,
+        aspect_of(res.desc.format),
+        // etna skips transitions into the state an image is already in,
+        // but hazards within the same state still need a barrier.
+        transition.hazard ? etna::ForceSetState::eTrue : etna::ForceSetState::eFalse);
+    }
+    etna::flush_barriers(cmd_buf);
+
+    if (!bufferBarriers.empty())
+      cmd_buf.pipelineBarrier2(vk::DependencyInfo{
+        .bufferMemoryBarrierCount = static_cast<std::uint32_t>(bufferBarriers.size()),
+        .pBufferMemoryBarriers = bufferBarriers.data(),
+      });
+
+    if (asyncComputeEnabled)
+      for (auto producer : pass.waitsFor)
+      {
+        const auto& barriers = passes[producer].eventBarriers;
+        const vk::DependencyInfo dependency{
+          .bufferMemoryBarrierCount = static_cast<std::uint32_t>(barriers.size()),
+          .pBufferMemoryBarriers = barriers.data(),
+        };
+        const auto event = getEvent(producer);
+        cmd_buf.waitEvents2(1, &event, &dependency);
+
+        // Unsignaled for the next frame that uses this set of events
+        vk::PipelineStageFlags2 waitStages = {};
+        for (const auto& barrier : barriers)
+          waitStages |= barrier.dstStageMask;
+        cmd_buf.resetEvent2(event, waitStages);
+      }
+
+    pass.execute(cmd_buf, passResources);
+
+    if (pass.event != NONE)
+    {
+      const vk::DependencyInfo dependency{
+        .bufferMemoryBarrierCount = static_cast<std::uint32_t>(pass.eventBarriers.size()),
+        .pBufferMemoryBarriers = pass.eventBarriers.data(),
+      };
+      if (asyncComputeEnabled)
+        cmd_buf.setEvent2(getEvent(passIdx), dependency);
+      else
+        cmd_buf.pipelineBarrier2(dependency);
+    }
+
+    if (profiler != nullptr)
+      profiler->endScope(cmd_buf);
+  }
+}
+
+std::string RenderGraph::dump() const
+{
+  std::string result;
+  auto out = std::back_inserter(result);
+
+  const auto culledCount =
+    std::count_if(passes.begin(), passes.end(), [](const Pass& p) { return p.culled; });
+  std::size_t transitionCount = 0;
+  for (const auto& pass : passes)
+    transitionCount += pass.transitions.size();
+
+  fmt::format_to(
+    out,
+    "Render graph: {} passes ({} culled), {} resources, {} transitions\n",
+    passes.size(),
+    culledCount,
+    resources.size(),
+    transitionCount);
+
+  for (std::size_t i = 0; i < passes.size(); ++i)
+  {
+    const auto& pass = passes[i];
+    fmt::format_to(
+      out,
+      "  [{}] {}{}{}\n",
+      i,
+      pass.name,
+      pass.asyncCompute ? " (async compute)" : "",
+      pass.culled ? " (culled)" : "");
+
+    for (auto producer : pass.waitsFor)
+      fmt::format_to(out, "      wait for [{}] {}\n", producer, passes[producer].name);
+
+    for (const auto& use : pass.uses)
+      fmt::format_to(
+        out,
+        "      {:<6} {} as {}\n",
+        use.reads && use.writes ? "modify" : (use.writes ? "write" : "read"),
+        getResource(use.resource).name,
+        access_name(use.access));
+
+    for (const auto& transition : pass.transitions)
+    {
+      const auto& res = getResource(transition.resource);
+      if (res.importedBuffer != nullptr)
+      {
+        fmt::format_to(
+          out,
+          "      barrier {}{}\n",
+          res.name,
+          transition.asyncProducer != NONE ? " (via event)" : "");
+        continue;
+      }
+
+      fmt::format_to(
+        out,
+        "      barrier {}: {} -> {}{}\n",
+        res.name,
+        vk::to_string(transition.oldLayout),
+        vk::to_string(transition.newLayout),
+        transition.hazard ? " (hazard)" : "");
+    }
+  }
+
+  vk::DeviceSize virtualBytes = 0;
+  for (const auto& res : resources)
+  {
+    if (res.imported)
+    {
+      fmt::format_to(
+        out,
+        "  {}: imported{}{}\n",
+        res.name,
+        res.importedBuffer != nullptr ? " buffer" : "",
+        res.output ? ", output" : "");
+      continue;
+    }
+
+    if (res.physical == NONE)
+    {
+      fmt::format_to(out, "  {}: unused\n", res.name);
+      continue;
+    }
+
+    const auto& phys = *pool[res.physical];
+    virtualBytes += phys.size;
+    fmt::format_to(
+      out,
+      "  {}: {}x{}x{} {}, passes [{}, {}], physical image #{} ({:.2f} MiB)\n",
+      res.name,
+      res.desc.extent.width,
+      res.desc.extent.height,
+      res.desc.layers,
+      vk::to_string(res.desc.format),
+      res.firstPass,
+      res.lastPass,
+      res.physical,
+      to_mib(phys.size));
+  }
+
+  vk::DeviceSize physicalBytes = 0;
+  for (const auto& phys : pool)
+    if (phys->usedThisFrame)
+      physicalBytes += phys->size;
+
+  fmt::format_to(
+    out,
+    "Transient memory: {:.2f} MiB requested, {:.2f} MiB allocated, {:.2f} MiB saved by image "
+    "reuse\n",
+    to_mib(virtualBytes),
+    to_mib(physicalBytes),
+    to_mib(virtualBytes - physicalBytes));
+
+  return result;
+}
+
+void RenderGraph::releaseUnusedImages()
+{
+  ETNA_VERIFYF(!compiled, "Releasing images from under a compiled graph, call reset() first!");
+  std::erase_if(pool, [](const auto& phys) { return !phys->usedThisFrame; });
+}
@@ -0,0 +1,257 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <etna/Vulkan.hpp>
+#include <etna/Image.hpp>
+#include <etna/Buffer.hpp>
+#include <function2/function2.hpp>
+
+#include "profiling/GpuProfiler.hpp"
+
+
+/**
+ * A tiny frame graph on top of etna. Passes are declared every frame together with
+ * the images they read and write, then the graph:
+ *  - culls passes whose results never reach an output or a side effect,
+ *  - computes the minimal set of image state transitions between passes,
+ *  - places transient images into a persistent pool, letting images of the same description
+ *    and usage whose lifetimes do not overlap reuse the same physical etna::Image.
+ *
+ * NOTE: this is image reuse, not memory aliasing. etna owns the allocations of its images,
+ * so transients of different descriptions never share memory.
+ *
+ * Passes are executed in declaration order, the graph never reorders them.
+ * Transitions are issued through etna::set_state, so etna's own state tracking
+ * (used by RenderTargetState and descriptor sets) stays consistent.
+ *
+ * Imported buffers get memory barriers between passes too, but only within a frame,
+ * synchronization with the previous frame is up to the passes.
+ *
+ * Async compute passes only record compute and transfer work and write nothing but buffers.
+ * etna creates a single queue, so they run on it like any other pass, but their results are
+ * handed over with an event that is only waited for by the first pass consuming them.
+ * Graphics passes declared in between are free to overlap with the compute work.
+ */
+class RenderGraph
+{
+public:
+  enum class ResourceId : std::uint32_t
+  {
+    Invalid = ~std::uint32_t{0},
+  };
+
+  struct ImageDesc
+  {
+    vk::Extent3D extent = {};
+    vk::Format format = vk::Format::eUndefined;
+    std::uint32_t layers = 1;
+
+    bool operator==(const ImageDesc&) const = default;
+  };
+
+  enum class Access
+  {
+    ColorAttachment,
+    DepthAttachment,
+    // Depth test without depth writes
+    DepthAttachmentReadOnly,
+    SampledInFragment,
+    SampledInCompute,
+    StorageInCompute,
+    // Read-only
+    StorageInFragment,
+    TransferSrc,
+    TransferDst,
+  };
+
+  class PassBuilder
+  {
+    friend class RenderGraph;
+
+    PassBuilder(RenderGraph& graph, std::uint32_t pass)
+      : graph{graph}
+      , pass{pass}
+    {
+    }
+
+  public:
+    // Creates a transient image that only lives during this frame
+    ResourceId create(std::string name, ImageDesc desc);
+
+    // Contents are consumed
+    void read(ResourceId id, Access access);
+    // Contents are fully overwritten, e.g. an attachment with a clear or don't care load op
+    void write(ResourceId id, Access access);
+    // Contents are both consumed and overwritten, e.g. an attachment with a load op of load
+    void modify(ResourceId id, Access access);
+
+    // The pass does something observable outside of the graph and must never be culled
+    void markSideEffect();
+
+    // See the class description, mind that there is nothing to overlap with unless
+    // the pass is declared ahead of graphics passes that do not depend on it
+    void useAsyncCompute();
+
+  private:
+    RenderGraph& graph;
+    std::uint32_t pass;
+  };
+
+  class PassResources
+  {
+    friend class RenderGraph;
+
+    explicit PassResources(const RenderGraph& graph)
+      : graph{graph}
+    {
+    }
+
+  public:
+    // Only valid for transient images and images imported as etna::Image
+    const etna::Image& getImage(ResourceId id) const;
+    vk::Image getVkImage(ResourceId id) const;
+    vk::ImageView getView(ResourceId id) const;
+    const ImageDesc& getDesc(ResourceId id) const;
+
+  private:
+    const RenderGraph& graph;
+  };
+
+  using SetupFn = fu2::function_view<void(PassBuilder&)>;
+  using ExecuteFn = fu2::unique_function<void(vk::CommandBuffer, const PassResources&)>;
+
+  RenderGraph() = default;
+
+  RenderGraph(const RenderGraph&) = delete;
+  RenderGraph& operator=(const RenderGraph&) = delete;
+
+  // Forgets all passes and resources of the previous frame, but keeps the pool of images
+  void reset();
+
+  ResourceId importImage(std::string name, const etna::Image& image);
+  // For images not owned by etna, e.g. swapchain images
+  ResourceId importImage(std::string name, vk::Image image, vk::ImageView view, ImageDesc desc);
+  // Only storage and transfer accesses make sense for buffers
+  ResourceId importBuffer(std::string name, const etna::Buffer& buffer);
+
+  // Passes contributing to outputs are never culled
+  void markOutput(ResourceId id);
+
+  // Setup is called right away, execute is called from within execute()
+  void addPass(std::string name, SetupFn setup, ExecuteFn execute);
+
+  void compile();
+  // Every pass gets a GPU profiler scope named after it when a profiler is provided
+  void execute(vk::CommandBuffer cmd_buf, GpuProfiler* profiler = nullptr);
+
+  // When disabled, results of async compute passes are waited for right after them,
+  // i.e. the passes are serialized with the rest of the frame, same as regular ones
+  void setAsyncComputeEnabled(bool enabled) { asyncComputeEnabled = enabled; }
+
+  // Physical images of the compiled graph, for work that has to be prepared
+  // before execute(), e.g. recording secondary command buffers on other threads
+  PassResources getResources() const;
+
+  // Human-readable description of the last compiled graph
+  std::string dump() const;
+
+  // Destroys pooled images that are not used by the current (not yet compiled) graph,
+  // e.g. calling this right after reset() frees everything.
+  // The GPU must not be using them, so call this after waiting for idle.
+  void releaseUnusedImages();
+
+private:
+  struct Use
+  {
+    ResourceId resource;
+    Access access;
+    bool reads;
+    bool writes;
+  };
+
+  struct Transition
+  {
+    ResourceId resource;
+    vk::ImageLayout oldLayout;
+    vk::ImageLayout newLayout;
+    bool hazard;
+    // Buffers only, accesses since the previous barrier
+    vk::PipelineStageFlags2 srcStages = {};
+    vk::AccessFlags2 srcAccess = {};
+    // Async compute pass the barrier is a part of the event of
+    std::uint32_t asyncProducer = ~std::uint32_t{0};
+  };
+
+  struct Pass
+  {
+    std::string name;
+    std::vector<Use> uses;
+    bool sideEffect = false;
+    bool asyncCompute = false;
+    bool culled = false;
+    ExecuteFn execute;
+    std::vector<Transition> transitions;
+
+    // Async compute passes only, all barriers on their results, set as a single event
+    std::vector<vk::BufferMemoryBarrier2> eventBarriers;
+    std::uint32_t event = ~std::uint32_t{0};
+    // Async compute passes whose events are waited for before this pass
+    std::vector<std::uint32_t> waitsFor;
+  };
+
+  struct Resource
+  {
+    std::string name;
+    ImageDesc desc;
+    vk::ImageUsageFlags usage = {};
+    bool output = false;
+
+    // Imported resources
+    bool imported = false;
+    const etna::Image* importedImage = nullptr;
+    vk::Image importedVkImage = {};
+    vk::ImageView importedView = {};
+    const etna::Buffer* importedBuffer = nullptr;
+
+    // Filled in by compile
+    std::uint32_t firstPass = ~std::uint32_t{0};
+    std::uint32_t lastPass = 0;
+    std::uint32_t physical = ~std::uint32_t{0};
+  };
+
+  struct PhysicalImage
+  {
+    ImageDesc desc;
+    vk::ImageUsageFlags usage;
+    etna::Image image;
+    vk::DeviceSize size = 0;
+    bool usedThisFrame = false;
+    std::uint32_t busyUntilPass = 0;
+  };
+
+  void addUse(std::uint32_t pass, ResourceId id, Access access, bool reads, bool writes);
+  const Resource& getResource(ResourceId id) const;
+
+  void cullPasses();
+  void computeLifetimes();
+  void assignPhysicalImages();
+  void computeTransitions();
+  void assignEvents();
+  vk::Event getEvent(std::uint32_t pass);
+
+private:
+  std::vector<Pass> passes;
+  std::vector<Resource> resources;
+  // NOTE: unique_ptr to keep references stable while the pool grows
+  std::vector<std::unique_ptr<PhysicalImage>> pool;
+  bool compiled = false;
+
+  bool asyncComputeEnabled = true;
+  std::uint32_t eventCount = 0;
+  // One set per frame in flight, so that events are never reused while still in use
+  std::vector<std::vector<vk::UniqueEvent>> events;
+};
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string_view>
+
+
+// Only available in targets that call target_embed_shaders in their CMakeLists.txt.
+// Looks shaders up by the file name of the compiled binary, e.g. "simple.vert.spv",
+// returns an empty span for unknown names.
+std::span<const std::uint32_t> find_embedded_shader(std::string_view name);
+
+// Writes every embedded shader into dir under its own name, for APIs that only load shaders
+// from files, e.g. etna::create_program. Files that are already up to date are left as is.
+void write_embedded_shaders(const std::filesystem::path& dir);
@@ -0,0 +1,38 @@
+#include "HeadlessOptions.hpp"
+
+#include <charconv>
+#include <string_view>
+
+#include <etna/Assert.hpp>
+
+
+HeadlessOptions parse_headless_options(int argc, char** argv)
+{
+  HeadlessOptions result;
+
+  for (int i = 1; i < argc; ++i)
+  {
+    const std::string_view arg = argv[i];
+
+    if (arg == "--headless")
+      result.enabled = true;
+    else if (arg == "--frames")
+    {
+      ETNA_VERIFYF(i + 1 < argc, "--frames expects a frame count");
+      const std::string_view value = argv[++i];
+      const auto [end, errc] =
+        std::from_chars(value.data(), value.data() + value.size(), result.frameCount);
+      ETNA_VERIFYF(
+        errc == std::errc{} && end == value.data() + value.size(),
+        "--frames expects a frame count, got '{}'",
+        value);
+    }
+    else if (arg == "--dump-dir")
+    {
+      ETNA_VERIFYF(i + 1 < argc, "--dump-dir expects a path");
+      result.dumpDir = argv[++i];
+    }
+  }
+
+  return result;
+}
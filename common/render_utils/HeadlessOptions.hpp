@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+
+
+/**
+ * Command line switches shared by samples that can run without a window:
+ *   --headless        render into an offscreen target instead of a window
+ *   --frames N        amount of frames to render before exiting (headless only)
+ *   --dump-dir PATH   write every rendered frame into PATH as a PNG (headless only)
+ */
+struct HeadlessOptions
+{
+  bool enabled = false;
+  std::uint32_t frameCount = 100;
+  std::filesystem::path dumpDir;
+  // Headless runs use a fixed time step so that the output does not depend on machine speed
+  float timeStep = 1.0f / 60.0f;
+};
+
+// Unknown arguments are ignored, malformed known ones are fatal
+HeadlessOptions parse_headless_options(int argc, char** argv);
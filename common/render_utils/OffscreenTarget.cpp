@@ -0,0 +1,231 @@
+#include "OffscreenTarget.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <utility>
+
+#include <etna/GlobalContext.hpp>
+#include <etna/RenderTargetStates.hpp>
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+#include <stb_image_write.h>
+#include <tracy/Tracy.hpp>
+
+
+static bool is_bgra(vk::Format format)
+{
+  return format == vk::Format::eB8G8R8A8Srgb || format == vk::Format::eB8G8R8A8Unorm;
+}
+
+static bool is_rgba(vk::Format format)
+{
+  return format == vk::Format::eR8G8B8A8Srgb || format == vk::Format::eR8G8B8A8Unorm;
+}
+
+static void write_png(
+  const std::filesystem::path& path,
+  glm::uvec2 resolution,
+  std::vector<std::byte> pixels,
+  bool bgra)
+{
+  ZoneScoped;
+
+  if (bgra)
+    for (std::size_t i = 0; i < pixels.size(); i += 4)
+      std::swap(pixels[i], pixels[i + 2]);
+
+  const int written = stbi_write_png(
+    path.string().c_str(),
+    static_cast<int>(resolution.x),
+    static_cast<int>(resolution.y),
+    4,
+    pixels.data(),
+    static_cast<int>(resolution.x * 4));
+
+  if (written == 0)
+    spdlog::error("Failed to write frame to {}", path.string());
+}
+
+OffscreenTarget::OffscreenTarget(const CreateInfo& info)
+  : resolution{info.resolution}
+  , format{info.format}
+  , dumpDir{info.dumpDir}
+  , threadPool{info.threadPool}
+{
+  auto& ctx = etna::get_context();
+
+  ETNA_VERIFYF(
+    is_rgba(format) || is_bgra(format),
+    "Offscreen target only supports 8-bit RGBA and BGRA formats, got {}",
+    vk::to_string(format));
+
+  if (!dumpDir.empty())
+    std::filesystem::create_directories(dumpDir);
+
+  image = ctx.createImage(etna::Image::CreateInfo{
+    .extent = vk::Extent3D{resolution.x, resolution.y, 1},
+    .name = "offscreen_target",
+    .format = format,
+    .imageUsage =
+      vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc,
+  });
+
+  const std::size_t framesInFlight = ctx.getMainWorkCount().multiBufferingCount();
+  readbacks.resize(framesInFlight);
+  for (std::size_t i = 0; i < framesInFlight; ++i)
+  {
+    // etna::Buffer doesn't expose its allocation for invalidation, so the memory must be
+    // host coherent, which VMA only guarantees for CPU_ONLY, unlike GPU_TO_CPU
+    readbacks[i].buffer = ctx.createBuffer(etna::Buffer::CreateInfo{
+      .size = vk::DeviceSize{resolution.x} * resolution.y * 4,
+      .bufferUsage = vk::BufferUsageFlagBits::eTransferDst,
+      .memoryUsage = VMA_MEMORY_USAGE_CPU_ONLY,
+      .name = fmt::format("offscreen_readback{}", i),
+    });
+    readbacks[i].buffer.map();
+
+    readbacks[i].available =
+      etna::unwrap_vk_result(ctx.getDevice().createSemaphoreUnique(vk::SemaphoreCreateInfo{}));
+  }
+}
+
+OffscreenTarget::Frame OffscreenTarget::acquireNext()
+{
+  ZoneScoped;
+
+  auto& ctx = etna::get_context();
+  auto& readback = readbacks[ctx.getMainWorkCount().batchIndex()];
+
+  // The command manager has already waited for this slot's previous frame
+  consume(readback);
+  readback.frameIndex = frameCount++;
+
+  // There is no presentation engine to signal that the image is free, but the
+  // command manager still expects a semaphore to wait on, so signal it ourselves.
+  const vk::Semaphore available = readback.available.get();
+  ETNA_CHECK_VK_RESULT(ctx.getQueue().submit(
+    vk::SubmitInfo{
+      .signalSemaphoreCount = 1,
+      .pSignalSemaphores = &available,
+    },
+    {}));
+
+  return Frame{
+    .image = image.get(),
+    .view = image.getView({}),
+    .available = available,
+  };
+}
+
+void OffscreenTarget::recordReadback(vk::CommandBuffer cmd)
+{
+  const auto& readback = readbacks[etna::get_context().getMainWorkCount().batchIndex()];
+
+  etna::set_state(
+    cmd,
+    image.get(),
+    vk::PipelineStageFlagBits2::eTransfer,
+    vk::AccessFlagBits2::eTransferRead,
+    vk::ImageLayout::eTransferSrcOptimal,
+    vk::ImageAspectFlagBits::eColor);
+  etna::flush_barriers(cmd);
+
+  cmd.copyImageToBuffer(
+    image.get(),
+    vk::ImageLayout::eTransferSrcOptimal,
+    readback.buffer.get(),
+    {vk::BufferImageCopy{
+      .bufferOffset = 0,
+      .bufferRowLength = 0,
+      .bufferImageHeight = 0,
+      .imageSubresource =
+        {
+          .aspectMask = vk::ImageAspectFlagBits::eColor,
+          .mipLevel = 0,
+          .baseArrayLayer = 0,
+          .layerCount = 1,
+        },
+      .imageOffset = {0, 0, 0},
+      .imageExtent = {resolution.x, resolution.y, 1},
+    }});
+
+  // Make the copy visible to host reads once the frame's fence has been waited on
+  const vk::MemoryBarrier2 toHost{
+    .srcStageMask = vk::PipelineStageFlagBits2::eTransfer,
+    .srcAccessMask = vk::AccessFlagBits2::eTransferWrite,
+    .dstStageMask = vk::PipelineStageFlagBits2::eHost,
+    .dstAccessMask = vk::AccessFlagBits2::eHostRead,
+  };
+  cmd.pipelineBarrier2(vk::DependencyInfo{
+    .memoryBarrierCount = 1,
+    .pMemoryBarriers = &toHost,
+  });
+}
+
+void OffscreenTarget::present(vk::Semaphore rendering_done)
+{
+  // A semaphore has to be unsignaled before it can be signaled again,
+  // so wait on it with an empty submission like a present would.
+  const vk::PipelineStageFlags waitStage = vk::PipelineStageFlagBits::eAllCommands;
+  ETNA_CHECK_VK_RESULT(etna::get_context().getQueue().submit(
+    vk::SubmitInfo{
+      .waitSemaphoreCount = 1,
+      .pWaitSemaphores = &rendering_done,
+      .pWaitDstStageMask = &waitStage,
+    },
+    {}));
+}
+
+void OffscreenTarget::finish()
+{
+  ZoneScoped;
+
+  ETNA_CHECK_VK_RESULT(etna::get_context().getDevice().waitIdle());
+
+  // Slots are consumed in frame order so that files are written in order when done inline
+  std::vector<Readback*> inFlight;
+  for (auto& readback : readbacks)
+    inFlight.push_back(&readback);
+  std::ranges::sort(
+    inFlight, {}, [](const Readback* readback) { return readback->frameIndex.value_or(0); });
+  for (auto* readback : inFlight)
+    consume(*readback);
+
+  for (auto& write : pendingWrites)
+    write.get();
+  pendingWrites.clear();
+}
+
+void OffscreenTarget::consume(Readback& readback)
+{
+  if (!readback.frameIndex.has_value())
+    return;
+
+  const std::uint64_t frameIndex = *std::exchange(readback.frameIndex, std::nullopt);
+
+  if (dumpDir.empty())
+    return;
+
+  ZoneScoped;
+
+  std::erase_if(pendingWrites, [](const std::future<void>& write) {
+    return write.wait_for(std::chrono::seconds{0}) == std::future_status::ready;
+  });
+
+  const std::size_t size = std::size_t{resolution.x} * resolution.y * 4;
+  std::vector<std::byte> pixels(size);
+  std::memcpy(pixels.data(), readback.buffer.data(), size);
+
+  auto write = [path = dumpDir / fmt::format("frame_{:05}.png", frameIndex),
+                res = resolution,
+                pixels = std::move(pixels),
+                bgra = is_bgra(format)]() mutable {
+    write_png(path, res, std::move(pixels), bgra);
+  };
+
+  if (threadPool != nullptr)
+    pendingWrites.push_back(threadPool->submit(std::move(write)));
+  else
+    write();
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <future>
+#include <optional>
+#include <vector>
+
+#include <etna/Buffer.hpp>
+#include <etna/Image.hpp>
+#include <glm/glm.hpp>
+
+#include "threading/ThreadPool.hpp"
+
+
+/**
+ * Stand-in for etna::Window when there is nothing to present to, e.g. on a build machine
+ * with a software Vulkan implementation. Frames are rendered into an offscreen image and
+ * copied into a host-visible buffer, one per frame in flight. A copy is only looked at when
+ * its frame slot comes around again, i.e. after the command manager waited for its fence,
+ * so reading frames back never stalls the GPU. PNG encoding is offloaded to a thread pool.
+ */
+class OffscreenTarget
+{
+public:
+  struct CreateInfo
+  {
+    glm::uvec2 resolution;
+    vk::Format format = vk::Format::eR8G8B8A8Srgb;
+    // Frames are written here as frame_NNNNN.png, nothing is written when empty
+    std::filesystem::path dumpDir;
+    // Encoding happens on the calling thread when no pool is provided
+    ThreadPool* threadPool = nullptr;
+  };
+
+  // Same shape as the swapchain image returned by etna::Window::acquireNext
+  struct Frame
+  {
+    vk::Image image;
+    vk::ImageView view;
+    vk::Semaphore available;
+  };
+
+  explicit OffscreenTarget(const CreateInfo& info);
+
+  // Must be called after the per-frame command manager has waited for the frame's
+  // previous submission. Hands the frame rendered in this slot back then over to encoding.
+  Frame acquireNext();
+
+  // Transitions the target to a transfer source and copies it into the current readback
+  // buffer. Should be the last thing recorded into the frame's command buffer.
+  void recordReadback(vk::CommandBuffer cmd);
+
+  // Consumes the semaphore signaled by the frame's submission, as presenting would.
+  void present(vk::Semaphore rendering_done);
+
+  // Waits for the device, then reads back and writes all frames that are still in flight.
+  void finish();
+
+  vk::Format getFormat() const { return format; }
+  glm::uvec2 getResolution() const { return resolution; }
+  std::uint64_t getFrameCount() const { return frameCount; }
+
+private:
+  struct Readback
+  {
+    etna::Buffer buffer;
+    vk::UniqueSemaphore available;
+    std::optional<std::uint64_t> frameIndex;
+  };
+
+  void consume(Readback& readback);
+
+private:
+  glm::uvec2 resolution;
+  vk::Format format;
+  std::filesystem::path dumpDir;
+  ThreadPool* threadPool;
+
+  etna::Image image;
+  // One per frame in flight, indexed by the batch index of the main work count
+  std::vector<Readback> readbacks;
+  std::uint64_t frameCount = 0;
+
+  std::vector<std::future<void>> pendingWrites;
+};
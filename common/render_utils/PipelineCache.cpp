@@ -0,0 +1,117 @@
+#include "PipelineCache.hpp"
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+#include <fmt/std.h>
+#include <etna/GlobalContext.hpp>
+
+
+namespace
+{
+
+struct FileHeader
+{
+  std::uint32_t magic;
+  std::uint32_t dataSize;
+  std::uint32_t vendorId;
+  std::uint32_t deviceId;
+  std::uint32_t driverVersion;
+  std::array<std::uint8_t, VK_UUID_SIZE> cacheUuid;
+
+  bool operator==(const FileHeader&) const = default;
+};
+
+constexpr std::uint32_t CACHE_FILE_MAGIC = 0x48434350; // "PCCH"
+
+FileHeader make_header(std::uint32_t data_size)
+{
+  const auto props = etna::get_context().getPhysicalDevice().getProperties();
+
+  FileHeader header{
+    .magic = CACHE_FILE_MAGIC,
+    .dataSize = data_size,
+    .vendorId = props.vendorID,
+    .deviceId = props.deviceID,
+    .driverVersion = props.driverVersion,
+    .cacheUuid = {},
+  };
+  std::copy(
+    std::begin(props.pipelineCacheUUID),
+    std::end(props.pipelineCacheUUID),
+    header.cacheUuid.begin());
+  return header;
+}
+
+std::vector<std::byte> load_cache_data(const std::filesystem::path& path)
+{
+  std::ifstream file(path, std::ios::binary);
+  if (!file)
+    return {};
+
+  FileHeader header{};
+  file.read(reinterpret_cast<char*>(&header), sizeof(header));
+  if (!file || header != make_header(header.dataSize))
+  {
+    spdlog::info("Pipeline cache '{}' was created for another device or driver, ignoring it", path);
+    return {};
+  }
+
+  std::vector<std::byte> data(header.dataSize);
+  file.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(data.size()));
+  if (!file)
+  {
+    spdlog::warn("Pipeline cache '{}' is truncated, ignoring it", path);
+    return {};
+  }
+
+  return data;
+}
+
+} // namespace
+
+PipelineCache::PipelineCache(std::filesystem::path cache_path)
+  : path{std::move(cache_path)}
+{
+  const auto initialData = load_cache_data(path);
+  warm = !initialData.empty();
+
+  cache = etna::unwrap_vk_result(
+    etna::get_context().getDevice().createPipelineCacheUnique(vk::PipelineCacheCreateInfo{
+      .initialDataSize = initialData.size(),
+      .pInitialData = initialData.data(),
+    }));
+}
+
+void PipelineCache::save() const
+{
+  const auto data =
+    etna::unwrap_vk_result(etna::get_context().getDevice().getPipelineCacheData(cache.get()));
+
+  const auto header = make_header(static_cast<std::uint32_t>(data.size()));
+
+  // Write to a temporary file first so that a crash never leaves a corrupted cache behind
+  auto tmpPath = path;
+  tmpPath += ".tmp";
+  {
+    std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(
+      reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+    if (!file)
+    {
+      spdlog::warn("Failed to write pipeline cache to '{}'", tmpPath);
+      return;
+    }
+  }
+
+  std::error_code ec;
+  std::filesystem::rename(tmpPath, path, ec);
+  if (ec)
+    spdlog::warn("Failed to save pipeline cache to '{}': {}", path, ec.message());
+  else
+    spdlog::info("Saved {} KiB of pipeline cache to '{}'", data.size() / 1024, path);
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <filesystem>
+
+#include <etna/Vulkan.hpp>
+
+
+/**
+ * A VkPipelineCache persisted to disk between runs. The file is tagged with the vendor,
+ * device, driver version and pipeline cache UUID of the current physical device, and
+ * stale files (e.g. after a driver update) are silently ignored, starting with an empty cache.
+ */
+class PipelineCache
+{
+public:
+  explicit PipelineCache(std::filesystem::path path);
+
+  PipelineCache(const PipelineCache&) = delete;
+  PipelineCache& operator=(const PipelineCache&) = delete;
+
+  // Writes the current contents of the cache to disk, replacing the old file
+  void save() const;
+
+  vk::PipelineCache get() const { return cache.get(); }
+
+  // Whether the cache was populated from disk on creation
+  bool isWarm() const { return warm; }
+
+private:
+  std::filesystem::path path;
+  vk::UniquePipelineCache cache;
+  bool warm = false;
+};
@@ -34,14 +34,15 @@ void QuadRenderer::render(
   vk::Image target_image,
   vk::ImageView target_image_view,
   const etna::Image& tex_to_draw,
-  const etna::Sampler& sampler)
+  const etna::Sampler& sampler,
+  etna::Image::ViewParams view)
 {
   auto programInfo = etna::get_shader_program(programId);
   auto set = etna::create_descriptor_set(
     programInfo.getDescriptorLayoutId(0),
     cmd_buf,
     {etna::Binding{
-      0, tex_to_draw.genBinding(sampler.get(), vk::ImageLayout::eShaderReadOnlyOptimal)}});
+      0, tex_to_draw.genBinding(sampler.get(), vk::ImageLayout::eShaderReadOnlyOptimal, view)}});
 
   etna::RenderTargetState renderTargets(
     cmd_buf,
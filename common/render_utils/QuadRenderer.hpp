@@ -26,7 +26,9 @@ public:
     vk::Image target_image,
     vk::ImageView target_image_view,
     const etna::Image& tex_to_draw,
-    const etna::Sampler& sampler);
+    const etna::Sampler& sampler,
+    // Must describe a single layer, e.g. to display one slice of an array image
+    etna::Image::ViewParams view = {});
 
 private:
   etna::GraphicsPipeline pipeline;
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <tracy/Tracy.hpp>
+
+#include "threading/ThreadPool.hpp"
+
+
+/**
+ * Parallel least-significant-digit radix sort over 64-bit keys, 8 bits per pass.
+ * Passes where all keys share the same digit are skipped, which is the common case
+ * for draw keys where the high bits (pipeline, material) have very few distinct values.
+ * The sort is stable. `scratch` must be at least as big as `items`.
+ * The result always ends up in `items`.
+ */
+template <class T, class KeyFn>
+void radix_sort(std::span<T> items, std::span<T> scratch, KeyFn&& key_of, ThreadPool* pool)
+{
+  ZoneScoped;
+
+  constexpr std::size_t RADIX_BITS = 8;
+  constexpr std::size_t BUCKETS = std::size_t{1} << RADIX_BITS;
+  constexpr std::size_t PASSES = 64 / RADIX_BITS;
+  // Below this, spreading work across threads costs more than it saves.
+  constexpr std::size_t MIN_ITEMS_PER_CHUNK = 4096;
+
+  using Histogram = std::array<std::uint32_t, BUCKETS>;
+
+  const std::size_t count = items.size();
+  if (count < 2)
+    return;
+
+  std::size_t chunkCount = 1;
+  if (pool != nullptr)
+    chunkCount = std::max<std::size_t>(
+      1, std::min(pool->concurrency(), count / MIN_ITEMS_PER_CHUNK));
+  const std::size_t chunkSize = (count + chunkCount - 1) / chunkCount;
+
+  auto forEachChunk = [&](auto&& func) {
+    if (chunkCount == 1)
+      func(std::size_t{0});
+    else
+      pool->parallelFor(chunkCount, func);
+  };
+
+  // Digit counts of the whole array for every pass, computed in a single sweep.
+  // These only depend on the set of keys, not on their order, so they stay valid
+  // between passes and tell us which passes can be skipped altogether.
+  std::vector<std::array<Histogram, PASSES>> totals(chunkCount);
+  forEachChunk([&](std::size_t chunk) {
+    auto& hist = totals[chunk];
+    for (auto& h : hist)
+      h.fill(0);
+
+    const std::size_t begin = std::min(count, chunk * chunkSize);
+    const std::size_t end = std::min(count, begin + chunkSize);
+    for (std::size_t i = begin; i < end; ++i)
+    {
+      const std::uint64_t key = key_of(items[i]);
+      for (std::size_t pass = 0; pass < PASSES; ++pass)
+        ++hist[pass][(key >> (pass * RADIX_BITS)) & (BUCKETS - 1)];
+    }
+  });
+
+  std::span<T> src = items;
+  std::span<T> dst = scratch.subspan(0, count);
+
+  std::vector<Histogram> offsets(chunkCount);
+  for (std::size_t pass = 0; pass < PASSES; ++pass)
+  {
+    bool trivial = false;
+    for (std::size_t bucket = 0; bucket < BUCKETS && !trivial; ++bucket)
+    {
+      std::size_t total = 0;
+      for (std::size_t chunk = 0; chunk < chunkCount; ++chunk)
+        total += totals[chunk][pass][bucket];
+      trivial = total == count;
+    }
+    if (trivial)
+      continue;
+
+    const std::size_t shift = pass * RADIX_BITS;
+
+    // Per-chunk counts do change after every scatter, so recount them.
+    if (chunkCount == 1)
+      offsets[0] = totals[0][pass];
+    else
+      forEachChunk([&](std::size_t chunk) {
+        auto& hist = offsets[chunk];
+        hist.fill(0);
+        const std::size_t begin = std::min(count, chunk * chunkSize);
+        const std::size_t end = std::min(count, begin + chunkSize);
+        for (std::size_t i = begin; i < end; ++i)
+          ++hist[(key_of(src[i]) >> shift) & (BUCKETS - 1)];
+      });
+
+    // Exclusive prefix sum over (bucket, chunk) pairs, so that each chunk scatters
+    // into its own disjoint ranges and the sort stays stable.
+    std::uint32_t running = 0;
+    for (std::size_t bucket = 0; bucket < BUCKETS; ++bucket)
+      for (std::size_t chunk = 0; chunk < chunkCount; ++chunk)
+      {
+        const std::uint32_t bucketCount = offsets[chunk][bucket];
+        offsets[chunk][bucket] = running;
+        running += bucketCount;
+      }
+
+    forEachChunk([&](std::size_t chunk) {
+      auto& offs = offsets[chunk];
+      const std::size_t begin = std::min(count, chunk * chunkSize);
+      const std::size_t end = std::min(count, begin + chunkSize);
+      for (std::size_t i = begin; i < end; ++i)
+      {
+        const std::size_t digit = (key_of(src[i]) >> shift) & (BUCKETS - 1);
+        dst[offs[digit]++] = src[i];
+      }
+    });
+
+    std::swap(src, dst);
+  }
+
+  if (src.data() != items.data())
+    std::copy(src.begin(), src.end(), items.begin());
+}
@@ -0,0 +1,92 @@
+#include "RenderQueue.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include <etna/Assert.hpp>
+
+#include "RadixSort.hpp"
+
+
+static constexpr std::uint64_t mask_of(std::uint32_t bits)
+{
+  return (std::uint64_t{1} << bits) - 1;
+}
+
+static constexpr std::uint32_t MESH_SHIFT = 0;
+static constexpr std::uint32_t DEPTH_SHIFT = MESH_SHIFT + RenderQueue::MESH_BITS;
+static constexpr std::uint32_t MATERIAL_SHIFT = DEPTH_SHIFT + RenderQueue::DEPTH_BITS;
+static constexpr std::uint32_t PIPELINE_SHIFT = MATERIAL_SHIFT + RenderQueue::MATERIAL_BITS;
+
+std::uint64_t RenderQueue::make_key(
+  std::uint32_t pipeline,
+  std::uint32_t material,
+  std::uint32_t mesh,
+  float depth,
+  DepthOrder order)
+{
+  ETNA_VERIFY(pipeline <= mask_of(PIPELINE_BITS));
+  ETNA_VERIFY(material <= mask_of(MATERIAL_BITS));
+  ETNA_VERIFY(mesh <= mask_of(MESH_BITS));
+
+  const float maxBucket = static_cast<float>(mask_of(DEPTH_BITS));
+  // NaN-s from degenerate transforms end up in the closest bucket
+  const float clamped = std::isnan(depth) ? 0.0f : std::clamp(depth, 0.0f, 1.0f);
+  auto bucket = static_cast<std::uint64_t>(clamped * maxBucket);
+  if (order == DepthOrder::BackToFront)
+    bucket = mask_of(DEPTH_BITS) - bucket;
+
+  return (std::uint64_t{pipeline} << PIPELINE_SHIFT) |
+    (std::uint64_t{material} << MATERIAL_SHIFT) | (bucket << DEPTH_SHIFT) |
+    (std::uint64_t{mesh} << MESH_SHIFT);
+}
+
+std::uint32_t RenderQueue::pipeline_of(std::uint64_t key)
+{
+  return static_cast<std::uint32_t>((key >> PIPELINE_SHIFT) & mask_of(PIPELINE_BITS));
+}
+
+std::uint32_t RenderQueue::material_of(std::uint64_t key)
+{
+  return static_cast<std::uint32_t>((key >> MATERIAL_SHIFT) & mask_of(MATERIAL_BITS));
+}
+
+void RenderQueue::clear()
+{
+  commands.clear();
+  batches.clear();
+}
+
+void RenderQueue::push(std::uint64_t key, std::uint32_t instance_idx, std::uint32_t relem_idx)
+{
+  commands.push_back(DrawCommand{
+    .key = key,
+    .instanceIdx = instance_idx,
+    .relemIdx = relem_idx,
+  });
+}
+
+void RenderQueue::sort(ThreadPool* pool)
+{
+  scratch.resize(commands.size());
+  radix_sort<DrawCommand>(
+    commands, scratch, [](const DrawCommand& cmd) { return cmd.key; }, pool);
+
+  batches.clear();
+  for (std::uint32_t i = 0; i < commands.size(); ++i)
+  {
+    const std::uint32_t pipeline = pipeline_of(commands[i].key);
+    const std::uint32_t material = material_of(commands[i].key);
+
+    if (batches.empty() || batches.back().pipeline != pipeline ||
+        batches.back().material != material)
+      batches.push_back(Batch{
+        .pipeline = pipeline,
+        .material = material,
+        .firstCommand = i,
+        .commandCount = 0,
+      });
+
+    ++batches.back().commandCount;
+  }
+}
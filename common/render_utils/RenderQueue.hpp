@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+
+class ThreadPool;
+
+/**
+ * A list of draws tagged with 64-bit sort keys. Sorting the keys groups draws that
+ * share a pipeline and a material together, minimizing state changes, and orders draws
+ * within such a group by depth.
+ *
+ * Key layout, from the most significant bits to the least significant ones:
+ * | pipeline (8) | material (16) | depth bucket (16) | mesh (24) |
+ * Depth goes before mesh so that opaque geometry is drawn front-to-back and early-Z
+ * gets to reject as much as possible, while equal meshes at similar depths still end up
+ * next to each other.
+ */
+class RenderQueue
+{
+public:
+  static constexpr std::uint32_t PIPELINE_BITS = 8;
+  static constexpr std::uint32_t MATERIAL_BITS = 16;
+  static constexpr std::uint32_t DEPTH_BITS = 16;
+  static constexpr std::uint32_t MESH_BITS = 24;
+
+  static_assert(PIPELINE_BITS + MATERIAL_BITS + DEPTH_BITS + MESH_BITS == 64);
+
+  enum class DepthOrder
+  {
+    // Opaque geometry
+    FrontToBack,
+    // Transparent geometry
+    BackToFront,
+  };
+
+  struct DrawCommand
+  {
+    std::uint64_t key;
+    std::uint32_t instanceIdx;
+    std::uint32_t relemIdx;
+  };
+
+  // A run of consecutive sorted commands that share a pipeline and a material,
+  // i.e. that can be drawn without any binds in between.
+  struct Batch
+  {
+    std::uint32_t pipeline;
+    std::uint32_t material;
+    std::uint32_t firstCommand;
+    std::uint32_t commandCount;
+  };
+
+  // `depth` is expected to be in [0, 1], 0 being the closest to the viewer
+  static std::uint64_t make_key(
+    std::uint32_t pipeline,
+    std::uint32_t material,
+    std::uint32_t mesh,
+    float depth,
+    DepthOrder order = DepthOrder::FrontToBack);
+
+  static std::uint32_t pipeline_of(std::uint64_t key);
+  static std::uint32_t material_of(std::uint64_t key);
+
+  void clear();
+  void push(std::uint64_t key, std::uint32_t instance_idx, std::uint32_t relem_idx);
+
+  // Sorts the commands by their keys and splits them into batches.
+  // Uses the pool (if any) for big queues.
+  void sort(ThreadPool* pool);
+
+  std::span<const DrawCommand> getCommands() const { return commands; }
+  std::span<const Batch> getBatches() const { return batches; }
+
+private:
+  std::vector<DrawCommand> commands;
+  std::vector<DrawCommand> scratch;
+  std::vector<Batch> batches;
+};
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstdint>
+
+
+/**
+ * Per-frame counters of the work submitted by a renderer.
+ * Reset at the start of every frame and incremented while recording.
+ */
+struct RenderStats
+{
+  std::uint32_t drawCalls = 0;
+  std::uint32_t instances = 0;
+  std::uint32_t pipelineBinds = 0;
+  std::uint32_t descriptorBinds = 0;
+  std::uint64_t triangles = 0;
+  std::uint64_t bytesUploaded = 0;
+};
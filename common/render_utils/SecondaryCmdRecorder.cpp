@@ -0,0 +1,119 @@
+#include "SecondaryCmdRecorder.hpp"
+
+#include <etna/GlobalContext.hpp>
+
+#include "threading/ThreadPool.hpp"
+
+
+SecondaryCmdRecorder::SecondaryCmdRecorder(ThreadPool& thread_pool)
+  : frameCommands{
+      etna::get_context().getMainWorkCount(), [&thread_pool](std::size_t) {
+        auto& ctx = etna::get_context();
+
+        FrameCommands result(thread_pool.concurrency());
+        for (auto& perThread : result)
+          perThread.pool = etna::unwrap_vk_result(
+            ctx.getDevice().createCommandPoolUnique(vk::CommandPoolCreateInfo{
+              .flags = vk::CommandPoolCreateFlagBits::eTransient,
+              .queueFamilyIndex = ctx.getQueueFamilyIdx(),
+            }));
+        return result;
+      }}
+{
+}
+
+void SecondaryCmdRecorder::beginFrame()
+{
+  auto device = etna::get_context().getDevice();
+
+  for (auto& perThread : frameCommands.get())
+  {
+    ETNA_CHECK_VK_RESULT(device.resetCommandPool(perThread.pool.get()));
+    perThread.used = 0;
+  }
+}
+
+vk::CommandBuffer SecondaryCmdRecorder::begin(const RenderingFormats& formats, vk::Rect2D area)
+{
+  auto& perThread = frameCommands.get()[ThreadPool::current_thread_index()];
+
+  if (perThread.used == perThread.buffers.size())
+  {
+    auto allocated = etna::unwrap_vk_result(
+      etna::get_context().getDevice().allocateCommandBuffers(vk::CommandBufferAllocateInfo{
+        .commandPool = perThread.pool.get(),
+        .level = vk::CommandBufferLevel::eSecondary,
+        .commandBufferCount = 1,
+      }));
+    perThread.buffers.push_back(allocated.front());
+  }
+
+  auto cmdBuf = perThread.buffers[perThread.used++];
+
+  vk::CommandBufferInheritanceRenderingInfo renderingInfo{
+    .colorAttachmentCount = static_cast<std::uint32_t>(formats.colorFormats.size()),
+    .pColorAttachmentFormats = formats.colorFormats.data(),
+    .depthAttachmentFormat = formats.depthFormat,
+    .rasterizationSamples = vk::SampleCountFlagBits::e1,
+  };
+
+  vk::CommandBufferInheritanceInfo inheritanceInfo{
+    .pNext = &renderingInfo,
+  };
+
+  ETNA_CHECK_VK_RESULT(cmdBuf.begin(vk::CommandBufferBeginInfo{
+    .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit |
+      vk::CommandBufferUsageFlagBits::eRenderPassContinue,
+    .pInheritanceInfo = &inheritanceInfo,
+  }));
+
+  // Dynamic state is not inherited from the primary command buffer
+  cmdBuf.setViewport(
+    0,
+    {vk::Viewport{
+      .x = static_cast<float>(area.offset.x),
+      .y = static_cast<float>(area.offset.y),
+      .width = static_cast<float>(area.extent.width),
+      .height = static_cast<float>(area.extent.height),
+      .minDepth = 0.0f,
+      .maxDepth = 1.0f,
+    }});
+  cmdBuf.setScissor(0, {area});
+
+  return cmdBuf;
+}
+
+void SecondaryCmdRecorder::begin_rendering(
+  vk::CommandBuffer primary,
+  vk::Rect2D area,
+  std::span<const Attachment> color_attachments,
+  std::optional<Attachment> depth_attachment)
+{
+  auto toVk = [](const Attachment& att) {
+    return vk::RenderingAttachmentInfo{
+      .imageView = att.view,
+      .imageLayout = att.layout,
+      .loadOp = att.loadOp,
+      .storeOp = att.storeOp,
+      .clearValue = att.clearValue,
+    };
+  };
+
+  std::vector<vk::RenderingAttachmentInfo> colors;
+  colors.reserve(color_attachments.size());
+  for (const auto& att : color_attachments)
+    colors.push_back(toVk(att));
+
+  std::optional<vk::RenderingAttachmentInfo> depth;
+  if (depth_attachment.has_value())
+    depth = toVk(*depth_attachment);
+
+  primary.beginRendering(vk::RenderingInfo{
+    .flags = vk::RenderingFlagBits::eContentsSecondaryCommandBuffers,
+    .renderArea = area,
+    .layerCount = 1,
+    .colorAttachmentCount = static_cast<std::uint32_t>(colors.size()),
+    .pColorAttachments = colors.data(),
+    .pDepthAttachment = depth.has_value() ? &*depth : nullptr,
+  });
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <optional>
+#include <span>
+#include <vector>
+
+#include <etna/Vulkan.hpp>
+#include <etna/GpuSharedResource.hpp>
+
+
+class ThreadPool;
+
+/**
+ * Hands out secondary command buffers for recording the contents of a dynamic rendering
+ * scope from several threads at once. Every thread of the pool gets its own command pool
+ * for every frame in flight, so no locking is needed as long as each thread only calls
+ * begin() for itself.
+ */
+class SecondaryCmdRecorder
+{
+public:
+  struct RenderingFormats
+  {
+    std::vector<vk::Format> colorFormats;
+    vk::Format depthFormat = vk::Format::eUndefined;
+  };
+
+  struct Attachment
+  {
+    vk::ImageView view;
+    vk::ImageLayout layout;
+    vk::AttachmentLoadOp loadOp = vk::AttachmentLoadOp::eClear;
+    vk::AttachmentStoreOp storeOp = vk::AttachmentStoreOp::eStore;
+    vk::ClearValue clearValue = {};
+  };
+
+  explicit SecondaryCmdRecorder(ThreadPool& thread_pool);
+
+  // Recycles all command buffers of the current frame in flight.
+  // Must be called after the frame's previous GPU work has been waited on.
+  void beginFrame();
+
+  // Returns a secondary command buffer that is ready to record draws for a dynamic
+  // rendering scope with the given formats. Viewport and scissor are set to cover `area`.
+  vk::CommandBuffer begin(const RenderingFormats& formats, vk::Rect2D area);
+
+  // Begins a dynamic rendering scope on the primary command buffer that
+  // may only contain vkCmdExecuteCommands. Images must already be in `layout`.
+  static void begin_rendering(
+    vk::CommandBuffer primary,
+    vk::Rect2D area,
+    std::span<const Attachment> color_attachments,
+    std::optional<Attachment> depth_attachment);
+
+private:
+  struct ThreadCommands
+  {
+    vk::UniqueCommandPool pool;
+    std::vector<vk::CommandBuffer> buffers;
+    std::size_t used = 0;
+  };
+
+  using FrameCommands = std::vector<ThreadCommands>;
+
+  etna::GpuSharedResource<FrameCommands> frameCommands;
+};
@@ -0,0 +1,249 @@
+#include "ShaderHotReloader.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <span>
+#include <sstream>
+#include <utility>
+
+#include <spdlog/spdlog.h>
+#include <fmt/std.h>
+#include <tracy/Tracy.hpp>
+#include <etna/Etna.hpp>
+#include <etna/GlobalContext.hpp>
+
+
+namespace fs = std::filesystem;
+
+// Written by target_add_shaders next to every compiled shader, one argument per line
+static constexpr std::string_view COMMAND_FILE_EXTENSION = ".cmd";
+// Argument of the command above naming the compiled binary
+static constexpr std::string_view OUTPUT_ARG = "-DOUTPUT=";
+static constexpr std::string_view TMP_EXTENSION = ".tmp";
+
+// Parses a make-style depfile as written by glslangValidator --depfile:
+// `output: input dep1 dep2 \` with spaces in paths escaped by a backslash
+static std::vector<fs::path> parse_depfile(const fs::path& path)
+{
+  std::ifstream file(path);
+  if (!file)
+    return {};
+
+  const std::string contents{std::istreambuf_iterator<char>(file), {}};
+
+  // Skip the target, colons of windows drive letters are never followed by a space
+  auto pos = contents.find(": ");
+  if (pos == std::string::npos)
+    return {};
+  pos += 2;
+
+  std::vector<fs::path> result;
+  std::string current;
+  for (; pos < contents.size(); ++pos)
+  {
+    const char c = contents[pos];
+    if (c == '\\' && pos + 1 < contents.size() &&
+      (contents[pos + 1] == ' ' || contents[pos + 1] == '\n' || contents[pos + 1] == '\r'))
+    {
+      if (contents[pos + 1] == ' ')
+        current += ' ';
+      ++pos;
+    }
+    else if (c == ' ' || c == '\n' || c == '\r' || c == '\t')
+    {
+      if (!current.empty())
+        result.emplace_back(std::exchange(current, {}));
+    }
+    else
+      current += c;
+  }
+  if (!current.empty())
+    result.emplace_back(std::move(current));
+
+  return result;
+}
+
+static fs::file_time_type newest_write_time(std::span<const fs::path> paths)
+{
+  auto result = fs::file_time_type::min();
+  for (const auto& path : paths)
+  {
+    std::error_code ec;
+    const auto time = fs::last_write_time(path, ec);
+    if (!ec)
+      result = std::max(result, time);
+  }
+  return result;
+}
+
+ShaderHotReloader::ShaderHotReloader(CreateInfo create_info)
+  : info{std::move(create_info)}
+  , watcher{[this](std::stop_token stop) { watchLoop(stop); }}
+{
+}
+
+void ShaderHotReloader::requestFullRebuild()
+{
+  fullRebuildRequested = true;
+  wakeCv.notify_all();
+}
+
+bool ShaderHotReloader::applyPendingReloads()
+{
+  if (!reloadPending.exchange(false))
+    return false;
+
+  ZoneScoped;
+
+  // Frames in flight may still use the old pipelines. This is a much smaller hiccup
+  // than before though, as compilation itself happened on the watcher thread.
+  ETNA_CHECK_VK_RESULT(etna::get_context().getQueue().waitIdle());
+  {
+    // The watcher must not replace binaries while etna reads them
+    std::unique_lock lock{binariesMutex};
+    etna::reload_shaders();
+  }
+
+  spdlog::info("Reloaded shaders");
+  return true;
+}
+
+void ShaderHotReloader::discoverShaders()
+{
+  for (const auto& dir : info.shaderDirs)
+  {
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator(dir, ec))
+    {
+      const auto& cmdPath = entry.path();
+      if (cmdPath.extension() != COMMAND_FILE_EXTENSION)
+        continue;
+
+      WatchedShader shader;
+      shader.binary = cmdPath.parent_path() / cmdPath.stem();
+
+      std::ifstream file(cmdPath);
+      for (std::string line; std::getline(file, line);)
+        if (!line.empty())
+          shader.command.push_back(std::move(line));
+
+      auto depfile = shader.binary;
+      depfile += ".d";
+      shader.sources = parse_depfile(depfile);
+
+      if (shader.command.empty() || shader.sources.empty())
+      {
+        spdlog::warn("Shader hot reload: can't watch '{}', was it ever built?", shader.binary);
+        continue;
+      }
+
+      shader.newestSeenSource = fs::last_write_time(shader.binary, ec);
+      shaders.push_back(std::move(shader));
+    }
+
+    if (ec)
+      spdlog::warn("Shader hot reload: can't scan '{}': {}", dir, ec.message());
+  }
+
+  spdlog::info("Shader hot reload: watching {} shaders", shaders.size());
+}
+
+void ShaderHotReloader::watchLoop(std::stop_token stop)
+{
+  tracy::SetThreadName("shader reloader");
+
+  discoverShaders();
+
+  while (!stop.stop_requested())
+  {
+    const bool forceAll = fullRebuildRequested.exchange(false);
+
+    bool anyCompiled = false;
+    for (auto& shader : shaders)
+    {
+      const auto newestSource = newest_write_time(shader.sources);
+      if (!forceAll && newestSource <= shader.newestSeenSource)
+        continue;
+
+      // Failed compilations are not retried until sources change once again
+      shader.newestSeenSource = newestSource;
+      anyCompiled = compile(shader) || anyCompiled;
+    }
+
+    if (anyCompiled)
+      reloadPending = true;
+
+    std::unique_lock lock{wakeMutex};
+    wakeCv.wait_for(
+      lock, stop, info.pollInterval, [this]() { return fullRebuildRequested.load(); });
+  }
+}
+
+bool ShaderHotReloader::compile(WatchedShader& shader)
+{
+  const auto name = shader.binary.filename().string();
+
+  ZoneScoped;
+  ZoneText(name.c_str(), name.size());
+
+  // Compiled next to the binary and moved over it on success, so that etna never sees
+  // a partially written binary, and a failed compilation leaves the old one intact
+  auto tmpBinary = shader.binary;
+  tmpBinary += TMP_EXTENSION;
+
+  std::ostringstream commandLine;
+  for (const auto& arg : shader.command)
+    if (arg.starts_with(OUTPUT_ARG))
+      commandLine << '"' << OUTPUT_ARG << tmpBinary.string() << "\" ";
+    else
+      commandLine << '"' << arg << "\" ";
+
+  std::string command = commandLine.str();
+#ifdef _WIN32
+  // cmd.exe strips the outermost quotes of the whole line
+  command = '"' + command + '"';
+#endif
+
+  spdlog::info("Shader hot reload: compiling '{}'", name);
+
+  const bool compiled = std::system(command.c_str()) == 0;
+
+  auto tmpDepfile = tmpBinary;
+  tmpDepfile += ".d";
+  auto tmpHashfile = tmpBinary;
+  tmpHashfile += ".hash";
+
+  // Includes might have changed
+  auto sources = parse_depfile(tmpDepfile);
+
+  std::error_code renameError;
+  if (compiled)
+  {
+    std::unique_lock lock{binariesMutex};
+    fs::rename(tmpBinary, shader.binary, renameError);
+  }
+
+  std::error_code ec;
+  fs::remove(tmpBinary, ec);
+  fs::remove(tmpDepfile, ec);
+  fs::remove(tmpHashfile, ec);
+
+  if (!compiled)
+  {
+    spdlog::error("Shader hot reload: failed to compile '{}'", name);
+    return false;
+  }
+
+  if (renameError)
+  {
+    spdlog::error(
+      "Shader hot reload: failed to replace '{}': {}", shader.binary, renameError.message());
+    return false;
+  }
+
+  if (!sources.empty())
+    shader.sources = std::move(sources);
+
+  return true;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <mutex>
+#include <condition_variable>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+/**
+ * Watches GLSL sources of compiled shaders and recompiles the ones that changed on a
+ * background thread, so that editing a shader never stalls the app for a build.
+ *
+ * Shaders are discovered through the `.spv.cmd` files target_add_shaders puts next to
+ * the SPIR-V, which hold the exact compiler command line. Dependencies on included files
+ * are read from the depfiles the compiler writes, so touching a helper .glsl file
+ * recompiles every shader including it and nothing else.
+ *
+ * Shaders are compiled into a temporary file which then replaces the binary, never while
+ * etna is reading binaries, so a reload never sees a partially written one.
+ * Recompiled binaries are only picked up by etna in applyPendingReloads,
+ * which is meant to be called at a frame boundary.
+ */
+class ShaderHotReloader
+{
+public:
+  struct CreateInfo
+  {
+    // Directories with compiled shaders, e.g. <TARGET>_SHADERS_ROOT
+    std::vector<std::filesystem::path> shaderDirs;
+    std::chrono::milliseconds pollInterval{250};
+  };
+
+  explicit ShaderHotReloader(CreateInfo info);
+
+  ShaderHotReloader(const ShaderHotReloader&) = delete;
+  ShaderHotReloader& operator=(const ShaderHotReloader&) = delete;
+
+  // Recompiles all watched shaders regardless of their timestamps
+  void requestFullRebuild();
+
+  // Reloads etna programs and pipelines if something was recompiled since the last call.
+  // Waits for the GPU to finish the frames in flight, as etna destroys old pipelines right away.
+  // Returns whether a reload happened.
+  bool applyPendingReloads();
+
+private:
+  struct WatchedShader
+  {
+    std::filesystem::path binary;
+    std::vector<std::string> command;
+    std::vector<std::filesystem::path> sources;
+    std::filesystem::file_time_type newestSeenSource;
+  };
+
+  void discoverShaders();
+  void watchLoop(std::stop_token stop);
+  bool compile(WatchedShader& shader);
+
+private:
+  CreateInfo info;
+
+  // Only touched by the watcher thread
+  std::vector<WatchedShader> shaders;
+
+  std::atomic<bool> fullRebuildRequested = false;
+  std::atomic<bool> reloadPending = false;
+
+  // Held by the main thread while etna reads binaries, and by the watcher while it replaces one
+  std::mutex binariesMutex;
+
+  std::mutex wakeMutex;
+  std::condition_variable_any wakeCv;
+
+  // Must be the last member, so that it is stopped and joined before everything else is destroyed
+  std::jthread watcher;
+};
@@ -0,0 +1,53 @@
+#include "ShaderVariants.hpp"
+
+#include <bit>
+
+#include <etna/Etna.hpp>
+#include <etna/Assert.hpp>
+#include <spdlog/spdlog.h>
+#include <tracy/Tracy.hpp>
+
+
+void ShaderVariants::registerProgram(std::string name, std::vector<Variant> variants)
+{
+  auto& registered = programs[name];
+  ETNA_VERIFYF(registered.empty(), "Shader program '{}' is already registered!", name);
+
+  for (auto& variant : variants)
+  {
+    auto programName = fmt::format("{}[{:#x}]", name, variant.features);
+    registered.push_back(RegisteredVariant{
+      .variant = std::move(variant),
+      .programName = std::move(programName),
+    });
+  }
+}
+
+const std::string& ShaderVariants::request(const std::string& name, FeatureMask features)
+{
+  auto it = programs.find(name);
+  ETNA_VERIFYF(it != programs.end(), "Shader program '{}' is not registered!", name);
+
+  RegisteredVariant* best = nullptr;
+  for (auto& candidate : it->second)
+  {
+    if ((candidate.variant.features & features) != features)
+      continue;
+    if (best == nullptr ||
+      std::popcount(candidate.variant.features) < std::popcount(best->variant.features))
+      best = &candidate;
+  }
+
+  ETNA_VERIFYF(
+    best != nullptr, "Shader program '{}' has no variant with features {:#x}!", name, features);
+
+  if (!best->created)
+  {
+    ZoneScopedN("createShaderVariant");
+    etna::create_program(best->programName.c_str(), best->variant.shaders);
+    best->created = true;
+    spdlog::info("Created shader variant {}", best->programName);
+  }
+
+  return best->programName;
+}
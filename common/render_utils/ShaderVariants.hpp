@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+
+/**
+ * Registry of precompiled variants of shader programs. A variant is a set of SPIR-V files
+ * built with some features toggled on, either through defines or specialization constants
+ * frozen at build time (see target_add_shader_variant in cmake/shaders.cmake).
+ *
+ * Passes ask for the features they need and get the variant with the fewest features
+ * providing all of them, e.g. a depth-only pass gets a position-only vertex shader.
+ * etna programs are only created the first time a variant is requested.
+ */
+class ShaderVariants
+{
+public:
+  using FeatureMask = std::uint32_t;
+
+  struct Variant
+  {
+    FeatureMask features;
+    std::vector<std::filesystem::path> shaders;
+  };
+
+  void registerProgram(std::string name, std::vector<Variant> variants);
+
+  // Returns the name of the etna program implementing the best variant for `features`
+  const std::string& request(const std::string& name, FeatureMask features);
+
+private:
+  struct RegisteredVariant
+  {
+    Variant variant;
+    std::string programName;
+    bool created = false;
+  };
+
+  std::unordered_map<std::string, std::vector<RegisteredVariant>> programs;
+};
@@ -0,0 +1,124 @@
+#include "ShadowAtlas.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+
+#include <etna/Assert.hpp>
+
+
+ShadowAtlas::ShadowAtlas(const CreateInfo& info)
+  : size{info.size}
+  , minTileSize{info.minTileSize}
+{
+  ETNA_VERIFYF(
+    std::has_single_bit(size) && std::has_single_bit(minTileSize) && minTileSize <= size,
+    "Bad shadow atlas sizes {} and {}, both must be powers of two!",
+    size,
+    minTileSize);
+
+  freeTiles.resize(levelOf(minTileSize) + 1);
+  reset();
+}
+
+void ShadowAtlas::reset()
+{
+  for (auto& tiles : freeTiles)
+    tiles.clear();
+  freeTiles[0].push_back({0, 0});
+  allocatedArea = 0;
+}
+
+std::uint32_t ShadowAtlas::levelOf(std::uint32_t tile_size) const
+{
+  return static_cast<std::uint32_t>(std::countr_zero(size) - std::countr_zero(tile_size));
+}
+
+std::optional<ShadowAtlas::Tile> ShadowAtlas::allocate(std::uint32_t tile_size)
+{
+  tile_size = std::bit_ceil(std::clamp(tile_size, minTileSize, size));
+
+  const auto offset = takeFree(levelOf(tile_size));
+  if (!offset.has_value())
+    return std::nullopt;
+
+  allocatedArea += std::uint64_t{tile_size} * tile_size;
+  return Tile{.offset = *offset, .size = tile_size};
+}
+
+std::optional<glm::uvec2> ShadowAtlas::takeFree(std::uint32_t level)
+{
+  auto& tiles = freeTiles[level];
+  if (!tiles.empty())
+  {
+    const auto result = tiles.back();
+    tiles.pop_back();
+    return result;
+  }
+
+  if (level == 0)
+    return std::nullopt;
+
+  // Split a bigger tile, handing out its first quadrant and keeping the rest
+  const auto parent = takeFree(level - 1);
+  if (!parent.has_value())
+    return std::nullopt;
+
+  const std::uint32_t half = sizeOf(level);
+  tiles.push_back(*parent + glm::uvec2{half, half});
+  tiles.push_back(*parent + glm::uvec2{0, half});
+  tiles.push_back(*parent + glm::uvec2{half, 0});
+  return *parent;
+}
+
+void ShadowAtlas::free(const Tile& tile)
+{
+  ETNA_VERIFYF(
+    std::has_single_bit(tile.size) && tile.size >= minTileSize && tile.size <= size,
+    "Tile of size {} does not belong to this atlas!",
+    tile.size);
+
+  allocatedArea -= std::uint64_t{tile.size} * tile.size;
+
+  std::uint32_t level = levelOf(tile.size);
+  glm::uvec2 offset = tile.offset;
+
+  // Merge with the siblings for as long as all of them are free
+  while (level > 0)
+  {
+    const std::uint32_t parentSize = sizeOf(level - 1);
+    const std::uint32_t half = sizeOf(level);
+    const glm::uvec2 parent = offset / parentSize * parentSize;
+
+    const std::array<glm::uvec2, 4> quadrants{
+      parent, parent + glm::uvec2{half, 0}, parent + glm::uvec2{0, half}, parent + half};
+
+    std::array<glm::uvec2, 3> siblings;
+    std::size_t siblingCount = 0;
+    for (const auto& quadrant : quadrants)
+      if (quadrant != offset)
+        siblings[siblingCount++] = quadrant;
+
+    auto& tiles = freeTiles[level];
+    const bool allFree = std::ranges::all_of(siblings, [&tiles](const glm::uvec2& sibling) {
+      return std::ranges::find(tiles, sibling) != tiles.end();
+    });
+    if (!allFree)
+      break;
+
+    std::erase_if(tiles, [&siblings](const glm::uvec2& t) {
+      return std::ranges::find(siblings, t) != siblings.end();
+    });
+
+    offset = parent;
+    --level;
+  }
+
+  freeTiles[level].push_back(offset);
+}
+
+float ShadowAtlas::getOccupancy() const
+{
+  return static_cast<float>(
+    static_cast<double>(allocatedArea) / (static_cast<double>(size) * static_cast<double>(size)));
+}
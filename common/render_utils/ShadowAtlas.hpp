@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+
+/**
+ * Allocator of square tiles within a single shadow map texture shared by many lights.
+ * The atlas is a quadtree: every tile is either free, allocated or split into four
+ * quadrants of half its size, so tile sizes are powers of two between the minimum
+ * tile size and the size of the whole atlas. Freeing all four quadrants of a tile
+ * merges them back, so the atlas doesn't fragment over time.
+ *
+ * Only the layout is managed here, the texture itself belongs to the renderer.
+ */
+class ShadowAtlas
+{
+public:
+  struct CreateInfo
+  {
+    // Both have to be powers of two
+    std::uint32_t size = 4096;
+    std::uint32_t minTileSize = 128;
+  };
+
+  struct Tile
+  {
+    glm::uvec2 offset = {};
+    std::uint32_t size = 0;
+  };
+
+  explicit ShadowAtlas(const CreateInfo& info);
+
+  // Size is rounded up to a power of two and clamped to the supported range.
+  // Returns nothing if there is no free space left for a tile of that size.
+  std::optional<Tile> allocate(std::uint32_t size);
+  void free(const Tile& tile);
+  // Frees all tiles at once
+  void reset();
+
+  std::uint32_t getSize() const { return size; }
+  std::uint32_t getMinTileSize() const { return minTileSize; }
+  // Fraction of the atlas area that is currently allocated
+  float getOccupancy() const;
+
+private:
+  std::uint32_t levelOf(std::uint32_t tile_size) const;
+  std::uint32_t sizeOf(std::uint32_t level) const { return size >> level; }
+
+  std::optional<glm::uvec2> takeFree(std::uint32_t level);
+
+private:
+  std::uint32_t size;
+  std::uint32_t minTileSize;
+  // Free tiles of every quadtree level, level 0 being the whole atlas
+  std::vector<std::vector<glm::uvec2>> freeTiles;
+  std::uint64_t allocatedArea = 0;
+};
@@ -0,0 +1,58 @@
+#include "UploadRing.hpp"
+
+#include <algorithm>
+
+#include <etna/GlobalContext.hpp>
+
+
+static vk::DeviceSize align_up(vk::DeviceSize value, vk::DeviceSize alignment)
+{
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+UploadRing::UploadRing(const CreateInfo& info)
+{
+  auto& ctx = etna::get_context();
+
+  const auto limits = ctx.getPhysicalDevice().getProperties().limits;
+  alignment = std::max(
+    {vk::DeviceSize{16},
+     limits.minUniformBufferOffsetAlignment,
+     limits.minStorageBufferOffsetAlignment});
+
+  regionSize = align_up(info.perFrameSize, alignment);
+
+  buffer = ctx.createBuffer(etna::Buffer::CreateInfo{
+    .size = regionSize * ctx.getMainWorkCount().multiBufferingCount(),
+    .bufferUsage = info.bufferUsage,
+    .memoryUsage = VMA_MEMORY_USAGE_CPU_TO_GPU,
+    .name = info.name,
+  });
+
+  buffer.map();
+}
+
+void UploadRing::beginFrame()
+{
+  regionBegin = regionSize * etna::get_context().getMainWorkCount().batchIndex();
+  cursor = 0;
+}
+
+UploadRing::Allocation UploadRing::allocate(vk::DeviceSize size)
+{
+  const vk::DeviceSize offset = align_up(cursor, alignment);
+  ETNA_VERIFYF(
+    offset + size <= regionSize,
+    "Upload ring is out of space: {} bytes requested, {} of {} used this frame",
+    size,
+    cursor,
+    regionSize);
+
+  cursor = offset + size;
+
+  return Allocation{
+    .data = buffer.data() + regionBegin + offset,
+    .offset = regionBegin + offset,
+    .size = size,
+  };
+}
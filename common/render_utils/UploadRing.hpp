@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+#include <etna/Buffer.hpp>
+
+
+/**
+ * Linear allocator for data that changes every frame, e.g. uniform buffer contents.
+ * A single persistently mapped buffer is split into one region per frame in flight,
+ * allocations are bumped from the region of the current frame and the whole region
+ * is recycled when the frame comes around again, i.e. after its fence was waited on.
+ *
+ * Allocations are identified by offsets into a single buffer, so they can be bound
+ * either through descriptor sets created every frame or as dynamic offsets.
+ */
+class UploadRing
+{
+public:
+  struct CreateInfo
+  {
+    // Upper bound on how much data a single frame may upload
+    vk::DeviceSize perFrameSize;
+    vk::BufferUsageFlags bufferUsage =
+      vk::BufferUsageFlagBits::eUniformBuffer | vk::BufferUsageFlagBits::eStorageBuffer;
+    std::string name = "upload_ring";
+  };
+
+  struct Allocation
+  {
+    std::byte* data = nullptr;
+    vk::DeviceSize offset = 0;
+    vk::DeviceSize size = 0;
+  };
+
+  explicit UploadRing(const CreateInfo& info);
+
+  // Switches to the region of the current frame in flight. Must be called every frame
+  // after the per-frame command manager has waited for the frame's previous submission.
+  void beginFrame();
+
+  // Offsets are aligned to both uniform and storage buffer offset requirements of the device
+  Allocation allocate(vk::DeviceSize size);
+
+  template <class T>
+  Allocation push(const T& value)
+  {
+    static_assert(std::is_trivially_copyable_v<T>);
+    auto result = allocate(sizeof(T));
+    std::memcpy(result.data, &value, sizeof(T));
+    return result;
+  }
+
+  etna::BufferBinding genBinding(const Allocation& allocation) const
+  {
+    return buffer.genBinding(allocation.offset, allocation.size);
+  }
+
+  const etna::Buffer& getBuffer() const { return buffer; }
+  // Bytes allocated since the last beginFrame, including alignment padding
+  vk::DeviceSize getFrameUsage() const { return cursor; }
+
+private:
+  etna::Buffer buffer;
+  vk::DeviceSize alignment;
+  vk::DeviceSize regionSize;
+  vk::DeviceSize regionBegin = 0;
+  vk::DeviceSize cursor = 0;
+};
@@ -0,0 +1,13 @@
+#ifndef SCENE_INSTANCES_GLSL_INCLUDED
+#define SCENE_INSTANCES_GLSL_INCLUDED
+
+// Matches InstanceData from scene/SceneManager.hpp,
+// instances are indexed with gl_InstanceIndex through firstInstance of draw calls
+struct InstanceData
+{
+  mat4 model;
+  // Only the upper 3x3 part is meaningful
+  mat4 normalMatrix;
+};
+
+#endif // SCENE_INSTANCES_GLSL_INCLUDED
@@ -0,0 +1,52 @@
+#include "BoundingBox.hpp"
+
+#include <array>
+
+
+BoundingBox BoundingBox::transformed(const glm::mat4x4& tm) const
+{
+  if (empty())
+    return {};
+
+  // Extents of a transformed box are the extents projected onto every axis
+  const glm::vec3 newCenter = glm::vec3(tm * glm::vec4(center(), 1.0f));
+  const glm::mat3x3 absTm{
+    glm::abs(glm::vec3(tm[0])), glm::abs(glm::vec3(tm[1])), glm::abs(glm::vec3(tm[2]))};
+  const glm::vec3 newExtents = absTm * extents();
+
+  return BoundingBox{.min = newCenter - newExtents, .max = newCenter + newExtents};
+}
+
+bool is_box_visible(const BoundingBox& box, const glm::mat4x4& glob_tm)
+{
+  if (box.empty())
+    return false;
+
+  std::array<glm::vec4, 8> corners;
+  for (std::size_t i = 0; i < corners.size(); ++i)
+  {
+    const glm::vec3 corner{
+      (i & 1) != 0 ? box.max.x : box.min.x,
+      (i & 2) != 0 ? box.max.y : box.min.y,
+      (i & 4) != 0 ? box.max.z : box.min.z,
+    };
+    corners[i] = glob_tm * glm::vec4(corner, 1.0f);
+  }
+
+  // The box is invisible only if all of its corners are outside of the same clip plane.
+  // Plane tests are linear in homogeneous coordinates, so no division by w is needed.
+  const auto allOutside = [&](auto&& outside) {
+    for (const auto& corner : corners)
+      if (!outside(corner))
+        return false;
+    return true;
+  };
+
+  return !(
+    allOutside([](const glm::vec4& c) { return c.x < -c.w; }) ||
+    allOutside([](const glm::vec4& c) { return c.x > c.w; }) ||
+    allOutside([](const glm::vec4& c) { return c.y < -c.w; }) ||
+    allOutside([](const glm::vec4& c) { return c.y > c.w; }) ||
+    allOutside([](const glm::vec4& c) { return c.z < 0.0f; }) ||
+    allOutside([](const glm::vec4& c) { return c.z > c.w; }));
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <limits>
+
+#include <glm/glm.hpp>
+
+
+/**
+ * Axis-aligned bounding box. A default constructed box is empty,
+ * i.e. extending it by anything results in that thing.
+ */
+struct BoundingBox
+{
+  glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+  glm::vec3 max = glm::vec3(std::numeric_limits<float>::lowest());
+
+  bool empty() const { return glm::any(glm::greaterThan(min, max)); }
+
+  void extend(const glm::vec3& point)
+  {
+    min = glm::min(min, point);
+    max = glm::max(max, point);
+  }
+
+  void extend(const BoundingBox& other)
+  {
+    min = glm::min(min, other.min);
+    max = glm::max(max, other.max);
+  }
+
+  glm::vec3 center() const { return (min + max) * 0.5f; }
+  glm::vec3 extents() const { return (max - min) * 0.5f; }
+
+  // Bounds of the box transformed by an affine matrix, which are larger than
+  // the box itself unless the matrix is a combination of scales and translations
+  BoundingBox transformed(const glm::mat4x4& tm) const;
+};
+
+// Conservative test of a box against the clip volume of a projection matrix, i.e. the box
+// may be reported as visible when it is not, but never the other way around
+bool is_box_visible(const BoundingBox& box, const glm::mat4x4& glob_tm);
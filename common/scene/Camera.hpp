@@ -40,8 +40,13 @@ struct Camera
 
   glm::mat4x4 viewTm() const { return inverse(viewItm()); }
 
-  glm::mat4x4 projTm(float aspect) const
+  // Jitter is an offset in NDC applied to the whole image, e.g. for temporal anti-aliasing
+  glm::mat4x4 projTm(float aspect, glm::vec2 jitter = {}) const
   {
-    return glm::perspectiveLH_ZO(-glm::radians(fov), aspect, zNear, zFar);
+    auto result = glm::perspectiveLH_ZO(-glm::radians(fov), aspect, zNear, zFar);
+    // Clip space w is view space z, so these turn into constant offsets after division
+    result[2][0] += jitter.x;
+    result[2][1] += jitter.y;
+    return result;
   }
 };
@@ -0,0 +1,111 @@
+#include "CameraPath.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include <etna/Assert.hpp>
+#include <fmt/format.h>
+#include <fmt/std.h>
+
+
+static glm::vec3 catmull_rom(glm::vec3 p0, glm::vec3 p1, glm::vec3 p2, glm::vec3 p3, float t)
+{
+  const float t2 = t * t;
+  const float t3 = t2 * t;
+  return 0.5f *
+    (2.0f * p1 + (p2 - p0) * t + (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * t2 +
+     (3.0f * p1 - p0 - 3.0f * p2 + p3) * t3);
+}
+
+CameraPath CameraPath::load(const std::filesystem::path& path)
+{
+  std::ifstream file(path);
+  ETNA_VERIFYF(file.is_open(), "Unable to open camera path {}", path);
+
+  CameraPath result;
+
+  std::string line;
+  for (std::size_t lineNumber = 1; std::getline(file, line); ++lineNumber)
+  {
+    if (line.empty() || line.front() == '#')
+      continue;
+
+    Keyframe keyframe{};
+    auto& cam = keyframe.camera;
+
+    std::istringstream in(line);
+    in >> keyframe.time >> cam.position.x >> cam.position.y >> cam.position.z >>
+      cam.rotation.x >> cam.rotation.y >> cam.rotation.z >> cam.rotation.w >> cam.fov;
+    ETNA_VERIFYF(!in.fail(), "Malformed keyframe at {}:{}", path, lineNumber);
+
+    result.addKeyframe(keyframe.time, keyframe.camera);
+  }
+
+  ETNA_VERIFYF(!result.empty(), "Camera path {} has no keyframes", path);
+
+  return result;
+}
+
+void CameraPath::save(const std::filesystem::path& path) const
+{
+  std::ofstream file(path);
+  ETNA_VERIFYF(file.is_open(), "Unable to write camera path {}", path);
+
+  file << "# time pos.x pos.y pos.z rot.x rot.y rot.z rot.w fov\n";
+  for (const auto& [time, cam] : keyframes)
+    file << fmt::format(
+      "{} {} {} {} {} {} {} {} {}\n",
+      time,
+      cam.position.x,
+      cam.position.y,
+      cam.position.z,
+      cam.rotation.x,
+      cam.rotation.y,
+      cam.rotation.z,
+      cam.rotation.w,
+      cam.fov);
+}
+
+void CameraPath::addKeyframe(float time, const Camera& camera)
+{
+  ETNA_VERIFYF(
+    empty() || time > keyframes.back().time,
+    "Camera keyframes must be added in order, got {} after {}",
+    time,
+    keyframes.back().time);
+
+  keyframes.push_back(Keyframe{.time = time, .camera = camera});
+}
+
+Camera CameraPath::evaluate(float time) const
+{
+  ETNA_VERIFY(!empty());
+
+  if (time <= keyframes.front().time)
+    return keyframes.front().camera;
+  if (time >= keyframes.back().time)
+    return keyframes.back().camera;
+
+  // First keyframe strictly after the time, there is always one before it
+  const auto next = std::upper_bound(
+    keyframes.begin(), keyframes.end(), time, [](float t, const Keyframe& keyframe) {
+      return t < keyframe.time;
+    });
+  const std::size_t i = static_cast<std::size_t>(next - keyframes.begin());
+
+  const auto& from = keyframes[i - 1];
+  const auto& to = keyframes[i];
+  const auto& before = keyframes[i > 1 ? i - 2 : i - 1];
+  const auto& after = keyframes[std::min(i + 1, keyframes.size() - 1)];
+
+  const float t = (time - from.time) / (to.time - from.time);
+
+  Camera result = from.camera;
+  result.position = catmull_rom(
+    before.camera.position, from.camera.position, to.camera.position, after.camera.position, t);
+  result.rotation = glm::slerp(from.camera.rotation, to.camera.rotation, t);
+  result.fov = glm::mix(from.camera.fov, to.camera.fov, t);
+  return result;
+}
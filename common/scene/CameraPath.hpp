@@ -0,0 +1,42 @@
+#pragma once
+
+#include <filesystem>
+#include <vector>
+
+#include "scene/Camera.hpp"
+
+
+/**
+ * A camera flythrough defined by keyframes. Positions are interpolated with a
+ * Catmull-Rom spline, so the camera moves smoothly through every keyframe,
+ * rotations are slerped and the rest of the parameters are lerped.
+ *
+ * Stored as a text file with one keyframe per line:
+ *   time pos.x pos.y pos.z rot.x rot.y rot.z rot.w fov
+ * Empty lines and lines starting with '#' are ignored.
+ */
+class CameraPath
+{
+public:
+  struct Keyframe
+  {
+    float time;
+    Camera camera;
+  };
+
+  static CameraPath load(const std::filesystem::path& path);
+  void save(const std::filesystem::path& path) const;
+
+  // Keyframes must be added in order of increasing time
+  void addKeyframe(float time, const Camera& camera);
+
+  // Times outside of the path are clamped to its ends
+  Camera evaluate(float time) const;
+
+  bool empty() const { return keyframes.empty(); }
+  float duration() const { return empty() ? 0.0f : keyframes.back().time; }
+  const std::vector<Keyframe>& getKeyframes() const { return keyframes; }
+
+private:
+  std::vector<Keyframe> keyframes;
+};
@@ -126,6 +126,11 @@ SceneManager::ProcessedInstances SceneManager::processInstances(const tinygltf::
   for (std::size_t i = 0; i < model.nodes.size(); ++i)
     if (model.nodes[i].mesh >= 0)
     {
+      const auto& extras = model.nodes[i].extras;
+      if (extras.Has("dynamic") && extras.Get("dynamic").IsBool() &&
+          extras.Get("dynamic").Get<bool>())
+        result.dynamic.push_back(static_cast<std::uint32_t>(result.matrices.size()));
+
       result.matrices.push_back(nodeTransforms[i]);
       result.meshes.push_back(model.nodes[i].mesh);
     }
@@ -191,6 +196,7 @@ SceneManager::ProcessedMeshes SceneManager::processMeshes(const tinygltf::Model&
     result.meshes.push_back(Mesh{
       .firstRelem = static_cast<std::uint32_t>(result.relems.size()),
       .relemCount = static_cast<std::uint32_t>(mesh.primitives.size()),
+      .bounds = {},
     });
 
     for (const auto& prim : mesh.primitives)
@@ -299,6 +305,8 @@ SceneManager::ProcessedMeshes SceneManager::processMeshes(const tinygltf::Model&
         glm::vec2 texcoord{0};
         std::memcpy(&pos, ptrs[1], sizeof(pos));
 
+        result.meshes.back().bounds.extend(pos);
+
         // NOTE: it's faster to do a template here with specializations for all combinations than to
         // do ifs at runtime. Also, SIMD should be used. Try implementing this!
         if (hasNormals)
@@ -351,7 +359,9 @@ SceneManager::ProcessedMeshes SceneManager::processMeshes(const tinygltf::Model&
 }
 
 void SceneManager::uploadData(
-  std::span<const Vertex> vertices, std::span<const std::uint32_t> indices)
+  std::span<const Vertex> vertices,
+  std::span<const std::uint32_t> indices,
+  std::span<const glm::mat4x4> instance_matrices)
 {
   unifiedVbuf = etna::get_context().createBuffer(etna::Buffer::CreateInfo{
     .size = vertices.size_bytes(),
@@ -367,8 +377,38 @@ void SceneManager::uploadData(
     .name = "unifiedIbuf",
   });
 
+  std::vector<glm::vec3> positions;
+  positions.reserve(vertices.size());
+  for (const auto& vertex : vertices)
+    positions.emplace_back(vertex.positionAndNormal);
+
+  positionVbuf = etna::get_context().createBuffer(etna::Buffer::CreateInfo{
+    .size = std::span{positions}.size_bytes(),
+    .bufferUsage = vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eVertexBuffer,
+    .memoryUsage = VMA_MEMORY_USAGE_GPU_ONLY,
+    .name = "positionVbuf",
+  });
+
   transferHelper.uploadBuffer<Vertex>(*oneShotCommands, unifiedVbuf, 0, vertices);
+  transferHelper.uploadBuffer<glm::vec3>(*oneShotCommands, positionVbuf, 0, positions);
   transferHelper.uploadBuffer<std::uint32_t>(*oneShotCommands, unifiedIbuf, 0, indices);
+
+  std::vector<InstanceData> instances;
+  instances.reserve(instance_matrices.size());
+  for (const auto& model : instance_matrices)
+    instances.push_back(InstanceData{
+      .model = model,
+      .normalMatrix = glm::mat4x4(glm::transpose(glm::inverse(glm::mat3x3(model)))),
+    });
+
+  instanceBuf = etna::get_context().createBuffer(etna::Buffer::CreateInfo{
+    .size = std::span{instances}.size_bytes(),
+    .bufferUsage = vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eStorageBuffer,
+    .memoryUsage = VMA_MEMORY_USAGE_GPU_ONLY,
+    .name = "instanceBuf",
+  });
+
+  transferHelper.uploadBuffer<InstanceData>(*oneShotCommands, instanceBuf, 0, instances);
 }
 
 void SceneManager::selectScene(std::filesystem::path path)
@@ -384,16 +424,17 @@ void SceneManager::selectScene(std::filesystem::path path)
   // when re-loading a scene.
 
   // NOTE: you might want to store these on the GPU for GPU-driven rendering.
-  auto [instMats, instMeshes] = processInstances(model);
+  auto [instMats, instMeshes, instDynamic] = processInstances(model);
   instanceMatrices = std::move(instMats);
   instanceMeshes = std::move(instMeshes);
+  dynamicInstances = std::move(instDynamic);
 
   auto [verts, inds, relems, meshs] = processMeshes(model);
 
   renderElements = std::move(relems);
   meshes = std::move(meshs);
 
-  uploadData(verts, inds);
+  uploadData(verts, inds, instanceMatrices);
 }
 
 etna::VertexByteStreamFormatDescription SceneManager::getVertexFormatDescription()
@@ -411,3 +452,15 @@ etna::VertexByteStreamFormatDescription SceneManager::getVertexFormatDescription
       },
     }};
 }
+
+etna::VertexByteStreamFormatDescription SceneManager::getPositionFormatDescription()
+{
+  return etna::VertexByteStreamFormatDescription{
+    .stride = sizeof(glm::vec3),
+    .attributes = {
+      etna::VertexByteStreamFormatDescription::Attribute{
+        .format = vk::Format::eR32G32B32Sfloat,
+        .offset = 0,
+      },
+    }};
+}
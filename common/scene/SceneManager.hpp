@@ -8,6 +8,8 @@
 #include <etna/BlockingTransferHelper.hpp>
 #include <etna/VertexInput.hpp>
 
+#include "scene/BoundingBox.hpp"
+
 
 // A single render element (relem) corresponds to a single draw call
 // of a certain pipeline with specific bindings (including material data)
@@ -27,6 +29,17 @@ struct Mesh
 {
   std::uint32_t firstRelem;
   std::uint32_t relemCount;
+  // In mesh space, for culling
+  BoundingBox bounds;
+};
+
+// Per-instance data as laid out in the instance buffer, see scene_instances.glsl
+struct InstanceData
+{
+  glm::mat4x4 model;
+  // Inverse transpose of the model matrix, only the upper 3x3 part is meaningful.
+  // Precomputed so that shaders never have to invert matrices per vertex.
+  glm::mat4x4 normalMatrix;
 };
 
 class SceneManager
@@ -41,6 +54,10 @@ public:
   std::span<const glm::mat4x4> getInstanceMatrices() { return instanceMatrices; }
   std::span<const std::uint32_t> getInstanceMeshes() { return instanceMeshes; }
 
+  // Indices of instances whose nodes are marked with `"extras": {"dynamic": true}`,
+  // i.e. instances that renderers must not assume to stay in place
+  std::span<const std::uint32_t> getDynamicInstances() { return dynamicInstances; }
+
   // Every mesh is a collection of relems
   std::span<const Mesh> getMeshes() { return meshes; }
 
@@ -48,9 +65,16 @@ public:
   std::span<const RenderElement> getRenderElements() { return renderElements; }
 
   vk::Buffer getVertexBuffer() { return unifiedVbuf.get(); }
+  // Positions only, tightly packed, with the same indices and offsets as the full vertices.
+  // Cheaper to fetch for passes that only need depth.
+  vk::Buffer getPositionBuffer() { return positionVbuf.get(); }
   vk::Buffer getIndexBuffer() { return unifiedIbuf.get(); }
 
+  // Storage buffer with an InstanceData for every instance
+  const etna::Buffer& getInstanceBuffer() { return instanceBuf; }
+
   etna::VertexByteStreamFormatDescription getVertexFormatDescription();
+  etna::VertexByteStreamFormatDescription getPositionFormatDescription();
 
 private:
   std::optional<tinygltf::Model> loadModel(std::filesystem::path path);
@@ -59,6 +83,7 @@ private:
   {
     std::vector<glm::mat4x4> matrices;
     std::vector<std::uint32_t> meshes;
+    std::vector<std::uint32_t> dynamic;
   };
 
   ProcessedInstances processInstances(const tinygltf::Model& model) const;
@@ -81,7 +106,10 @@ private:
     std::vector<Mesh> meshes;
   };
   ProcessedMeshes processMeshes(const tinygltf::Model& model) const;
-  void uploadData(std::span<const Vertex> vertices, std::span<const std::uint32_t>);
+  void uploadData(
+    std::span<const Vertex> vertices,
+    std::span<const std::uint32_t> indices,
+    std::span<const glm::mat4x4> instance_matrices);
 
 private:
   tinygltf::TinyGLTF loader;
@@ -92,7 +120,10 @@ private:
   std::vector<Mesh> meshes;
   std::vector<glm::mat4x4> instanceMatrices;
   std::vector<std::uint32_t> instanceMeshes;
+  std::vector<std::uint32_t> dynamicInstances;
 
   etna::Buffer unifiedVbuf;
+  etna::Buffer positionVbuf;
   etna::Buffer unifiedIbuf;
+  etna::Buffer instanceBuf;
 };
@@ -0,0 +1,424 @@
+#include "Heightmap.hpp"
+
+#include <bit>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+
+#include <etna/Assert.hpp>
+#include <etna/Buffer.hpp>
+#include <etna/DescriptorSet.hpp>
+#include <etna/Etna.hpp>
+#include <etna/GlobalContext.hpp>
+#include <etna/OneShotCmdMgr.hpp>
+#include <etna/PipelineManager.hpp>
+#include <fmt/format.h>
+#include <fmt/std.h>
+#include <spdlog/spdlog.h>
+#include <tracy/Tracy.hpp>
+
+#include "HeightmapParams.h"
+
+
+namespace
+{
+
+constexpr vk::Format HEIGHTMAP_FORMAT = vk::Format::eR32Sfloat;
+
+constexpr std::uint32_t CACHE_FILE_MAGIC = 0x50414d48; // "HMAP"
+// Bump whenever the generator changes, so that stale caches are regenerated
+constexpr std::uint32_t CACHE_FILE_VERSION = 1;
+
+struct CacheHeader
+{
+  std::uint32_t magic;
+  std::uint32_t version;
+  Heightmap::GenerationParams params;
+  std::uint32_t mipCount;
+  std::uint32_t padding = 0;
+  std::uint64_t dataSize;
+
+  bool operator==(const CacheHeader&) const = default;
+};
+
+// FNV-1a over the parameters, collisions are caught by comparing the header on load
+std::uint64_t hash_params(const Heightmap::GenerationParams& params)
+{
+  const std::uint32_t fields[] = {
+    params.size,
+    params.octaves,
+    std::bit_cast<std::uint32_t>(params.baseFrequency),
+    std::bit_cast<std::uint32_t>(params.persistence),
+    std::bit_cast<std::uint32_t>(params.lacunarity),
+    params.seed,
+  };
+
+  std::uint64_t hash = 0xcbf29ce484222325;
+  for (auto field : fields)
+    for (int i = 0; i < 4; ++i)
+    {
+      hash ^= (field >> (8 * i)) & 0xff;
+      hash *= 0x100000001b3;
+    }
+  return hash;
+}
+
+std::uint32_t group_count(std::uint32_t size)
+{
+  return (size + HEIGHTMAP_GROUP_SIZE - 1) / HEIGHTMAP_GROUP_SIZE;
+}
+
+// One region per mip, packed tightly one after another
+std::vector<vk::BufferImageCopy> mip_regions(std::uint32_t size, std::uint32_t mip_count)
+{
+  std::vector<vk::BufferImageCopy> regions;
+  vk::DeviceSize offset = 0;
+  for (std::uint32_t mip = 0; mip < mip_count; ++mip)
+  {
+    const std::uint32_t mipSize = size >> mip;
+    regions.push_back(vk::BufferImageCopy{
+      .bufferOffset = offset,
+      .bufferRowLength = 0,
+      .bufferImageHeight = 0,
+      .imageSubresource =
+        {
+          .aspectMask = vk::ImageAspectFlagBits::eColor,
+          .mipLevel = mip,
+          .baseArrayLayer = 0,
+          .layerCount = 1,
+        },
+      .imageOffset = {0, 0, 0},
+      .imageExtent = {mipSize, mipSize, 1},
+    });
+    offset += vk::DeviceSize{mipSize} * mipSize * sizeof(float);
+  }
+  return regions;
+}
+
+double ms_since(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start)
+    .count();
+}
+
+} // namespace
+
+Heightmap::Heightmap(const CreateInfo& info)
+  : params{info.params}
+  , mipCount{static_cast<std::uint32_t>(std::countr_zero(info.params.size)) + 1}
+{
+  ZoneScoped;
+
+  ETNA_VERIFYF(
+    std::has_single_bit(params.size),
+    "Heightmap size {} is not a power of two!",
+    params.size);
+
+  image = etna::get_context().createImage(etna::Image::CreateInfo{
+    .extent = vk::Extent3D{params.size, params.size, 1},
+    .name = "heightmap",
+    .format = HEIGHTMAP_FORMAT,
+    .imageUsage = vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eSampled |
+      vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst,
+    .mipLevels = mipCount,
+  });
+
+  const auto start = std::chrono::steady_clock::now();
+
+  if (!info.cacheDir.empty())
+  {
+    const auto path = cachePath(info.cacheDir);
+    if (loadCache(path))
+    {
+      fromCache = true;
+      spdlog::info(
+        "Loaded {0}x{0} heightmap from '{1}' in {2:.1f} ms", params.size, path, ms_since(start));
+      return;
+    }
+  }
+
+  const auto data = generate();
+  spdlog::info("Generated {0}x{0} heightmap in {1:.1f} ms", params.size, ms_since(start));
+
+  if (!info.cacheDir.empty())
+    saveCache(cachePath(info.cacheDir), data);
+}
+
+std::filesystem::path Heightmap::cachePath(const std::filesystem::path& cache_dir) const
+{
+  return cache_dir / fmt::format("heightmap_{:016x}.bin", hash_params(params));
+}
+
+vk::DeviceSize Heightmap::totalBytes() const
+{
+  vk::DeviceSize result = 0;
+  for (std::uint32_t mip = 0; mip < mipCount; ++mip)
+    result += vk::DeviceSize{mipSize(mip)} * mipSize(mip) * sizeof(float);
+  return result;
+}
+
+bool Heightmap::loadCache(const std::filesystem::path& path)
+{
+  ZoneScoped;
+
+  std::ifstream file(path, std::ios::binary);
+  if (!file)
+    return false;
+
+  const CacheHeader expected{
+    .magic = CACHE_FILE_MAGIC,
+    .version = CACHE_FILE_VERSION,
+    .params = params,
+    .mipCount = mipCount,
+    .dataSize = totalBytes(),
+  };
+  CacheHeader header{};
+  file.read(reinterpret_cast<char*>(&header), sizeof(header));
+  if (!file || header != expected)
+  {
+    spdlog::info("Heightmap cache '{}' is stale, regenerating it", path);
+    return false;
+  }
+
+  auto& ctx = etna::get_context();
+
+  // The finest mip goes into the CPU copy, the rest is streamed straight into memory
+  // the GPU copies from
+  auto staging = ctx.createBuffer(etna::Buffer::CreateInfo{
+    .size = header.dataSize,
+    .bufferUsage = vk::BufferUsageFlagBits::eTransferSrc,
+    .memoryUsage = VMA_MEMORY_USAGE_CPU_TO_GPU,
+    .name = "heightmap_staging",
+  });
+  heights.resize(std::size_t{params.size} * params.size);
+  const auto finestBytes = static_cast<std::streamsize>(heights.size() * sizeof(float));
+  file.read(reinterpret_cast<char*>(heights.data()), finestBytes);
+  auto* mapped = reinterpret_cast<char*>(staging.map());
+  std::memcpy(mapped, heights.data(), heights.size() * sizeof(float));
+  file.read(mapped + finestBytes, static_cast<std::streamsize>(header.dataSize) - finestBytes);
+  staging.unmap();
+  if (!file)
+  {
+    heights.clear();
+    spdlog::warn("Heightmap cache '{}' is truncated, regenerating it", path);
+    return false;
+  }
+
+  auto cmdMgr = ctx.createOneShotCmdMgr();
+  auto cmdBuf = cmdMgr->start();
+  ETNA_CHECK_VK_RESULT(cmdBuf.begin(vk::CommandBufferBeginInfo{
+    .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit,
+  }));
+
+  etna::set_state(
+    cmdBuf,
+    image.get(),
+    vk::PipelineStageFlagBits2::eTransfer,
+    vk::AccessFlagBits2::eTransferWrite,
+    vk::ImageLayout::eTransferDstOptimal,
+    vk::ImageAspectFlagBits::eColor);
+  etna::flush_barriers(cmdBuf);
+
+  cmdBuf.copyBufferToImage(
+    staging.get(),
+    image.get(),
+    vk::ImageLayout::eTransferDstOptimal,
+    mip_regions(params.size, mipCount));
+
+  ETNA_CHECK_VK_RESULT(cmdBuf.end());
+  cmdMgr->submitAndWait(std::move(cmdBuf));
+
+  return true;
+}
+
+std::vector<std::byte> Heightmap::generate()
+{
+  ZoneScoped;
+
+  auto& ctx = etna::get_context();
+
+  if (etna::get_program_id("heightmap_generate") == etna::ShaderProgramId::Invalid)
+  {
+    etna::create_program(
+      "heightmap_generate", {TERRAIN_SHADERS_ROOT "heightmap_generate.comp.spv"});
+    etna::create_program(
+      "heightmap_downsample", {TERRAIN_SHADERS_ROOT "heightmap_downsample.comp.spv"});
+  }
+
+  auto& pipelineManager = ctx.getPipelineManager();
+  auto generatePipeline = pipelineManager.createComputePipeline("heightmap_generate", {});
+  auto downsamplePipeline = pipelineManager.createComputePipeline("heightmap_downsample", {});
+
+  // Host coherent, as etna::Buffer doesn't expose its allocation for invalidation
+  // and VMA only guarantees coherence for CPU_ONLY. A stale read would end up in the cache.
+  auto readback = ctx.createBuffer(etna::Buffer::CreateInfo{
+    .size = totalBytes(),
+    .bufferUsage = vk::BufferUsageFlagBits::eTransferDst,
+    .memoryUsage = VMA_MEMORY_USAGE_CPU_ONLY,
+    .name = "heightmap_readback",
+  });
+
+  auto cmdMgr = ctx.createOneShotCmdMgr();
+  auto cmdBuf = cmdMgr->start();
+  ETNA_CHECK_VK_RESULT(cmdBuf.begin(vk::CommandBufferBeginInfo{
+    .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit,
+  }));
+
+  // All mips stay in the general layout, dependencies between them are issued by hand
+  etna::set_state(
+    cmdBuf,
+    image.get(),
+    vk::PipelineStageFlagBits2::eComputeShader,
+    vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite,
+    vk::ImageLayout::eGeneral,
+    vk::ImageAspectFlagBits::eColor);
+  etna::flush_barriers(cmdBuf);
+
+  // Sets have to live until the commands are done
+  std::vector<etna::DescriptorSet> sets;
+
+  {
+    sets.push_back(etna::create_descriptor_set(
+      etna::get_shader_program("heightmap_generate").getDescriptorLayoutId(0),
+      cmdBuf,
+      {etna::Binding{
+        0, image.genBinding({}, vk::ImageLayout::eGeneral, {.baseMip = 0, .levelCount = 1})}},
+      etna::BarrierBehavoir::eSuppressBarriers));
+
+    const HeightmapGenerateParams constants{
+      .size = params.size,
+      .octaves = params.octaves,
+      .baseFrequency = params.baseFrequency,
+      .persistence = params.persistence,
+      .lacunarity = params.lacunarity,
+      .seed = params.seed,
+    };
+    const auto vkSet = sets.back().getVkSet();
+    cmdBuf.bindPipeline(vk::PipelineBindPoint::eCompute, generatePipeline.getVkPipeline());
+    cmdBuf.bindDescriptorSets(
+      vk::PipelineBindPoint::eCompute, generatePipeline.getVkPipelineLayout(), 0, {vkSet}, {});
+    cmdBuf.pushConstants(
+      generatePipeline.getVkPipelineLayout(),
+      vk::ShaderStageFlagBits::eCompute,
+      0,
+      sizeof(constants),
+      &constants);
+    cmdBuf.dispatch(group_count(params.size), group_count(params.size), 1);
+  }
+
+  const vk::MemoryBarrier2 writeToRead{
+    .srcStageMask = vk::PipelineStageFlagBits2::eComputeShader,
+    .srcAccessMask = vk::AccessFlagBits2::eShaderStorageWrite,
+    .dstStageMask = vk::PipelineStageFlagBits2::eComputeShader,
+    .dstAccessMask = vk::AccessFlagBits2::eShaderStorageRead,
+  };
+
+  cmdBuf.bindPipeline(vk::PipelineBindPoint::eCompute, downsamplePipeline.getVkPipeline());
+  for (std::uint32_t mip = 1; mip < mipCount; ++mip)
+  {
+    cmdBuf.pipelineBarrier2(vk::DependencyInfo{
+      .memoryBarrierCount = 1,
+      .pMemoryBarriers = &writeToRead,
+    });
+
+    sets.push_back(etna::create_descriptor_set(
+      etna::get_shader_program("heightmap_downsample").getDescriptorLayoutId(0),
+      cmdBuf,
+      {etna::Binding{
+         0,
+         image.genBinding({}, vk::ImageLayout::eGeneral, {.baseMip = mip - 1, .levelCount = 1})},
+       etna::Binding{
+         1, image.genBinding({}, vk::ImageLayout::eGeneral, {.baseMip = mip, .levelCount = 1})}},
+      etna::BarrierBehavoir::eSuppressBarriers));
+
+    const HeightmapDownsampleParams constants{
+      .dstSize = glm::uvec2{mipSize(mip)},
+    };
+    const auto vkSet = sets.back().getVkSet();
+    cmdBuf.bindDescriptorSets(
+      vk::PipelineBindPoint::eCompute, downsamplePipeline.getVkPipelineLayout(), 0, {vkSet}, {});
+    cmdBuf.pushConstants(
+      downsamplePipeline.getVkPipelineLayout(),
+      vk::ShaderStageFlagBits::eCompute,
+      0,
+      sizeof(constants),
+      &constants);
+    cmdBuf.dispatch(group_count(mipSize(mip)), group_count(mipSize(mip)), 1);
+  }
+
+  // Read back for the CPU copy and the disk cache
+  etna::set_state(
+    cmdBuf,
+    image.get(),
+    vk::PipelineStageFlagBits2::eTransfer,
+    vk::AccessFlagBits2::eTransferRead,
+    vk::ImageLayout::eTransferSrcOptimal,
+    vk::ImageAspectFlagBits::eColor);
+  etna::flush_barriers(cmdBuf);
+
+  cmdBuf.copyImageToBuffer(
+    image.get(),
+    vk::ImageLayout::eTransferSrcOptimal,
+    readback.get(),
+    mip_regions(params.size, mipCount));
+
+  const vk::MemoryBarrier2 toHost{
+    .srcStageMask = vk::PipelineStageFlagBits2::eTransfer,
+    .srcAccessMask = vk::AccessFlagBits2::eTransferWrite,
+    .dstStageMask = vk::PipelineStageFlagBits2::eHost,
+    .dstAccessMask = vk::AccessFlagBits2::eHostRead,
+  };
+  cmdBuf.pipelineBarrier2(vk::DependencyInfo{
+    .memoryBarrierCount = 1,
+    .pMemoryBarriers = &toHost,
+  });
+
+  ETNA_CHECK_VK_RESULT(cmdBuf.end());
+  cmdMgr->submitAndWait(std::move(cmdBuf));
+
+  std::vector<std::byte> data(totalBytes());
+  std::memcpy(data.data(), readback.map(), data.size());
+  readback.unmap();
+
+  heights.resize(std::size_t{params.size} * params.size);
+  std::memcpy(heights.data(), data.data(), heights.size() * sizeof(float));
+  return data;
+}
+
+void Heightmap::saveCache(const std::filesystem::path& path, const std::vector<std::byte>& data)
+  const
+{
+  ZoneScoped;
+
+  const CacheHeader header{
+    .magic = CACHE_FILE_MAGIC,
+    .version = CACHE_FILE_VERSION,
+    .params = params,
+    .mipCount = mipCount,
+    .dataSize = data.size(),
+  };
+
+  std::error_code ec;
+  std::filesystem::create_directories(path.parent_path(), ec);
+
+  // Write to a temporary file first so that a crash never leaves a corrupted cache behind
+  auto tmpPath = path;
+  tmpPath += ".tmp";
+  {
+    std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(
+      reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+    if (!file)
+    {
+      spdlog::warn("Failed to write heightmap cache to '{}'", tmpPath);
+      return;
+    }
+  }
+
+  std::filesystem::rename(tmpPath, path, ec);
+  if (ec)
+    spdlog::warn("Failed to save heightmap cache to '{}': {}", path, ec.message());
+  else
+    spdlog::info("Saved {} MiB of heightmap cache to '{}'", data.size() / (1024 * 1024), path);
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <vector>
+
+#include <etna/Image.hpp>
+
+
+/**
+ * Single channel R32_SFLOAT height field in [0, 1] with a full mip chain.
+ * The map is multi-octave Perlin noise generated by a compute shader, and every mip is
+ * built on the GPU by averaging 2x2 texels of the previous one.
+ *
+ * Generated maps are cached on disk, keyed by the generation parameters. Later runs with
+ * the same parameters upload the cached file, mips included, and dispatch nothing.
+ * The finest mip is kept on the CPU as well, e.g. for culling against terrain bounds.
+ * Height to world space scale is up to the renderer.
+ */
+class Heightmap
+{
+public:
+  struct GenerationParams
+  {
+    // Has to be a power of two
+    std::uint32_t size = 4096;
+    std::uint32_t octaves = 10;
+    // Lattice cells of the first octave across the whole map
+    float baseFrequency = 4.0f;
+    // Amplitude and frequency multipliers between consecutive octaves
+    float persistence = 0.5f;
+    float lacunarity = 2.0f;
+    std::uint32_t seed = 0;
+
+    bool operator==(const GenerationParams&) const = default;
+  };
+
+  struct CreateInfo
+  {
+    GenerationParams params;
+    // Directory for cached maps, caching is disabled when empty
+    std::filesystem::path cacheDir;
+  };
+
+  explicit Heightmap(const CreateInfo& info);
+
+  Heightmap(const Heightmap&) = delete;
+  Heightmap& operator=(const Heightmap&) = delete;
+
+  const etna::Image& getImage() const { return image; }
+  const GenerationParams& getParams() const { return params; }
+  std::uint32_t getMipCount() const { return mipCount; }
+  // Finest mip, row by row
+  std::span<const float> getHeights() const { return heights; }
+
+  // Whether the map came from the disk cache instead of being generated
+  bool isFromCache() const { return fromCache; }
+
+private:
+  std::filesystem::path cachePath(const std::filesystem::path& cache_dir) const;
+  bool loadCache(const std::filesystem::path& path);
+  // Returns the contents of all mips, packed tightly one after another
+  std::vector<std::byte> generate();
+  void saveCache(const std::filesystem::path& path, const std::vector<std::byte>& data) const;
+
+  std::uint32_t mipSize(std::uint32_t mip) const { return params.size >> mip; }
+  // Of all mips together
+  vk::DeviceSize totalBytes() const;
+
+private:
+  GenerationParams params;
+  std::uint32_t mipCount;
+  etna::Image image;
+  std::vector<float> heights;
+  bool fromCache = false;
+};
@@ -0,0 +1,146 @@
+#include "TerrainQuadtree.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <limits>
+
+#include <etna/Assert.hpp>
+#include <tracy/Tracy.hpp>
+
+
+namespace
+{
+
+constexpr std::array<glm::uvec2, 4> QUADRANTS{
+  glm::uvec2{0, 0}, glm::uvec2{1, 0}, glm::uvec2{0, 1}, glm::uvec2{1, 1}};
+
+bool intersects_sphere(const BoundingBox& box, const glm::vec3& center, float radius)
+{
+  const glm::vec3 toBox = glm::clamp(center, box.min, box.max) - center;
+  return glm::dot(toBox, toBox) <= radius * radius;
+}
+
+} // namespace
+
+TerrainQuadtree::TerrainQuadtree(const CreateInfo& info)
+  : size{info.size}
+  , leafSize{info.leafSize}
+  , worldSize{info.worldSize}
+  , heightScale{info.heightScale}
+{
+  ZoneScoped;
+
+  ETNA_VERIFYF(
+    std::has_single_bit(size) && std::has_single_bit(leafSize) && leafSize >= 2 &&
+      leafSize <= size,
+    "Bad terrain quadtree sizes {} and {}, both must be powers of two!",
+    size,
+    leafSize);
+  ETNA_VERIFYF(
+    info.heights.size() == std::size_t{size} * size,
+    "Heightmap of {0} texels is not {1}x{1}!",
+    info.heights.size(),
+    size);
+
+  minMax.resize(std::countr_zero(size) - std::countr_zero(leafSize) + 1);
+
+  // Linear filtering at the edges of a node mixes in texels of the neighbours,
+  // so every leaf covers one more texel on each side
+  const std::uint32_t leaves = nodesPerSide(0);
+  minMax[0].resize(std::size_t{leaves} * leaves);
+  for (std::uint32_t y = 0; y < leaves; ++y)
+    for (std::uint32_t x = 0; x < leaves; ++x)
+    {
+      const glm::uvec2 first = glm::max(glm::uvec2{x, y} * leafSize, glm::uvec2{1}) - 1u;
+      const glm::uvec2 last = glm::min(glm::uvec2{x + 1, y + 1} * leafSize, glm::uvec2{size - 1});
+
+      glm::vec2 range{std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest()};
+      for (std::uint32_t ty = first.y; ty <= last.y; ++ty)
+        for (std::uint32_t tx = first.x; tx <= last.x; ++tx)
+        {
+          const float height = info.heights[std::size_t{ty} * size + tx];
+          range = {std::min(range.x, height), std::max(range.y, height)};
+        }
+      minMax[0][std::size_t{y} * leaves + x] = range;
+    }
+
+  for (std::uint32_t lod = 1; lod < minMax.size(); ++lod)
+  {
+    const std::uint32_t nodes = nodesPerSide(lod);
+    const std::uint32_t children = nodesPerSide(lod - 1);
+    minMax[lod].resize(std::size_t{nodes} * nodes);
+    for (std::uint32_t y = 0; y < nodes; ++y)
+      for (std::uint32_t x = 0; x < nodes; ++x)
+      {
+        glm::vec2 range{std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest()};
+        for (const auto& quadrant : QUADRANTS)
+        {
+          const glm::uvec2 child = glm::uvec2{x, y} * 2u + quadrant;
+          const auto& childRange = minMax[lod - 1][std::size_t{child.y} * children + child.x];
+          range = {std::min(range.x, childRange.x), std::max(range.y, childRange.y)};
+        }
+        minMax[lod][std::size_t{y} * nodes + x] = range;
+      }
+  }
+}
+
+float TerrainQuadtree::getLodRange(float lod_range, std::uint32_t lod) const
+{
+  if (lod + 1 >= getLodCount())
+    return std::numeric_limits<float>::infinity();
+  return lod_range * static_cast<float>(1u << lod);
+}
+
+BoundingBox TerrainQuadtree::nodeBounds(glm::uvec2 coords, std::uint32_t lod) const
+{
+  const auto& range = minMax[lod][std::size_t{coords.y} * nodesPerSide(lod) + coords.x];
+  const float texelSize = worldSize / static_cast<float>(size);
+  const glm::vec2 min = glm::vec2(coords * getNodeSize(lod)) * texelSize - 0.5f * worldSize;
+  const glm::vec2 max = min + static_cast<float>(getNodeSize(lod)) * texelSize;
+  return BoundingBox{
+    .min = {min.x, range.x * heightScale, min.y},
+    .max = {max.x, range.y * heightScale, max.y},
+  };
+}
+
+void TerrainQuadtree::select(const SelectInfo& info, std::vector<Block>& out) const
+{
+  ZoneScoped;
+
+  out.clear();
+  // The coarsest LOD is never out of range, so the root covers everything by itself
+  selectNode(info, {0, 0}, getLodCount() - 1, out);
+  std::ranges::stable_sort(out, {}, &Block::lod);
+}
+
+bool TerrainQuadtree::selectNode(
+  const SelectInfo& info, glm::uvec2 coords, std::uint32_t lod, std::vector<Block>& out) const
+{
+  const auto bounds = nodeBounds(coords, lod);
+  if (!intersects_sphere(bounds, info.cameraPos, getLodRange(info.lodRange, lod)))
+    return false;
+
+  // Nothing to draw, but the area is covered as far as the parent is concerned
+  if (!is_box_visible(bounds, info.viewProj))
+    return true;
+
+  const bool wholeNode =
+    lod == 0 || !intersects_sphere(bounds, info.cameraPos, getLodRange(info.lodRange, lod - 1));
+  for (const auto& quadrant : QUADRANTS)
+  {
+    const glm::uvec2 quarter = coords * 2u + quadrant;
+    if (wholeNode || !selectNode(info, quarter, lod - 1, out))
+      selectQuarter(info, quarter, lod, out);
+  }
+  return true;
+}
+
+void TerrainQuadtree::selectQuarter(
+  const SelectInfo& info, glm::uvec2 coords, std::uint32_t lod, std::vector<Block>& out) const
+{
+  // Quarters of a node are its children, except for the finest LOD which has none
+  const auto bounds = lod > 0 ? nodeBounds(coords, lod - 1) : nodeBounds(coords / 2u, lod);
+  if (is_box_visible(bounds, info.viewProj))
+    out.push_back(Block{.offset = coords * getBlockSize(lod), .lod = lod});
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "scene/BoundingBox.hpp"
+
+
+/**
+ * Quadtree over a heightmap for continuous distance-dependent LOD (CDLOD).
+ * Every node stores the height range of the texels it covers, so nodes have tight
+ * bounding boxes that are used both for frustum culling and for LOD range checks.
+ *
+ * The finest nodes are LOD 0, every level up has nodes twice as large and covers twice
+ * the distance. A node is drawn at its own LOD wherever it is too far for the finer
+ * LOD, parts of it that are close enough are handed down to its children. Selected areas
+ * come in quarters of nodes, so that every area of a LOD has the same amount of vertices.
+ *
+ * The terrain is centered at the origin in XZ, heights go up along Y.
+ */
+class TerrainQuadtree
+{
+public:
+  struct CreateInfo
+  {
+    // Finest mip of the heightmap, row by row, with values in [0, 1]
+    std::span<const float> heights;
+    // Has to be a power of two
+    std::uint32_t size = 0;
+    // Texels along the side of a LOD 0 node, a power of two of at least 2
+    std::uint32_t leafSize = 64;
+    // Side of the whole terrain
+    float worldSize = 4096.0f;
+    // Height of a heightmap value of 1
+    float heightScale = 512.0f;
+  };
+
+  // A quarter of a node, see the class description
+  struct Block
+  {
+    // In heightmap texels
+    glm::uvec2 offset;
+    std::uint32_t lod;
+  };
+
+  struct SelectInfo
+  {
+    glm::vec3 cameraPos;
+    glm::mat4x4 viewProj;
+    // Distance up to which LOD 0 is used, every next LOD covers twice the distance
+    float lodRange;
+  };
+
+  explicit TerrainQuadtree(const CreateInfo& info);
+
+  // Blocks that are in range and intersect the clip volume of the view, finest LOD first
+  void select(const SelectInfo& info, std::vector<Block>& out) const;
+
+  // Distance up to which a LOD is used, infinite for the coarsest LOD
+  float getLodRange(float lod_range, std::uint32_t lod) const;
+
+  std::uint32_t getLodCount() const { return static_cast<std::uint32_t>(minMax.size()); }
+  // In texels
+  std::uint32_t getNodeSize(std::uint32_t lod) const { return leafSize << lod; }
+  std::uint32_t getBlockSize(std::uint32_t lod) const { return getNodeSize(lod) / 2; }
+  std::uint32_t getSize() const { return size; }
+  float getWorldSize() const { return worldSize; }
+  float getHeightScale() const { return heightScale; }
+
+private:
+  // Returns false if the node is out of range of its LOD, i.e. the parent has to cover it
+  bool selectNode(
+    const SelectInfo& info, glm::uvec2 coords, std::uint32_t lod, std::vector<Block>& out) const;
+  // Adds the quarter of a node at the LOD of the node, unless it's out of view
+  void selectQuarter(
+    const SelectInfo& info, glm::uvec2 coords, std::uint32_t lod, std::vector<Block>& out) const;
+
+  // Coordinates are in nodes of the LOD
+  BoundingBox nodeBounds(glm::uvec2 coords, std::uint32_t lod) const;
+  std::uint32_t nodesPerSide(std::uint32_t lod) const { return size / getNodeSize(lod); }
+
+private:
+  std::uint32_t size;
+  std::uint32_t leafSize;
+  float worldSize;
+  float heightScale;
+  // Height range of every node, row by row, for every LOD starting from the finest one
+  std::vector<std::vector<glm::vec2>> minMax;
+};
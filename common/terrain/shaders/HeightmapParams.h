@@ -0,0 +1,26 @@
+#ifndef HEIGHTMAP_PARAMS_H_INCLUDED
+#define HEIGHTMAP_PARAMS_H_INCLUDED
+
+#include "cpp_glsl_compat.h"
+
+#define HEIGHTMAP_GROUP_SIZE 16
+
+// Push constants of heightmap_generate.comp
+struct HeightmapGenerateParams
+{
+  shader_uint size;
+  shader_uint octaves;
+  // Lattice cells of the first octave across the whole map
+  shader_float baseFrequency;
+  shader_float persistence;
+  shader_float lacunarity;
+  shader_uint seed;
+};
+
+// Push constants of heightmap_downsample.comp
+struct HeightmapDownsampleParams
+{
+  shader_uvec2 dstSize;
+};
+
+#endif // HEIGHTMAP_PARAMS_H_INCLUDED
@@ -0,0 +1,142 @@
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <string>
+
+#include <tracy/Tracy.hpp>
+
+
+static thread_local std::size_t current_pool_thread_index = 0;
+
+std::size_t ThreadPool::default_worker_count()
+{
+  const std::size_t hw = std::thread::hardware_concurrency();
+  return hw > 1 ? hw - 1 : 1;
+}
+
+std::size_t ThreadPool::current_thread_index()
+{
+  return current_pool_thread_index;
+}
+
+ThreadPool::ThreadPool(std::size_t worker_count)
+{
+  workers.reserve(worker_count);
+  for (std::size_t i = 0; i < worker_count; ++i)
+    workers.emplace_back([this, i]() { workerLoop(i + 1); });
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::unique_lock lock{queueMutex};
+    stopping = true;
+  }
+  queueCv.notify_all();
+  // jthread joins on destruction
+  workers.clear();
+}
+
+std::future<void> ThreadPool::submit(Task task)
+{
+  std::packaged_task<void()> packaged{std::move(task)};
+  auto result = packaged.get_future();
+
+  {
+    std::unique_lock lock{queueMutex};
+    queue.emplace_back(std::move(packaged));
+  }
+  queueCv.notify_one();
+
+  return result;
+}
+
+bool ThreadPool::tryRunOneTask()
+{
+  Task task;
+  {
+    std::unique_lock lock{queueMutex};
+    if (queue.empty())
+      return false;
+    task = std::move(queue.front());
+    queue.pop_front();
+  }
+  task();
+  return true;
+}
+
+void ThreadPool::workerLoop(std::size_t thread_index)
+{
+  current_pool_thread_index = thread_index;
+
+  {
+    const std::string name = "worker " + std::to_string(thread_index);
+    tracy::SetThreadName(name.c_str());
+  }
+
+  while (true)
+  {
+    Task task;
+    {
+      std::unique_lock lock{queueMutex};
+      queueCv.wait(lock, [this]() { return stopping || !queue.empty(); });
+      if (stopping && queue.empty())
+        return;
+      task = std::move(queue.front());
+      queue.pop_front();
+    }
+    task();
+  }
+}
+
+void ThreadPool::parallelFor(std::size_t count, fu2::function_view<void(std::size_t)> func)
+{
+  if (count == 0)
+    return;
+
+  if (count == 1 || workers.empty())
+  {
+    for (std::size_t i = 0; i < count; ++i)
+      func(i);
+    return;
+  }
+
+  // NOTE: func lives on our stack, so we MUST NOT return before every helper task has
+  // finished calling it. The counters are shared with the helpers instead, as a helper
+  // still notifies the counter after decrementing it, possibly after we have returned.
+  struct SharedState
+  {
+    std::atomic<std::size_t> nextIndex{0};
+    std::atomic<std::size_t> helpersRunning{0};
+  };
+  auto state = std::make_shared<SharedState>();
+
+  auto body = [&state = *state, count, &func]() {
+    for (std::size_t i = state.nextIndex.fetch_add(1); i < count;
+         i = state.nextIndex.fetch_add(1))
+      func(i);
+  };
+
+  const std::size_t helperCount = std::min(workers.size(), count - 1);
+  state->helpersRunning.store(helperCount);
+  {
+    std::unique_lock lock{queueMutex};
+    for (std::size_t i = 0; i < helperCount; ++i)
+      queue.emplace_back([body, state]() {
+        body();
+        state->helpersRunning.fetch_sub(1);
+        state->helpersRunning.notify_all();
+      });
+  }
+  queueCv.notify_all();
+
+  body();
+
+  // Help out with whatever is queued (possibly our own helpers) instead of just sleeping.
+  for (std::size_t running = state->helpersRunning.load(); running != 0;
+       running = state->helpersRunning.load())
+    if (!tryRunOneTask())
+      state->helpersRunning.wait(running);
+}
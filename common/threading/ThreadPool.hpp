@@ -0,0 +1,64 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <function2/function2.hpp>
+
+
+/**
+ * A very simple fixed-size pool of worker threads. Used for CPU-side work
+ * that is naturally data-parallel, e.g. sorting draw keys or recording
+ * command buffers. Not a job system: there are no dependencies between
+ * tasks and no work stealing, just a single shared queue.
+ */
+class ThreadPool
+{
+public:
+  using Task = fu2::unique_function<void()>;
+
+  // Leaves one hardware thread for the main thread, which participates in parallelFor anyway.
+  static std::size_t default_worker_count();
+
+  explicit ThreadPool(std::size_t worker_count = default_worker_count());
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  ThreadPool(ThreadPool&&) = delete;
+  ThreadPool& operator=(ThreadPool&&) = delete;
+
+  std::size_t workerCount() const { return workers.size(); }
+
+  // Amount of distinct threads that can execute parallelFor bodies, including the caller.
+  std::size_t concurrency() const { return workers.size() + 1; }
+
+  // 0 for any thread not owned by a pool (e.g. the main thread),
+  // 1..workerCount() for pool workers. Useful for indexing per-thread data.
+  static std::size_t current_thread_index();
+
+  std::future<void> submit(Task task);
+
+  // Calls func(i) for every i in [0, count) and blocks until all calls have finished.
+  // The calling thread executes iterations too, and runs other queued tasks while waiting,
+  // so nested calls from inside of a worker do not deadlock.
+  void parallelFor(std::size_t count, fu2::function_view<void(std::size_t)> func);
+
+private:
+  void workerLoop(std::size_t thread_index);
+  bool tryRunOneTask();
+
+private:
+  std::vector<std::jthread> workers;
+
+  std::mutex queueMutex;
+  std::condition_variable queueCv;
+  std::deque<Task> queue;
+  bool stopping = false;
+};
@@ -0,0 +1,282 @@
+#include "App.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <optional>
+
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+#include <tracy/Tracy.hpp>
+
+#include "gui/ImGuiRenderer.hpp"
+
+
+App::App(const HeadlessOptions& headless_options, const BenchmarkOptions& benchmark_options)
+  : headless{headless_options}
+  , benchmark{benchmark_options}
+{
+  glm::uvec2 initialRes = {1280, 720};
+
+  renderer.reset(new Renderer(initialRes));
+
+  if (headless.enabled)
+  {
+    renderer->initVulkan({}, true);
+    renderer->initHeadlessFrameDelivery(headless);
+  }
+  else
+  {
+    windowing = std::make_unique<OsWindowingManager>();
+    mainWindow = windowing->createWindow(OsWindow::CreateInfo{
+      .resolution = initialRes,
+      .resizeable = true,
+      .refreshCb =
+        [this]() {
+          // NOTE: this is only called when the window is being resized.
+          drawFrame();
+          FrameMark;
+        },
+      .resizeCb =
+        [this](glm::uvec2 res) {
+          if (res.x == 0 || res.y == 0)
+            return;
+
+          renderer->recreateSwapchain(res);
+        },
+    });
+
+    auto instExts = windowing->getRequiredVulkanInstanceExtensions();
+    renderer->initVulkan(instExts);
+
+    auto surface = mainWindow->createVkSurface(etna::get_context().getInstance());
+
+    renderer->initFrameDelivery(
+      std::move(surface), [window = mainWindow.get()]() { return window->getResolution(); });
+
+    // TODO: this is bad design, this initialization is dependent on the current ImGui context, but
+    // we pass it implicitly here instead of explicitly. Beware if trying to do something tricky.
+    ImGuiRenderer::enableImGuiForWindow(mainWindow->native());
+  }
+
+  mainCam.lookAt({0, 600, -1500}, {0, 200, 0}, {0, 1, 0});
+  mainCam.zNear = 0.5f;
+  mainCam.zFar = 10000.0f;
+
+  renderer->loadTerrain();
+}
+
+void App::run()
+{
+  if (benchmark.enabled())
+  {
+    runBenchmark();
+    return;
+  }
+
+  if (headless.enabled)
+  {
+    runHeadless();
+    return;
+  }
+
+  double lastTime = windowing->getTime();
+  while (!mainWindow->isBeingClosed())
+  {
+    const double currTime = windowing->getTime();
+    const float diffTime = static_cast<float>(currTime - lastTime);
+    lastTime = currTime;
+
+    windowing->poll();
+
+    processInput(diffTime);
+
+    drawFrame();
+
+    FrameMark;
+  }
+}
+
+void App::runHeadless()
+{
+  for (std::uint32_t i = 0; i < headless.frameCount; ++i)
+  {
+    simulatedTime = i * static_cast<double>(headless.timeStep);
+
+    drawFrame();
+
+    FrameMark;
+  }
+
+  spdlog::info("Rendered {} frames headless", headless.frameCount);
+}
+
+void App::runBenchmark()
+{
+  const auto path = CameraPath::load(benchmark.cameraPath);
+  const auto measuredFrames =
+    static_cast<std::uint32_t>(std::ceil(path.duration() / benchmark.timeStep)) + 1;
+
+  spdlog::info(
+    "Benchmarking {} frames along {} after {} warmup frames",
+    measuredFrames,
+    benchmark.cameraPath.string(),
+    benchmark.warmupFrames);
+
+  BenchmarkReport report;
+  auto& gpuProfiler = renderer->getGpuProfiler();
+  const std::uint64_t firstMeasuredGpuFrame = gpuProfiler.getFrameCount() + benchmark.warmupFrames;
+  std::optional<std::uint64_t> lastGpuFrame;
+
+  for (std::uint32_t i = 0; i < benchmark.warmupFrames + measuredFrames; ++i)
+  {
+    if (windowing)
+    {
+      windowing->poll();
+      if (mainWindow->isBeingClosed())
+        break;
+    }
+
+    // Warmup frames are rendered at the very start of the path
+    const bool measured = i >= benchmark.warmupFrames;
+    if (i == benchmark.warmupFrames && !benchmark.tracePath.empty())
+    {
+      gpuProfiler.calibrate();
+      get_trace_capture().start(benchmark.tracePath, measuredFrames);
+    }
+
+    const std::uint32_t frame = measured ? i - benchmark.warmupFrames : 0;
+    simulatedTime = frame * static_cast<double>(benchmark.timeStep);
+    mainCam = path.evaluate(static_cast<float>(simulatedTime));
+
+    const auto frameStart = std::chrono::steady_clock::now();
+    drawFrame();
+    const std::chrono::duration<double, std::milli> cpuTime =
+      std::chrono::steady_clock::now() - frameStart;
+
+    FrameMark;
+
+    if (!measured)
+      continue;
+
+    const auto& stats = renderer->getFrameStats();
+    report.addSample("cpu_frame_ms", cpuTime.count());
+    report.addSample("draw_calls", stats.drawCalls);
+    report.addSample("triangles", static_cast<double>(stats.triangles));
+
+    // GPU timings of a frame only become available a few frames later,
+    // so the last few frames of the path do not contribute to them.
+    const auto gpuFrame = gpuProfiler.getResolvedFrame();
+    if (gpuFrame && gpuFrame != lastGpuFrame && *gpuFrame >= firstMeasuredGpuFrame)
+      for (const auto& timing : gpuProfiler.getResolvedTimings())
+        report.addSample(fmt::format("gpu_{}_ms", timing.name), timing.durationMs);
+    lastGpuFrame = gpuFrame;
+  }
+
+  report.write(benchmark.reportPath);
+}
+
+void App::recordKeyframe()
+{
+  const double now = windowing->getTime();
+  if (recordedPath.empty())
+    recordStartTime = now;
+
+  recordedPath.addKeyframe(static_cast<float>(now - recordStartTime), mainCam);
+  recordedPath.save(benchmark.recordPath);
+
+  spdlog::info(
+    "Recorded camera keyframe #{} into {}",
+    recordedPath.getKeyframes().size(),
+    benchmark.recordPath.string());
+}
+
+void App::processInput(float dt)
+{
+  ZoneScoped;
+
+  if (mainWindow->keyboard[KeyboardKey::kEscape] == ButtonState::Falling)
+    mainWindow->askToClose();
+
+  if (is_held_down(mainWindow->keyboard[KeyboardKey::kLeftShift]))
+    camMoveSpeed = 500;
+  else
+    camMoveSpeed = 50;
+
+  const bool recording = !benchmark.recordPath.empty();
+  if (recording && mainWindow->keyboard[KeyboardKey::kK] == ButtonState::Falling)
+    recordKeyframe();
+
+  if (mainWindow->mouse[MouseButton::mbRight] == ButtonState::Rising)
+    mainWindow->captureMouse = !mainWindow->captureMouse;
+
+  moveCam(mainCam, mainWindow->keyboard, dt);
+  if (mainWindow->captureMouse)
+    rotateCam(mainCam, mainWindow->mouse, dt);
+
+  renderer->debugInput(mainWindow->keyboard);
+}
+
+void App::drawFrame()
+{
+  {
+    ZoneScoped;
+    TRACE_CPU_SCOPE("frame");
+
+    renderer->update(FramePacket{
+      .mainCam = mainCam,
+      .currentTime = getTime(),
+    });
+    renderer->drawFrame();
+  }
+
+  // Outside of the frame's zone, so that the last frame of a capture is complete
+  get_trace_capture().endFrame();
+}
+
+float App::getTime() const
+{
+  const bool realTime = windowing && !benchmark.enabled();
+  return static_cast<float>(realTime ? windowing->getTime() : simulatedTime);
+}
+
+void App::moveCam(Camera& cam, const Keyboard& kb, float dt)
+{
+  // Move position of camera based on WASD keys, and FR keys for up and down
+
+  glm::vec3 dir = {0, 0, 0};
+
+  if (is_held_down(kb[KeyboardKey::kS]))
+    dir -= cam.forward();
+
+  if (is_held_down(kb[KeyboardKey::kW]))
+    dir += cam.forward();
+
+  if (is_held_down(kb[KeyboardKey::kA]))
+    dir -= cam.right();
+
+  if (is_held_down(kb[KeyboardKey::kD]))
+    dir += cam.right();
+
+  if (is_held_down(kb[KeyboardKey::kF]))
+    dir -= cam.up();
+
+  if (is_held_down(kb[KeyboardKey::kR]))
+    dir += cam.up();
+
+  // NOTE: This is how you make moving diagonally not be faster than
+  // in a straight line.
+  cam.move(dt * camMoveSpeed * (length(dir) > 1e-9 ? normalize(dir) : dir));
+}
+
+void App::rotateCam(Camera& cam, const Mouse& ms, float /*dt*/)
+{
+  // Rotate camera based on mouse movement
+  cam.rotate(camRotateSpeed * ms.capturedPosDelta.y, camRotateSpeed * ms.capturedPosDelta.x);
+
+  // Increase or decrease field of view based on mouse wheel
+  cam.fov -= zoomSensitivity * ms.scrollDelta.y;
+  if (cam.fov < 1.0f)
+    cam.fov = 1.0f;
+  if (cam.fov > 120.0f)
+    cam.fov = 120.0f;
+}
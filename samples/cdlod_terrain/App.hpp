@@ -0,0 +1,58 @@
+#pragma once
+
+#include "wsi/OsWindowingManager.hpp"
+#include "scene/Camera.hpp"
+#include "scene/CameraPath.hpp"
+#include "render_utils/HeadlessOptions.hpp"
+#include "profiling/Benchmark.hpp"
+
+#include "Renderer.hpp"
+
+
+/**
+ * Main class of the application. Contains things that are not strictly
+ * related to rendering, e.g. OS window creation, input handling.
+ * In headless mode there is no window and no input, the app renders
+ * a fixed amount of frames with a fixed time step and exits.
+ * In benchmark mode the main camera follows a recorded path instead of the input.
+ */
+class App
+{
+public:
+  explicit App(
+    const HeadlessOptions& headless_options = {}, const BenchmarkOptions& benchmark_options = {});
+
+  void run();
+
+private:
+  void runHeadless();
+  void runBenchmark();
+  void recordKeyframe();
+  void processInput(float dt);
+  void drawFrame();
+  float getTime() const;
+
+  void moveCam(Camera& cam, const Keyboard& kb, float dt);
+  void rotateCam(Camera& cam, const Mouse& ms, float dt);
+
+private:
+  HeadlessOptions headless;
+  BenchmarkOptions benchmark;
+  // Used instead of the wall clock in headless and benchmark modes
+  double simulatedTime = 0;
+
+  CameraPath recordedPath;
+  double recordStartTime = 0;
+
+  // Both are null in headless mode
+  std::unique_ptr<OsWindowingManager> windowing;
+  std::unique_ptr<OsWindow> mainWindow;
+
+  // The terrain is kilometers across, so the camera is way faster than in other samples
+  float camMoveSpeed = 50;
+  float camRotateSpeed = 0.1f;
+  float zoomSensitivity = 2.0f;
+  Camera mainCam;
+
+  std::unique_ptr<Renderer> renderer;
+};
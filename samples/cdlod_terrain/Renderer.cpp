@@ -0,0 +1,313 @@
+#include "Renderer.hpp"
+
+#include <chrono>
+
+#include <etna/GlobalContext.hpp>
+#include <etna/Etna.hpp>
+#include <etna/RenderTargetStates.hpp>
+#include <etna/PipelineManager.hpp>
+#include <etna/Profiling.hpp>
+#include <imgui.h>
+
+#include <gui/ImGuiRenderer.hpp>
+
+
+Renderer::Renderer(glm::uvec2 res)
+  : resolution{res}
+  , threadPool{std::make_unique<ThreadPool>()}
+{
+}
+
+void Renderer::initVulkan(std::span<const char*> instance_extensions, bool headless)
+{
+  std::vector<const char*> instanceExtensions;
+
+  for (auto ext : instance_extensions)
+    instanceExtensions.push_back(ext);
+
+  std::vector<const char*> deviceExtensions;
+
+  // Software implementations used for headless runs do not necessarily support swapchains
+  if (!headless)
+    deviceExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+
+  etna::initialize(etna::InitParams{
+    .applicationName = "CdlodTerrainSample",
+    .applicationVersion = VK_MAKE_VERSION(0, 1, 0),
+    .instanceExtensions = instanceExtensions,
+    .deviceExtensions = deviceExtensions,
+    // Terrain patches are tessellated on the GPU, and indirect draws of every LOD but the
+    // first one start in the middle of the instance data. Triangles coming out of the
+    // tessellator are counted with pipeline statistics.
+    .features = vk::PhysicalDeviceFeatures2{
+      .features =
+        {
+          .tessellationShader = VK_TRUE,
+          .drawIndirectFirstInstance = VK_TRUE,
+          .pipelineStatisticsQuery = VK_TRUE,
+        },
+    },
+    // Replace with an index if etna detects your preferred GPU incorrectly
+    .physicalDeviceIndexOverride = {},
+    // How much frames we buffer on the GPU without waiting for their completion on the CPU
+    .numFramesInFlight = 2,
+  });
+
+  pipelineCache = std::make_unique<PipelineCache>(
+    std::filesystem::temp_directory_path() / "graphics_course_cdlod_terrain.pipeline_cache");
+}
+
+void Renderer::initFrameDelivery(vk::UniqueSurfaceKHR a_surface, ResolutionProvider res_provider)
+{
+  auto& ctx = etna::get_context();
+
+  resolutionProvider = std::move(res_provider);
+  commandManager = ctx.createPerFrameCmdMgr();
+
+  window = ctx.createWindow(etna::Window::CreateInfo{
+    .surface = std::move(a_surface),
+  });
+
+  auto [w, h] = window->recreateSwapchain(etna::Window::DesiredProperties{
+    .resolution = {resolution.x, resolution.y},
+    .vsync = true,
+  });
+  resolution = {w, h};
+
+  initWorldRenderer(window->getCurrentFormat());
+
+  shaderReloader = std::make_unique<ShaderHotReloader>(ShaderHotReloader::CreateInfo{
+    .shaderDirs = {CDLOD_TERRAIN_SHADERS_ROOT},
+  });
+}
+
+void Renderer::initHeadlessFrameDelivery(const HeadlessOptions& options)
+{
+  commandManager = etna::get_context().createPerFrameCmdMgr();
+
+  offscreenTarget = std::make_unique<OffscreenTarget>(OffscreenTarget::CreateInfo{
+    .resolution = resolution,
+    .dumpDir = options.dumpDir,
+    .threadPool = threadPool.get(),
+  });
+
+  initWorldRenderer(offscreenTarget->getFormat());
+}
+
+void Renderer::initWorldRenderer(vk::Format target_format)
+{
+  gpuProfiler = std::make_unique<GpuProfiler>();
+  worldRenderer = std::make_unique<WorldRenderer>(*gpuProfiler);
+
+  worldRenderer->allocateResources(resolution);
+
+  const auto pipelinesStart = std::chrono::steady_clock::now();
+
+  // ImGui creates its pipeline without going through etna's pipeline manager,
+  // so this can happen on a worker while etna pipelines are being created here.
+  // NOTE: its font upload submits to etna's queue from the worker, which is only fine
+  // because nothing below touches the queue until the GUI is done.
+  // There is no ImGui at all without a window to get input from.
+  std::future<void> guiCreated;
+  if (window)
+    guiCreated = threadPool->submit([this, target_format, cache = pipelineCache->get()]() {
+      ZoneScopedN("createGuiRenderer");
+      guiRenderer = std::make_unique<ImGuiRenderer>(target_format, cache);
+    });
+
+  worldRenderer->loadShaders();
+  worldRenderer->setupPipelines(target_format);
+
+  if (guiCreated.valid())
+    guiCreated.get();
+
+  const std::chrono::duration<double, std::milli> pipelinesTime =
+    std::chrono::steady_clock::now() - pipelinesStart;
+  // etna's pipeline manager has no way to take a pipeline cache, so the persistent one
+  // only covers the GUI pipeline, the rest is up to the driver's own cache
+  spdlog::info(
+    "Shaders and pipelines set up in {:.1f} ms, GUI pipeline cache was {}",
+    pipelinesTime.count(),
+    pipelineCache->isWarm() ? "loaded from disk" : "empty");
+}
+
+void Renderer::recreateSwapchain(glm::uvec2 res)
+{
+  auto& ctx = etna::get_context();
+
+  ETNA_CHECK_VK_RESULT(ctx.getDevice().waitIdle());
+
+  auto [w, h] = window->recreateSwapchain(etna::Window::DesiredProperties{
+    .resolution = {res.x, res.y},
+    .vsync = true,
+  });
+  resolution = {w, h};
+
+  // Most resources depend on the current resolution, so we recreate them.
+  worldRenderer->allocateResources(resolution);
+
+  // Format of the swapchain CAN change on android
+  worldRenderer->setupPipelines(window->getCurrentFormat());
+}
+
+void Renderer::loadTerrain()
+{
+  worldRenderer->loadTerrain();
+}
+
+void Renderer::debugInput(const Keyboard& kb)
+{
+  worldRenderer->debugInput(kb);
+
+  if (kb[KeyboardKey::kB] == ButtonState::Falling)
+    shaderReloader->requestFullRebuild();
+
+  if (kb[KeyboardKey::kF1] == ButtonState::Falling)
+    statsOverlay.toggle();
+}
+
+void Renderer::update(const FramePacket& packet)
+{
+  worldRenderer->update(packet);
+}
+
+void Renderer::drawFrame()
+{
+  ZoneScoped;
+  TRACE_CPU_SCOPE("drawFrame");
+
+  if (offscreenTarget)
+  {
+    drawOffscreenFrame();
+    return;
+  }
+
+  // Shaders recompiled in the background are swapped in between frames
+  shaderReloader->applyPendingReloads();
+
+  {
+    ZoneScopedN("drawGui");
+    TRACE_CPU_SCOPE("drawGui");
+    guiRenderer->nextFrame();
+    ImGui::NewFrame();
+    worldRenderer->drawGui();
+    profilerWindow.draw(*gpuProfiler);
+    statsOverlay.draw(*gpuProfiler);
+    ImGui::Render();
+  }
+
+  auto currentCmdBuf = commandManager->acquireNext();
+
+  // TODO: this makes literally 0 sense here, rename/refactor,
+  // it doesn't actually begin anything, just resets descriptor pools
+  etna::begin_frame();
+
+  auto nextSwapchainImage = window->acquireNext();
+
+  // NOTE: here, we skip frames when the window is in the process of being
+  // re-sized. This is not mandatory, it is possible to submit frames to a
+  // "sub-optimal" swap chain and still get something drawn while resizing,
+  // but only on some platforms (not windows+nvidia, sadly).
+  if (nextSwapchainImage)
+  {
+    auto [image, view, availableSem] = *nextSwapchainImage;
+
+    ETNA_CHECK_VK_RESULT(currentCmdBuf.begin(vk::CommandBufferBeginInfo{}));
+    {
+      ETNA_PROFILE_GPU(currentCmdBuf, renderFrame);
+
+      recordFrame(currentCmdBuf, image, view);
+
+      etna::set_state(
+        currentCmdBuf,
+        image,
+        vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+        {},
+        vk::ImageLayout::ePresentSrcKHR,
+        vk::ImageAspectFlagBits::eColor);
+
+      etna::flush_barriers(currentCmdBuf);
+
+      ETNA_READ_BACK_GPU_PROFILING(currentCmdBuf);
+    }
+    ETNA_CHECK_VK_RESULT(currentCmdBuf.end());
+
+    auto renderingDone = commandManager->submit(std::move(currentCmdBuf), std::move(availableSem));
+
+    const bool presented = window->present(std::move(renderingDone), view);
+
+    if (!presented)
+      nextSwapchainImage = std::nullopt;
+  }
+
+  etna::end_frame();
+
+  statsOverlay.endFrame(worldRenderer->getFrameStats(), *gpuProfiler);
+
+  if (!nextSwapchainImage)
+  {
+    auto res = resolutionProvider();
+    // On windows, we get 0,0 while the window is minimized and
+    // must skip frames until the window is un-minimized again
+    if (res.x != 0 && res.y != 0)
+      recreateSwapchain(res);
+  }
+}
+
+void Renderer::drawOffscreenFrame()
+{
+  auto currentCmdBuf = commandManager->acquireNext();
+
+  etna::begin_frame();
+
+  // Also hands the frame previously rendered in this slot over to be written out
+  auto [image, view, availableSem] = offscreenTarget->acquireNext();
+
+  ETNA_CHECK_VK_RESULT(currentCmdBuf.begin(vk::CommandBufferBeginInfo{}));
+  {
+    ETNA_PROFILE_GPU(currentCmdBuf, renderFrame);
+
+    recordFrame(currentCmdBuf, image, view);
+
+    offscreenTarget->recordReadback(currentCmdBuf);
+
+    ETNA_READ_BACK_GPU_PROFILING(currentCmdBuf);
+  }
+  ETNA_CHECK_VK_RESULT(currentCmdBuf.end());
+
+  auto renderingDone = commandManager->submit(std::move(currentCmdBuf), availableSem);
+
+  offscreenTarget->present(renderingDone);
+
+  etna::end_frame();
+}
+
+void Renderer::recordFrame(
+  vk::CommandBuffer cmd_buf, vk::Image target_image, vk::ImageView target_view)
+{
+  gpuProfiler->beginFrame(cmd_buf);
+  GpuProfiler::Scope frameScope{*gpuProfiler, cmd_buf, "frame"};
+
+  worldRenderer->renderWorld(cmd_buf, target_image, target_view);
+
+  if (guiRenderer)
+  {
+    GpuProfiler::Scope guiScope{*gpuProfiler, cmd_buf, "gui"};
+    ImDrawData* pDrawData = ImGui::GetDrawData();
+    guiRenderer->render(
+      cmd_buf, {{0, 0}, {resolution.x, resolution.y}}, target_image, target_view, pDrawData);
+  }
+}
+
+Renderer::~Renderer()
+{
+  ETNA_CHECK_VK_RESULT(etna::get_context().getDevice().waitIdle());
+
+  // Frames that are still in flight have not been written out yet
+  if (offscreenTarget)
+    offscreenTarget->finish();
+  if (gpuProfiler)
+    gpuProfiler->resolveFramesInFlight();
+
+  pipelineCache->save();
+}
@@ -0,0 +1,475 @@
+#include "WorldRenderer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <limits>
+#include <utility>
+
+#include <etna/Assert.hpp>
+#include <etna/DescriptorSet.hpp>
+#include <etna/Etna.hpp>
+#include <etna/GlobalContext.hpp>
+#include <etna/OneShotCmdMgr.hpp>
+#include <etna/PipelineManager.hpp>
+#include <etna/Profiling.hpp>
+#include <glm/ext.hpp>
+#include <imgui.h>
+#include <spdlog/spdlog.h>
+#include <tracy/Tracy.hpp>
+
+#include "render_utils/EmbeddedShaders.hpp"
+
+
+// Heightmap texels are a meter apart
+static constexpr float TERRAIN_WORLD_SIZE = 4096.0f;
+static constexpr float TERRAIN_HEIGHT_SCALE = 600.0f;
+// Texels along the side of the finest quadtree nodes
+static constexpr std::uint32_t LEAF_NODE_SIZE = 64;
+// Blocks of a LOD reach up to a node beyond its range, and vertices of the next LOD there
+// must not be morphing yet. Shorter ranges or earlier morphing break that and crack.
+static constexpr float MIN_LOD_RANGE = 192.0f;
+static constexpr float MIN_MORPH_START = 0.5f;
+// Every device supports at least 64, higher factors are not worth the triangles anyway
+static constexpr int MAX_TESS_FACTOR = 32;
+static constexpr std::uint32_t PATCHES_PER_BLOCK = TERRAIN_BLOCK_PATCHES * TERRAIN_BLOCK_PATCHES;
+// Enough for every finest block of a 4096x4096 map at once, with room to spare for constants
+static constexpr vk::DeviceSize UPLOAD_RING_FRAME_SIZE = 512 * 1024;
+// Matches SKY_COLOR of terrain.frag
+static constexpr std::array SKY_COLOR{0.45f, 0.6f, 0.85f, 1.0f};
+
+WorldRenderer::WorldRenderer(GpuProfiler& gpu_profiler)
+  : gpuProfiler{gpu_profiler}
+  , uploadRing{UploadRing::CreateInfo{
+      .perFrameSize = UPLOAD_RING_FRAME_SIZE,
+      .bufferUsage = vk::BufferUsageFlagBits::eUniformBuffer |
+        vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer,
+      .name = "cdlod_terrain_upload_ring",
+    }}
+{
+  auto& ctx = etna::get_context();
+
+  const std::size_t framesInFlight = ctx.getMainWorkCount().multiBufferingCount();
+  statisticsRecorded.resize(framesInFlight, false);
+  for (std::size_t i = 0; i < framesInFlight; ++i)
+    statisticsPools.push_back(
+      etna::unwrap_vk_result(ctx.getDevice().createQueryPoolUnique(vk::QueryPoolCreateInfo{
+        .queryType = vk::QueryType::ePipelineStatistics,
+        .queryCount = 1,
+        .pipelineStatistics = vk::QueryPipelineStatisticFlagBits::eClippingInvocations,
+      })));
+}
+
+void WorldRenderer::allocateResources(glm::uvec2 swapchain_resolution)
+{
+  resolution = swapchain_resolution;
+
+  // Render targets of the old resolution are of no use anymore.
+  // NOTE: this is only called when the GPU is idle.
+  renderGraph.reset();
+  renderGraph.releaseUnusedImages();
+
+  heightmapSampler = etna::Sampler(etna::Sampler::CreateInfo{
+    .filter = vk::Filter::eLinear,
+    .addressMode = vk::SamplerAddressMode::eClampToEdge,
+    .name = "heightmap_sampler",
+  });
+}
+
+void WorldRenderer::loadTerrain()
+{
+  ZoneScoped;
+
+  heightmap = std::make_unique<Heightmap>(Heightmap::CreateInfo{
+    .params = {},
+    .cacheDir = std::filesystem::temp_directory_path() / "graphics_course_terrain",
+  });
+
+  quadtree = std::make_unique<TerrainQuadtree>(TerrainQuadtree::CreateInfo{
+    .heights = heightmap->getHeights(),
+    .size = heightmap->getParams().size,
+    .leafSize = LEAF_NODE_SIZE,
+    .worldSize = TERRAIN_WORLD_SIZE,
+    .heightScale = TERRAIN_HEIGHT_SCALE,
+  });
+  ETNA_VERIFYF(
+    quadtree->getLodCount() <= TERRAIN_MAX_LODS,
+    "Terrain quadtree has {} LODs, only {} are supported!",
+    quadtree->getLodCount(),
+    TERRAIN_MAX_LODS);
+
+  spdlog::info(
+    "Terrain quadtree has {} LODs, a fixed grid of the same detail would be {} triangles",
+    quadtree->getLodCount(),
+    getBaselineTriangles());
+
+  // The heightmap never changes, so it's made readable by the terrain shaders once
+  // instead of going through the render graph every frame
+  auto cmdMgr = etna::get_context().createOneShotCmdMgr();
+  auto cmdBuf = cmdMgr->start();
+  ETNA_CHECK_VK_RESULT(cmdBuf.begin(vk::CommandBufferBeginInfo{
+    .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit,
+  }));
+  etna::set_state(
+    cmdBuf,
+    heightmap->getImage().get(),
+    vk::PipelineStageFlagBits2::eTessellationControlShader |
+      vk::PipelineStageFlagBits2::eTessellationEvaluationShader |
+      vk::PipelineStageFlagBits2::eFragmentShader,
+    vk::AccessFlagBits2::eShaderSampledRead,
+    vk::ImageLayout::eShaderReadOnlyOptimal,
+    vk::ImageAspectFlagBits::eColor);
+  etna::flush_barriers(cmdBuf);
+  ETNA_CHECK_VK_RESULT(cmdBuf.end());
+  cmdMgr->submitAndWait(std::move(cmdBuf));
+}
+
+void WorldRenderer::loadShaders()
+{
+  // Shaders of the build tree are the ones that get hot reloaded, so they win when present.
+  // Otherwise, e.g. when the executable was copied elsewhere, the embedded ones are used.
+  // etna only loads shaders from files, hence those are written out first.
+  std::filesystem::path root = CDLOD_TERRAIN_SHADERS_ROOT;
+  if (!std::filesystem::exists(root / "terrain.vert.spv"))
+  {
+    root = std::filesystem::temp_directory_path() / "graphics_course_cdlod_terrain_shaders";
+    write_embedded_shaders(root);
+    spdlog::info("Using embedded shaders, written into {}", root.string());
+  }
+
+  etna::create_program(
+    "terrain",
+    {(root / "terrain.vert.spv").string(),
+     (root / "terrain.tesc.spv").string(),
+     (root / "terrain.tese.spv").string(),
+     (root / "terrain.frag.spv").string()});
+}
+
+void WorldRenderer::setupPipelines(vk::Format swapchain_format)
+{
+  targetFormat = swapchain_format;
+
+  auto& pipelineManager = etna::get_context().getPipelineManager();
+  terrainPipeline = pipelineManager.createGraphicsPipeline(
+    "terrain",
+    etna::GraphicsPipeline::CreateInfo{
+      // Every vertex is a patch of its own, see terrain.vert
+      .inputAssemblyConfig = {.topology = vk::PrimitiveTopology::ePatchList},
+      .tessellationConfig = {.patchControlPoints = 1},
+      // Winding of the tessellated triangles as seen from above depends on the handedness
+      // of the view, and the terrain is hardly ever seen from below anyway
+      .rasterizationConfig =
+        vk::PipelineRasterizationStateCreateInfo{
+          .polygonMode = vk::PolygonMode::eFill,
+          .cullMode = vk::CullModeFlagBits::eNone,
+          .lineWidth = 1.f,
+        },
+      .fragmentShaderOutput =
+        {
+          .colorAttachmentFormats = {swapchain_format},
+          .depthAttachmentFormat = vk::Format::eD32Sfloat,
+        },
+    });
+}
+
+void WorldRenderer::debugInput(const Keyboard& kb)
+{
+  if (kb[KeyboardKey::kG] == ButtonState::Falling)
+    dumpRenderGraph = true;
+}
+
+void WorldRenderer::updateLodMorph()
+{
+  for (std::uint32_t lod = 0; lod < quadtree->getLodCount(); ++lod)
+  {
+    const float end = quadtree->getLodRange(lodRange, lod);
+    // The coarsest LOD has nothing to morph into
+    if (std::isinf(end))
+    {
+      terrainParams.lodMorph[lod] = {std::numeric_limits<float>::max(), 0.0f, 0.0f, 0.0f};
+      continue;
+    }
+
+    const float prevEnd = lod > 0 ? quadtree->getLodRange(lodRange, lod - 1) : 0.0f;
+    const float start = glm::mix(prevEnd, end, morphStart);
+    terrainParams.lodMorph[lod] = {start, 1.0f / (end - start), 0.0f, 0.0f};
+  }
+}
+
+void WorldRenderer::readTriangleCount()
+{
+  const std::uint32_t frame = etna::get_context().getMainWorkCount().batchIndex();
+  if (!statisticsRecorded[frame])
+    return;
+
+  std::uint64_t clippingInvocations = 0;
+  const auto result = etna::get_context().getDevice().getQueryPoolResults(
+    statisticsPools[frame].get(),
+    0,
+    1,
+    sizeof(clippingInvocations),
+    &clippingInvocations,
+    sizeof(clippingInvocations),
+    vk::QueryResultFlagBits::e64);
+
+  // The frame's fence has been waited on, so this only happens if it was never submitted
+  if (result == vk::Result::eSuccess)
+    measuredTriangles = clippingInvocations;
+}
+
+std::uint64_t WorldRenderer::getBaselineTriangles() const
+{
+  const std::uint64_t cellsPerSide = std::uint64_t{quadtree->getSize()} /
+    quadtree->getBlockSize(0) * TERRAIN_BLOCK_PATCHES * static_cast<std::uint64_t>(tessFactor);
+  return 2 * cellsPerSide * cellsPerSide;
+}
+
+void WorldRenderer::update(const FramePacket& packet)
+{
+  ZoneScoped;
+  TRACE_CPU_SCOPE("update");
+
+  const float aspect = float(resolution.x) / float(resolution.y);
+  const glm::mat4x4 viewProj = packet.mainCam.projTm(aspect) * packet.mainCam.viewTm();
+
+  if (!freezeSelection)
+  {
+    selectionCameraPos = packet.mainCam.position;
+    selectionViewProj = viewProj;
+  }
+
+  // Morphing has to agree with the selection, or LODs wouldn't line up
+  terrainParams.viewProj = viewProj;
+  terrainParams.cameraPos = selectionCameraPos;
+  terrainParams.worldSize = quadtree->getWorldSize();
+  terrainParams.sunDirection = glm::normalize(glm::vec3{0.4f, 0.6f, 0.3f});
+  terrainParams.heightScale = quadtree->getHeightScale();
+  terrainParams.heightmapSize = static_cast<float>(quadtree->getSize());
+  terrainParams.tessFactor = static_cast<std::uint32_t>(tessFactor);
+  terrainParams.colorByLod = colorByLod ? 1 : 0;
+  updateLodMorph();
+
+  quadtree->select(
+    TerrainQuadtree::SelectInfo{
+      .cameraPos = selectionCameraPos,
+      .viewProj = selectionViewProj,
+      .lodRange = lodRange,
+    },
+    blocks);
+
+  lodBlockCounts.fill(0);
+  for (const auto& block : blocks)
+    ++lodBlockCounts[block.lod];
+}
+
+void WorldRenderer::renderWorld(
+  vk::CommandBuffer cmd_buf, vk::Image target_image, vk::ImageView target_image_view)
+{
+  ETNA_PROFILE_GPU(cmd_buf, renderWorld);
+  TRACE_CPU_SCOPE("renderWorld");
+
+  prevFrameStats = std::exchange(stats, {});
+
+  uploadRing.beginFrame();
+  const auto constants = uploadRing.push(terrainParams);
+
+  // Empty storage buffer bindings are not allowed, hence at least one block
+  const auto blockData =
+    uploadRing.allocate(std::max<std::size_t>(blocks.size(), 1) * sizeof(TerrainBlock));
+  auto* instances = reinterpret_cast<TerrainBlock*>(blockData.data);
+  const float texelSize = quadtree->getWorldSize() / static_cast<float>(quadtree->getSize());
+  for (std::size_t i = 0; i < blocks.size(); ++i)
+    instances[i] = TerrainBlock{
+      .origin = glm::vec2(blocks[i].offset) * texelSize - 0.5f * quadtree->getWorldSize(),
+      .patchSize = static_cast<float>(quadtree->getBlockSize(blocks[i].lod)) * texelSize /
+        TERRAIN_BLOCK_PATCHES,
+      .lod = blocks[i].lod,
+    };
+
+  // Blocks are sorted by LOD, so every LOD is a range of instances drawn by a single command
+  const std::uint32_t lodCount = quadtree->getLodCount();
+  const auto drawData = uploadRing.allocate(lodCount * sizeof(vk::DrawIndirectCommand));
+  auto* draws = reinterpret_cast<vk::DrawIndirectCommand*>(drawData.data);
+  std::uint32_t firstInstance = 0;
+  for (std::uint32_t lod = 0; lod < lodCount; ++lod)
+  {
+    draws[lod] = vk::DrawIndirectCommand{
+      .vertexCount = PATCHES_PER_BLOCK,
+      .instanceCount = lodBlockCounts[lod],
+      .firstVertex = 0,
+      .firstInstance = firstInstance,
+    };
+    firstInstance += lodBlockCounts[lod];
+  }
+  stats.bytesUploaded = uploadRing.getFrameUsage();
+  stats.instances = static_cast<std::uint32_t>(blocks.size());
+
+  readTriangleCount();
+  stats.triangles = measuredTriangles;
+
+  const std::uint32_t frame = etna::get_context().getMainWorkCount().batchIndex();
+  const vk::QueryPool statisticsPool = statisticsPools[frame].get();
+  cmd_buf.resetQueryPool(statisticsPool, 0, 1);
+  statisticsRecorded[frame] = true;
+
+  renderGraph.reset();
+
+  const auto backbuffer = renderGraph.importImage(
+    "backbuffer",
+    target_image,
+    target_image_view,
+    {.extent = {resolution.x, resolution.y, 1}, .format = targetFormat});
+  renderGraph.markOutput(backbuffer);
+
+  vk::DescriptorSet terrainSet;
+  auto depth = RenderGraph::ResourceId::Invalid;
+  renderGraph.addPass(
+    "terrain",
+    [&](RenderGraph::PassBuilder& builder) {
+      depth = builder.create(
+        "main_view_depth",
+        {.extent = {resolution.x, resolution.y, 1}, .format = vk::Format::eD32Sfloat});
+      builder.write(backbuffer, RenderGraph::Access::ColorAttachment);
+      builder.write(depth, RenderGraph::Access::DepthAttachment);
+    },
+    [&](vk::CommandBuffer cmd, const RenderGraph::PassResources& res) {
+      ETNA_PROFILE_GPU(cmd, renderTerrain);
+
+      const vk::RenderingAttachmentInfo colorAttachment{
+        .imageView = target_image_view,
+        .imageLayout = vk::ImageLayout::eColorAttachmentOptimal,
+        .loadOp = vk::AttachmentLoadOp::eClear,
+        .storeOp = vk::AttachmentStoreOp::eStore,
+        .clearValue = vk::ClearColorValue{SKY_COLOR},
+      };
+      const vk::RenderingAttachmentInfo depthAttachment{
+        .imageView = res.getView(depth),
+        .imageLayout = vk::ImageLayout::eDepthStencilAttachmentOptimal,
+        .loadOp = vk::AttachmentLoadOp::eClear,
+        .storeOp = vk::AttachmentStoreOp::eDontCare,
+        .clearValue = vk::ClearDepthStencilValue{1.0f, 0},
+      };
+      const vk::Rect2D area{{0, 0}, {resolution.x, resolution.y}};
+      cmd.beginQuery(statisticsPool, 0, {});
+      cmd.beginRendering(vk::RenderingInfo{
+        .renderArea = area,
+        .layerCount = 1,
+        .colorAttachmentCount = 1,
+        .pColorAttachments = &colorAttachment,
+        .pDepthAttachment = &depthAttachment,
+      });
+
+      cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, terrainPipeline.getVkPipeline());
+      cmd.setViewport(
+        0,
+        {vk::Viewport{
+          .x = 0.0f,
+          .y = 0.0f,
+          .width = static_cast<float>(resolution.x),
+          .height = static_cast<float>(resolution.y),
+          .minDepth = 0.0f,
+          .maxDepth = 1.0f,
+        }});
+      cmd.setScissor(0, {area});
+      cmd.bindDescriptorSets(
+        vk::PipelineBindPoint::eGraphics,
+        terrainPipeline.getVkPipelineLayout(),
+        0,
+        {terrainSet},
+        {});
+      ++stats.pipelineBinds;
+      ++stats.descriptorBinds;
+
+      for (std::uint32_t lod = 0; lod < lodCount; ++lod)
+      {
+        if (lodBlockCounts[lod] == 0)
+          continue;
+
+        cmd.drawIndirect(
+          uploadRing.getBuffer().get(),
+          drawData.offset + lod * sizeof(vk::DrawIndirectCommand),
+          1,
+          sizeof(vk::DrawIndirectCommand));
+        ++stats.drawCalls;
+      }
+
+      cmd.endRendering();
+      cmd.endQuery(statisticsPool, 0);
+    });
+
+  renderGraph.compile();
+
+  if (std::exchange(dumpRenderGraph, false))
+    spdlog::info("{}", renderGraph.dump());
+
+  // The graph takes care of image layouts, hence no barriers from here
+  auto terrainDescriptors = etna::create_descriptor_set(
+    etna::get_shader_program("terrain").getDescriptorLayoutId(0),
+    cmd_buf,
+    {etna::Binding{0, uploadRing.genBinding(constants)},
+     etna::Binding{1, uploadRing.genBinding(blockData)},
+     etna::Binding{
+       2,
+       heightmap->getImage().genBinding(
+         heightmapSampler.get(), vk::ImageLayout::eShaderReadOnlyOptimal)}},
+    etna::BarrierBehavoir::eSuppressBarriers);
+  terrainSet = terrainDescriptors.getVkSet();
+
+  renderGraph.execute(cmd_buf, &gpuProfiler);
+}
+
+void WorldRenderer::drawGui()
+{
+  ImGui::Begin("Simple render settings");
+
+  ImGui::SliderFloat("LOD 0 range", &lodRange, MIN_LOD_RANGE, 2048.0f);
+  ImGui::SliderFloat("Morph start", &morphStart, MIN_MORPH_START, 0.95f);
+  ImGui::SliderInt("Tessellation factor", &tessFactor, 2, MAX_TESS_FACTOR);
+  tessFactor = std::max(tessFactor / 2 * 2, 2);
+  ImGui::Checkbox("Color by LOD", &colorByLod);
+  // Keeps the selection of the current view, fly around to see what got culled
+  ImGui::Checkbox("Freeze selection", &freezeSelection);
+
+  const auto& params = heightmap->getParams();
+  ImGui::Text(
+    "Heightmap: %ux%u, %s",
+    params.size,
+    params.size,
+    heightmap->isFromCache() ? "loaded from the cache" : "generated");
+
+  ImGui::Text("Blocks: %zu", blocks.size());
+  for (std::uint32_t lod = 0; lod < quadtree->getLodCount(); ++lod)
+    ImGui::Text(
+      "  LOD %u: %u blocks, up to %.0f",
+      lod,
+      lodBlockCounts[lod],
+      quadtree->getLodRange(lodRange, lod));
+
+  // Measured on the GPU, so the count includes the halved factors of morphed edges
+  const auto baseline = getBaselineTriangles();
+  ImGui::Text(
+    "Triangles drawn: %llu, fixed grid of the same detail: %llu (%.3f%%)",
+    static_cast<unsigned long long>(prevFrameStats.triangles),
+    static_cast<unsigned long long>(baseline),
+    100.0 * static_cast<double>(prevFrameStats.triangles) / static_cast<double>(baseline));
+  ImGui::Text("Terrain: %.3f ms", gpuProfiler.getAverageMs("terrain"));
+
+  ImGui::Text(
+    "Application average %.3f ms/frame (%.1f FPS)",
+    1000.0f / ImGui::GetIO().Framerate,
+    ImGui::GetIO().Framerate);
+
+  ImGui::Text(
+    "Draw calls: %u, pipeline binds: %u, descriptor binds: %u",
+    prevFrameStats.drawCalls,
+    prevFrameStats.pipelineBinds,
+    prevFrameStats.descriptorBinds);
+
+  ImGui::NewLine();
+
+  ImGui::TextColored(
+    ImVec4(1.0f, 1.0f, 0.0f, 1.0f), "Shaders reload on save, press 'B' to recompile all of them");
+  ImGui::TextColored(ImVec4(1.0f, 1.0f, 0.0f, 1.0f), "Press 'G' to dump the render graph");
+  ImGui::TextColored(ImVec4(1.0f, 1.0f, 0.0f, 1.0f), "Press 'F1' to toggle the stats overlay");
+  ImGui::End();
+}
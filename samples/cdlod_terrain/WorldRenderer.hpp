@@ -0,0 +1,108 @@
+#pragma once
+
+#include <array>
+#include <memory>
+#include <vector>
+
+#include <etna/Sampler.hpp>
+#include <etna/GraphicsPipeline.hpp>
+#include <glm/glm.hpp>
+
+#include "shaders/TerrainParams.h"
+#include "render_utils/RenderStats.hpp"
+#include "render_utils/UploadRing.hpp"
+#include "render_graph/RenderGraph.hpp"
+#include "profiling/GpuProfiler.hpp"
+#include "terrain/Heightmap.hpp"
+#include "terrain/TerrainQuadtree.hpp"
+#include "wsi/Keyboard.hpp"
+
+#include "FramePacket.hpp"
+
+
+/**
+ * The meat of the sample. All things you see on the screen are contained within this class.
+ * This what you want to change and expand between different samples.
+ *
+ * The terrain is a heightmap drawn through a CDLOD quadtree: blocks of the quadtree
+ * are selected and culled on the CPU every frame, then every LOD is drawn with a single
+ * indirect draw of tessellated patches, see shaders/terrain.tesc.
+ */
+class WorldRenderer
+{
+public:
+  explicit WorldRenderer(GpuProfiler& gpu_profiler);
+
+  // Generates the heightmap, or loads it from the disk cache, and builds the quadtree over it
+  void loadTerrain();
+
+  void loadShaders();
+  void allocateResources(glm::uvec2 swapchain_resolution);
+  void setupPipelines(vk::Format swapchain_format);
+
+  void debugInput(const Keyboard& kb);
+  void update(const FramePacket& packet);
+  void drawGui();
+  void renderWorld(
+    vk::CommandBuffer cmd_buf, vk::Image target_image, vk::ImageView target_image_view);
+
+  // Counters of the last renderWorld call
+  const RenderStats& getFrameStats() const { return stats; }
+
+private:
+  // Fills per-LOD morph zones of the terrain constants
+  void updateLodMorph();
+  // Reads back the statistics of the terrain pass of the frame previously recorded into
+  // the current slot, which has finished on the GPU by now
+  void readTriangleCount();
+  // Triangles of a regular grid covering the whole terrain with the density of LOD 0
+  std::uint64_t getBaselineTriangles() const;
+
+private:
+  GpuProfiler& gpuProfiler;
+
+  // The depth buffer is a transient image living in here
+  RenderGraph renderGraph;
+  bool dumpRenderGraph = false;
+
+  // Per-frame constants, block instances and indirect draws live here,
+  // so frames in flight never overwrite each other's data
+  UploadRing uploadRing;
+
+  std::unique_ptr<Heightmap> heightmap;
+  std::unique_ptr<TerrainQuadtree> quadtree;
+  etna::Sampler heightmapSampler;
+
+  // Distance up to which LOD 0 is used, every next LOD covers twice the distance
+  float lodRange = 256.0f;
+  // Fraction of a LOD's range after which its vertices start morphing into the next LOD
+  float morphStart = 0.66f;
+  // Of every patch, only even values keep patch corners on the grid of the next LOD
+  int tessFactor = 8;
+  bool colorByLod = false;
+  // Keeps the selection of the frozen view, so that culling can be inspected from outside
+  bool freezeSelection = false;
+  glm::vec3 selectionCameraPos{};
+  glm::mat4x4 selectionViewProj{};
+
+  // Sorted by LOD, finest first, i.e. roughly front to back
+  std::vector<TerrainQuadtree::Block> blocks;
+  std::array<std::uint32_t, TERRAIN_MAX_LODS> lodBlockCounts{};
+
+  TerrainParams terrainParams{};
+  etna::GraphicsPipeline terrainPipeline;
+
+  // Counts primitives reaching clipping in the terrain pass, i.e. what the tessellator made.
+  // One pool per frame in flight, just like GpuProfiler does with timestamps.
+  std::vector<vk::UniqueQueryPool> statisticsPools;
+  std::vector<bool> statisticsRecorded;
+  // Of the latest frame that was read back, lags behind by the amount of frames in flight
+  std::uint64_t measuredTriangles = 0;
+
+  RenderStats stats;
+  // drawGui runs before renderWorld, so the GUI shows the numbers of the previous frame
+  RenderStats prevFrameStats;
+
+  glm::uvec2 resolution;
+  vk::Format targetFormat = vk::Format::eUndefined;
+};
@@ -0,0 +1,17 @@
+#include "App.hpp"
+
+
+int main(int argc, char** argv)
+{
+  {
+    App app(parse_headless_options(argc, argv), parse_benchmark_options(argc, argv));
+    app.run();
+  }
+
+  // Etna needs to be de-initialized after all resources allocated by app
+  // and it's sub-fields are already freed.
+  if (etna::is_initilized())
+    etna::shutdown();
+
+  return 0;
+}
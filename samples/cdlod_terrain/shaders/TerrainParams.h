@@ -0,0 +1,39 @@
+#ifndef TERRAIN_PARAMS_H_INCLUDED
+#define TERRAIN_PARAMS_H_INCLUDED
+
+#include "cpp_glsl_compat.h"
+
+
+// Upper bound on the LOD count of the terrain quadtree
+#define TERRAIN_MAX_LODS 16
+// Patches along the side of a quadtree block, every patch is tessellated into a grid
+#define TERRAIN_BLOCK_PATCHES 4
+
+struct TerrainParams
+{
+  shader_mat4 viewProj;
+  // Distance at which morphing into the next LOD starts in x, 1 / length of the morph zone in y.
+  // Vertices are fully morphed where the next LOD takes over.
+  shader_vec4 lodMorph[TERRAIN_MAX_LODS];
+  shader_vec3 cameraPos;
+  shader_float worldSize;
+  shader_vec3 sunDirection;
+  shader_float heightScale;
+  // Of the heightmap, in texels
+  shader_float heightmapSize;
+  // Even, so that patch corners always end up on the grid of the next LOD
+  shader_uint tessFactor;
+  shader_uint colorByLod;
+  shader_uint padding0;
+};
+
+// Instance data of a quadtree block
+struct TerrainBlock
+{
+  // World space XZ of the corner with the lowest coordinates
+  shader_vec2 origin;
+  shader_float patchSize;
+  shader_uint lod;
+};
+
+#endif // TERRAIN_PARAMS_H_INCLUDED
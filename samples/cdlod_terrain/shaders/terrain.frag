@@ -0,0 +1,47 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : require
+
+#include "terrain.glsl"
+
+// Normals come from the heightmap itself rather than from the triangles,
+// so that lighting doesn't change while vertices morph
+
+
+layout(location = 0) in vec3 tePosition;
+layout(location = 1) flat in uint teLod;
+
+layout(location = 0) out vec4 out_fragColor;
+
+// Matches the clear color of the terrain pass
+const vec3 SKY_COLOR = vec3(0.45, 0.6, 0.85);
+const float FOG_DENSITY = 0.00025;
+
+vec3 lod_color(uint lod)
+{
+  return 0.5 + 0.5 * cos(6.2831853 * (0.17 * float(lod) + vec3(0.0, 0.33, 0.67)));
+}
+
+void main()
+{
+  const float texel = params.worldSize / params.heightmapSize;
+  const vec2 xz = tePosition.xz;
+  const float left = terrain_height(xz - vec2(texel, 0));
+  const float right = terrain_height(xz + vec2(texel, 0));
+  const float back = terrain_height(xz - vec2(0, texel));
+  const float front = terrain_height(xz + vec2(0, texel));
+  const vec3 normal = normalize(vec3(left - right, 2.0 * texel, back - front));
+
+  // Grass on flat ground, rock on slopes, snow on top of the highest flat ground
+  vec3 albedo = mix(vec3(0.3, 0.27, 0.24), vec3(0.22, 0.38, 0.12), smoothstep(0.75, 0.9, normal.y));
+  const float snow = smoothstep(0.6, 0.7, tePosition.y / params.heightScale);
+  albedo = mix(albedo, vec3(0.9, 0.92, 0.95), snow * smoothstep(0.6, 0.8, normal.y));
+  if (params.colorByLod != 0)
+    albedo = lod_color(teLod);
+
+  const float diffuse = max(dot(normal, params.sunDirection), 0.0);
+  const vec3 color = albedo * (0.2 * SKY_COLOR + vec3(diffuse));
+
+  const float fog = 1.0 - exp(-distance(tePosition, params.cameraPos) * FOG_DENSITY);
+  out_fragColor = vec4(mix(color, SKY_COLOR, fog), 1.0);
+}
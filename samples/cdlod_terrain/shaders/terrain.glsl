@@ -0,0 +1,44 @@
+#ifndef TERRAIN_GLSL_INCLUDED
+#define TERRAIN_GLSL_INCLUDED
+
+#include "TerrainParams.h"
+
+// Bindings and helpers shared by all stages of the terrain pipeline
+
+
+layout(binding = 0) uniform TerrainData
+{
+  TerrainParams params;
+};
+
+layout(binding = 1, std430) readonly buffer Blocks
+{
+  TerrainBlock blocks[];
+};
+
+layout(binding = 2) uniform sampler2D heightmap;
+
+float terrain_height(vec2 xz)
+{
+  return textureLod(heightmap, xz / params.worldSize + 0.5, 0).r * params.heightScale;
+}
+
+vec3 terrain_position(vec2 xz)
+{
+  return vec3(xz.x, terrain_height(xz), xz.y);
+}
+
+// 0 before the morph zone of the LOD, 1 where the next LOD takes over
+float morph_factor(vec3 pos, uint lod)
+{
+  const vec2 morph = params.lodMorph[lod].xy;
+  return clamp((distance(pos, params.cameraPos) - morph.x) * morph.y, 0.0, 1.0);
+}
+
+// Grid of a LOD has vertices every cell_size, starting at the terrain corner
+vec2 grid_coords(vec2 xz, float cell_size)
+{
+  return round((xz + 0.5 * params.worldSize) / cell_size);
+}
+
+#endif // TERRAIN_GLSL_INCLUDED
@@ -0,0 +1,24 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : require
+
+#include "terrain.glsl"
+
+// Every vertex is a single point patch, every instance is a quadtree block of patches.
+// Nothing is fed from vertex buffers.
+
+
+layout(location = 0) out vec2 vPatchOrigin;
+layout(location = 1) out float vPatchSize;
+layout(location = 2) out uint vLod;
+
+void main()
+{
+  const TerrainBlock block = blocks[gl_InstanceIndex];
+  const uvec2 patchCoords = uvec2(
+    gl_VertexIndex % TERRAIN_BLOCK_PATCHES, gl_VertexIndex / TERRAIN_BLOCK_PATCHES);
+
+  vPatchOrigin = block.origin + vec2(patchCoords) * block.patchSize;
+  vPatchSize = block.patchSize;
+  vLod = block.lod;
+}
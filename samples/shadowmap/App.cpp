@@ -1,44 +1,62 @@
 #include "App.hpp"
 
+#include <chrono>
+#include <cmath>
+#include <optional>
+
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
 #include <tracy/Tracy.hpp>
 
 #include "gui/ImGuiRenderer.hpp"
 
 
-App::App()
+App::App(const HeadlessOptions& headless_options, const BenchmarkOptions& benchmark_options)
+  : headless{headless_options}
+  , benchmark{benchmark_options}
 {
   glm::uvec2 initialRes = {1280, 720};
-  mainWindow = windowing.createWindow(OsWindow::CreateInfo{
-    .resolution = initialRes,
-    .resizeable = true,
-    .refreshCb =
-      [this]() {
-        // NOTE: this is only called when the window is being resized.
-        drawFrame();
-        FrameMark;
-      },
-    .resizeCb =
-      [this](glm::uvec2 res) {
-        if (res.x == 0 || res.y == 0)
-          return;
-
-        renderer->recreateSwapchain(res);
-      },
-  });
 
   renderer.reset(new Renderer(initialRes));
 
-  auto instExts = windowing.getRequiredVulkanInstanceExtensions();
-  renderer->initVulkan(instExts);
-
-  auto surface = mainWindow->createVkSurface(etna::get_context().getInstance());
-
-  renderer->initFrameDelivery(
-    std::move(surface), [window = mainWindow.get()]() { return window->getResolution(); });
-
-  // TODO: this is bad design, this initialization is dependent on the current ImGui context, but we
-  // pass it implicitly here instead of explicitly. Beware if trying to do something tricky.
-  ImGuiRenderer::enableImGuiForWindow(mainWindow->native());
+  if (headless.enabled)
+  {
+    renderer->initVulkan({}, true);
+    renderer->initHeadlessFrameDelivery(headless);
+  }
+  else
+  {
+    windowing = std::make_unique<OsWindowingManager>();
+    mainWindow = windowing->createWindow(OsWindow::CreateInfo{
+      .resolution = initialRes,
+      .resizeable = true,
+      .refreshCb =
+        [this]() {
+          // NOTE: this is only called when the window is being resized.
+          drawFrame();
+          FrameMark;
+        },
+      .resizeCb =
+        [this](glm::uvec2 res) {
+          if (res.x == 0 || res.y == 0)
+            return;
+
+          renderer->recreateSwapchain(res);
+        },
+    });
+
+    auto instExts = windowing->getRequiredVulkanInstanceExtensions();
+    renderer->initVulkan(instExts);
+
+    auto surface = mainWindow->createVkSurface(etna::get_context().getInstance());
+
+    renderer->initFrameDelivery(
+      std::move(surface), [window = mainWindow.get()]() { return window->getResolution(); });
+
+    // TODO: this is bad design, this initialization is dependent on the current ImGui context, but
+    // we pass it implicitly here instead of explicitly. Beware if trying to do something tricky.
+    ImGuiRenderer::enableImGuiForWindow(mainWindow->native());
+  }
 
   shadowCam.lookAt({-8, 10, 8}, {0, 0, 0}, {0, 1, 0});
   mainCam.lookAt({0, 10, 10}, {0, 0, 0}, {0, 1, 0});
@@ -48,14 +66,26 @@ App::App()
 
 void App::run()
 {
-  double lastTime = windowing.getTime();
+  if (benchmark.enabled())
+  {
+    runBenchmark();
+    return;
+  }
+
+  if (headless.enabled)
+  {
+    runHeadless();
+    return;
+  }
+
+  double lastTime = windowing->getTime();
   while (!mainWindow->isBeingClosed())
   {
-    const double currTime = windowing.getTime();
+    const double currTime = windowing->getTime();
     const float diffTime = static_cast<float>(currTime - lastTime);
     lastTime = currTime;
 
-    windowing.poll();
+    windowing->poll();
 
     processInput(diffTime);
 
@@ -65,6 +95,100 @@ void App::run()
   }
 }
 
+void App::runHeadless()
+{
+  for (std::uint32_t i = 0; i < headless.frameCount; ++i)
+  {
+    simulatedTime = i * static_cast<double>(headless.timeStep);
+
+    drawFrame();
+
+    FrameMark;
+  }
+
+  spdlog::info("Rendered {} frames headless", headless.frameCount);
+}
+
+void App::runBenchmark()
+{
+  const auto path = CameraPath::load(benchmark.cameraPath);
+  const auto measuredFrames =
+    static_cast<std::uint32_t>(std::ceil(path.duration() / benchmark.timeStep)) + 1;
+
+  spdlog::info(
+    "Benchmarking {} frames along {} after {} warmup frames",
+    measuredFrames,
+    benchmark.cameraPath.string(),
+    benchmark.warmupFrames);
+
+  BenchmarkReport report;
+  auto& gpuProfiler = renderer->getGpuProfiler();
+  const std::uint64_t firstMeasuredGpuFrame = gpuProfiler.getFrameCount() + benchmark.warmupFrames;
+  std::optional<std::uint64_t> lastGpuFrame;
+
+  for (std::uint32_t i = 0; i < benchmark.warmupFrames + measuredFrames; ++i)
+  {
+    if (windowing)
+    {
+      windowing->poll();
+      if (mainWindow->isBeingClosed())
+        break;
+    }
+
+    // Warmup frames are rendered at the very start of the path
+    const bool measured = i >= benchmark.warmupFrames;
+    if (i == benchmark.warmupFrames && !benchmark.tracePath.empty())
+    {
+      gpuProfiler.calibrate();
+      get_trace_capture().start(benchmark.tracePath, measuredFrames);
+    }
+
+    const std::uint32_t frame = measured ? i - benchmark.warmupFrames : 0;
+    simulatedTime = frame * static_cast<double>(benchmark.timeStep);
+    mainCam = path.evaluate(static_cast<float>(simulatedTime));
+
+    const auto frameStart = std::chrono::steady_clock::now();
+    drawFrame();
+    const std::chrono::duration<double, std::milli> cpuTime =
+      std::chrono::steady_clock::now() - frameStart;
+
+    FrameMark;
+
+    if (!measured)
+      continue;
+
+    const auto& stats = renderer->getFrameStats();
+    report.addSample("cpu_frame_ms", cpuTime.count());
+    report.addSample("draw_calls", stats.drawCalls);
+    report.addSample("triangles", static_cast<double>(stats.triangles));
+
+    // GPU timings of a frame only become available a few frames later,
+    // so the last few frames of the path do not contribute to them.
+    const auto gpuFrame = gpuProfiler.getResolvedFrame();
+    if (gpuFrame && gpuFrame != lastGpuFrame && *gpuFrame >= firstMeasuredGpuFrame)
+      for (const auto& timing : gpuProfiler.getResolvedTimings())
+        report.addSample(fmt::format("gpu_{}_ms", timing.name), timing.durationMs);
+    lastGpuFrame = gpuFrame;
+  }
+
+  report.write(benchmark.reportPath);
+}
+
+void App::recordKeyframe()
+{
+  const double now = windowing->getTime();
+  if (recordedPath.empty())
+    recordStartTime = now;
+
+  recordedPath.addKeyframe(static_cast<float>(now - recordStartTime), mainCam);
+  recordedPath.save(benchmark.recordPath);
+
+  spdlog::info(
+    "Recorded camera keyframe #{} into {}",
+    recordedPath.getKeyframes().size(),
+    benchmark.recordPath.string());
+}
+
 void App::processInput(float dt)
 {
   ZoneScoped;
@@ -80,6 +204,10 @@ void App::processInput(float dt)
   if (mainWindow->keyboard[KeyboardKey::kL] == ButtonState::Falling)
     controlShadowCam = !controlShadowCam;
 
+  const bool recording = !benchmark.recordPath.empty();
+  if (recording && mainWindow->keyboard[KeyboardKey::kK] == ButtonState::Falling)
+    recordKeyframe();
+
   if (mainWindow->mouse[MouseButton::mbRight] == ButtonState::Rising)
     mainWindow->captureMouse = !mainWindow->captureMouse;
 
@@ -94,14 +222,26 @@ void App::processInput(float dt)
 
 void App::drawFrame()
 {
-  ZoneScoped;
+  {
+    ZoneScoped;
+    TRACE_CPU_SCOPE("frame");
+
+    renderer->update(FramePacket{
+      .mainCam = mainCam,
+      .shadowCam = shadowCam,
+      .currentTime = getTime(),
+    });
+    renderer->drawFrame();
+  }
 
-  renderer->update(FramePacket{
-    .mainCam = mainCam,
-    .shadowCam = shadowCam,
-    .currentTime = static_cast<float>(windowing.getTime()),
-  });
-  renderer->drawFrame();
+  // Outside of the frame's zone, so that the last frame of a capture is complete
+  get_trace_capture().endFrame();
+}
+
+float App::getTime() const
+{
+  const bool realTime = windowing && !benchmark.enabled();
+  return static_cast<float>(realTime ? windowing->getTime() : simulatedTime);
 }
 
 void App::moveCam(Camera& cam, const Keyboard& kb, float dt)
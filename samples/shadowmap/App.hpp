@@ -2,6 +2,9 @@
 
 #include "wsi/OsWindowingManager.hpp"
 #include "scene/Camera.hpp"
+#include "scene/CameraPath.hpp"
+#include "render_utils/HeadlessOptions.hpp"
+#include "profiling/Benchmark.hpp"
 
 #include "Renderer.hpp"
 
@@ -9,23 +12,40 @@
 /**
  * Main class of the application. Contains things that are not strictly
  * related to rendering, e.g. OS window creation, input handling.
+ * In headless mode there is no window and no input, the app renders
+ * a fixed amount of frames with a fixed time step and exits.
+ * In benchmark mode the main camera follows a recorded path instead of the input.
  */
 class App
 {
 public:
-  App();
+  explicit App(
+    const HeadlessOptions& headless_options = {}, const BenchmarkOptions& benchmark_options = {});
 
   void run();
 
 private:
+  void runHeadless();
+  void runBenchmark();
+  void recordKeyframe();
   void processInput(float dt);
   void drawFrame();
+  float getTime() const;
 
   void moveCam(Camera& cam, const Keyboard& kb, float dt);
   void rotateCam(Camera& cam, const Mouse& ms, float dt);
 
 private:
-  OsWindowingManager windowing;
+  HeadlessOptions headless;
+  BenchmarkOptions benchmark;
+  // Used instead of the wall clock in headless and benchmark modes
+  double simulatedTime = 0;
+
+  CameraPath recordedPath;
+  double recordStartTime = 0;
+
+  // Both are null in headless mode
+  std::unique_ptr<OsWindowingManager> windowing;
   std::unique_ptr<OsWindow> mainWindow;
 
   float camMoveSpeed = 1;
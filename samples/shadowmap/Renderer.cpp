@@ -1,5 +1,7 @@
 #include "Renderer.hpp"
 
+#include <chrono>
+
 #include <etna/GlobalContext.hpp>
 #include <etna/Etna.hpp>
 #include <etna/RenderTargetStates.hpp>
@@ -12,10 +14,11 @@
 
 Renderer::Renderer(glm::uvec2 res)
   : resolution{res}
+  , threadPool{std::make_unique<ThreadPool>()}
 {
 }
 
-void Renderer::initVulkan(std::span<const char*> instance_extensions)
+void Renderer::initVulkan(std::span<const char*> instance_extensions, bool headless)
 {
   std::vector<const char*> instanceExtensions;
 
@@ -24,7 +27,9 @@ void Renderer::initVulkan(std::span<const char*> instance_extensions)
 
   std::vector<const char*> deviceExtensions;
 
-  deviceExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+  // Software implementations used for headless runs do not necessarily support swapchains
+  if (!headless)
+    deviceExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
 
   etna::initialize(etna::InitParams{
     .applicationName = "ShadowmapSample",
@@ -37,6 +42,9 @@ void Renderer::initVulkan(std::span<const char*> instance_extensions)
     // How much frames we buffer on the GPU without waiting for their completion on the CPU
     .numFramesInFlight = 2,
   });
+
+  pipelineCache = std::make_unique<PipelineCache>(
+    std::filesystem::temp_directory_path() / "graphics_course_shadowmap.pipeline_cache");
 }
 
 void Renderer::initFrameDelivery(vk::UniqueSurfaceKHR a_surface, ResolutionProvider res_provider)
@@ -56,13 +64,61 @@ void Renderer::initFrameDelivery(vk::UniqueSurfaceKHR a_surface, ResolutionProvi
   });
   resolution = {w, h};
 
-  worldRenderer = std::make_unique<WorldRenderer>();
+  initWorldRenderer(window->getCurrentFormat());
+
+  shaderReloader = std::make_unique<ShaderHotReloader>(ShaderHotReloader::CreateInfo{
+    .shaderDirs = {SHADOWMAP_SHADERS_ROOT},
+  });
+}
+
+void Renderer::initHeadlessFrameDelivery(const HeadlessOptions& options)
+{
+  commandManager = etna::get_context().createPerFrameCmdMgr();
+
+  offscreenTarget = std::make_unique<OffscreenTarget>(OffscreenTarget::CreateInfo{
+    .resolution = resolution,
+    .dumpDir = options.dumpDir,
+    .threadPool = threadPool.get(),
+  });
+
+  initWorldRenderer(offscreenTarget->getFormat());
+}
+
+void Renderer::initWorldRenderer(vk::Format target_format)
+{
+  gpuProfiler = std::make_unique<GpuProfiler>();
+  worldRenderer = std::make_unique<WorldRenderer>(*threadPool, *gpuProfiler);
 
   worldRenderer->allocateResources(resolution);
-  worldRenderer->loadShaders();
-  worldRenderer->setupPipelines(window->getCurrentFormat());
 
-  guiRenderer = std::make_unique<ImGuiRenderer>(window->getCurrentFormat());
+  const auto pipelinesStart = std::chrono::steady_clock::now();
+
+  // ImGui creates its pipeline without going through etna's pipeline manager,
+  // so this can happen on a worker while etna pipelines are being created here.
+  // NOTE: its font upload submits to etna's queue from the worker, which is only fine
+  // because nothing below touches the queue until the GUI is done.
+  // There is no ImGui at all without a window to get input from.
+  std::future<void> guiCreated;
+  if (window)
+    guiCreated = threadPool->submit([this, target_format, cache = pipelineCache->get()]() {
+      ZoneScopedN("createGuiRenderer");
+      guiRenderer = std::make_unique<ImGuiRenderer>(target_format, cache);
+    });
+
+  worldRenderer->loadShaders();
+  worldRenderer->setupPipelines(target_format);
+
+  if (guiCreated.valid())
+    guiCreated.get();
+
+  const std::chrono::duration<double, std::milli> pipelinesTime =
+    std::chrono::steady_clock::now() - pipelinesStart;
+  // etna's pipeline manager has no way to take a pipeline cache, so the persistent one
+  // only covers the GUI pipeline, the rest is up to the driver's own cache
+  spdlog::info(
+    "Shaders and pipelines set up in {:.1f} ms, GUI pipeline cache was {}",
+    pipelinesTime.count(),
+    pipelineCache->isWarm() ? "loaded from disk" : "empty");
 }
 
 void Renderer::recreateSwapchain(glm::uvec2 res)
@@ -94,18 +150,10 @@ void Renderer::debugInput(const Keyboard& kb)
   worldRenderer->debugInput(kb);
 
   if (kb[KeyboardKey::kB] == ButtonState::Falling)
-  {
-    const int retval = std::system("cd " GRAPHICS_COURSE_ROOT "/build"
-                                   " && cmake --build . --target shadowmap_shaders");
-    if (retval != 0)
-      spdlog::warn("Shader recompilation returned a non-zero return code!");
-    else
-    {
-      ETNA_CHECK_VK_RESULT(etna::get_context().getDevice().waitIdle());
-      etna::reload_shaders();
-      spdlog::info("Successfully reloaded shaders!");
-    }
-  }
+    shaderReloader->requestFullRebuild();
+
+  if (kb[KeyboardKey::kF1] == ButtonState::Falling)
+    statsOverlay.toggle();
 }
 
 void Renderer::update(const FramePacket& packet)
@@ -116,12 +164,25 @@ void Renderer::update(const FramePacket& packet)
 void Renderer::drawFrame()
 {
   ZoneScoped;
+  TRACE_CPU_SCOPE("drawFrame");
+
+  if (offscreenTarget)
+  {
+    drawOffscreenFrame();
+    return;
+  }
+
+  // Shaders recompiled in the background are swapped in between frames
+  shaderReloader->applyPendingReloads();
 
   {
     ZoneScopedN("drawGui");
+    TRACE_CPU_SCOPE("drawGui");
     guiRenderer->nextFrame();
     ImGui::NewFrame();
     worldRenderer->drawGui();
+    profilerWindow.draw(*gpuProfiler);
+    statsOverlay.draw(*gpuProfiler);
     ImGui::Render();
   }
 
@@ -145,13 +206,7 @@ void Renderer::drawFrame()
     {
       ETNA_PROFILE_GPU(currentCmdBuf, renderFrame);
 
-      worldRenderer->renderWorld(currentCmdBuf, image, view);
-
-      {
-        ImDrawData* pDrawData = ImGui::GetDrawData();
-        guiRenderer->render(
-          currentCmdBuf, {{0, 0}, {resolution.x, resolution.y}}, image, view, pDrawData);
-      }
+      recordFrame(currentCmdBuf, image, view);
 
       etna::set_state(
         currentCmdBuf,
@@ -177,6 +232,8 @@ void Renderer::drawFrame()
 
   etna::end_frame();
 
+  statsOverlay.endFrame(worldRenderer->getFrameStats(), *gpuProfiler);
+
   if (!nextSwapchainImage)
   {
     auto res = resolutionProvider();
@@ -187,7 +244,60 @@ void Renderer::drawFrame()
   }
 }
 
+void Renderer::drawOffscreenFrame()
+{
+  auto currentCmdBuf = commandManager->acquireNext();
+
+  etna::begin_frame();
+
+  // Also hands the frame previously rendered in this slot over to be written out
+  auto [image, view, availableSem] = offscreenTarget->acquireNext();
+
+  ETNA_CHECK_VK_RESULT(currentCmdBuf.begin(vk::CommandBufferBeginInfo{}));
+  {
+    ETNA_PROFILE_GPU(currentCmdBuf, renderFrame);
+
+    recordFrame(currentCmdBuf, image, view);
+
+    offscreenTarget->recordReadback(currentCmdBuf);
+
+    ETNA_READ_BACK_GPU_PROFILING(currentCmdBuf);
+  }
+  ETNA_CHECK_VK_RESULT(currentCmdBuf.end());
+
+  auto renderingDone = commandManager->submit(std::move(currentCmdBuf), availableSem);
+
+  offscreenTarget->present(renderingDone);
+
+  etna::end_frame();
+}
+
+void Renderer::recordFrame(
+  vk::CommandBuffer cmd_buf, vk::Image target_image, vk::ImageView target_view)
+{
+  gpuProfiler->beginFrame(cmd_buf);
+  GpuProfiler::Scope frameScope{*gpuProfiler, cmd_buf, "frame"};
+
+  worldRenderer->renderWorld(cmd_buf, target_image, target_view);
+
+  if (guiRenderer)
+  {
+    GpuProfiler::Scope guiScope{*gpuProfiler, cmd_buf, "gui"};
+    ImDrawData* pDrawData = ImGui::GetDrawData();
+    guiRenderer->render(
+      cmd_buf, {{0, 0}, {resolution.x, resolution.y}}, target_image, target_view, pDrawData);
+  }
+}
+
 Renderer::~Renderer()
 {
   ETNA_CHECK_VK_RESULT(etna::get_context().getDevice().waitIdle());
+
+  // Frames that are still in flight have not been written out yet
+  if (offscreenTarget)
+    offscreenTarget->finish();
+  if (gpuProfiler)
+    gpuProfiler->resolveFramesInFlight();
+
+  pipelineCache->save();
 }
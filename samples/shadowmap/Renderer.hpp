@@ -6,6 +6,14 @@
 #include <function2/function2.hpp>
 
 #include "wsi/Keyboard.hpp"
+#include "threading/ThreadPool.hpp"
+#include "render_utils/HeadlessOptions.hpp"
+#include "render_utils/OffscreenTarget.hpp"
+#include "render_utils/PipelineCache.hpp"
+#include "render_utils/ShaderHotReloader.hpp"
+#include "profiling/GpuProfiler.hpp"
+#include "gui/ProfilerWindow.hpp"
+#include "gui/StatsOverlay.hpp"
 
 #include "FramePacket.hpp"
 #include "WorldRenderer.hpp"
@@ -18,6 +26,7 @@ using ResolutionProvider = fu2::unique_function<glm::uvec2() const>;
 /**
  * This class encapsulates things that are very unlikely to change from one sample to another.
  * E.g. initialization, frame delivery logic, window resizing, gui setup, etc.
+ * Frames are delivered either to a window or, in headless mode, to an offscreen target.
  */
 class Renderer
 {
@@ -26,8 +35,9 @@ public:
   ~Renderer();
 
   // Initializing all of rendering is a tricky multi-step dance
-  void initVulkan(std::span<const char*> instance_extensions);
+  void initVulkan(std::span<const char*> instance_extensions, bool headless = false);
   void initFrameDelivery(vk::UniqueSurfaceKHR surface, ResolutionProvider res_provider);
+  void initHeadlessFrameDelivery(const HeadlessOptions& options);
   void recreateSwapchain(glm::uvec2 res);
   void loadScene(std::filesystem::path path);
 
@@ -35,14 +45,28 @@ public:
   void update(const FramePacket& packet);
   void drawFrame();
 
+  const RenderStats& getFrameStats() const { return worldRenderer->getFrameStats(); }
+  GpuProfiler& getGpuProfiler() { return *gpuProfiler; }
+
+private:
+  void initWorldRenderer(vk::Format target_format);
+  void recordFrame(vk::CommandBuffer cmd_buf, vk::Image target_image, vk::ImageView target_view);
+  void drawOffscreenFrame();
 
 private:
   ResolutionProvider resolutionProvider;
   std::unique_ptr<etna::Window> window;
+  std::unique_ptr<OffscreenTarget> offscreenTarget;
   std::unique_ptr<etna::PerFrameCmdMgr> commandManager;
 
   glm::uvec2 resolution;
+  std::unique_ptr<ThreadPool> threadPool;
+  std::unique_ptr<PipelineCache> pipelineCache;
+  std::unique_ptr<ShaderHotReloader> shaderReloader;
   std::unique_ptr<ImGuiRenderer> guiRenderer;
+  std::unique_ptr<GpuProfiler> gpuProfiler;
+  ProfilerWindow profilerWindow;
+  StatsOverlay statsOverlay;
 
   std::unique_ptr<WorldRenderer> worldRenderer;
 };
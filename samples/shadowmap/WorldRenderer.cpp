@@ -1,15 +1,84 @@
 #include "WorldRenderer.hpp"
 
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <random>
+#include <string_view>
+
 #include <etna/GlobalContext.hpp>
 #include <etna/PipelineManager.hpp>
 #include <etna/RenderTargetStates.hpp>
 #include <etna/Profiling.hpp>
+#include <fmt/format.h>
 #include <glm/ext.hpp>
 #include <imgui.h>
 
+#include "threading/ThreadPool.hpp"
+
+
+// Resolution of a single cascade
+static constexpr std::uint32_t SHADOW_MAP_SIZE = 2048;
+static constexpr std::uint32_t SHADOW_ATLAS_SIZE = 4096;
+static constexpr std::uint32_t MIN_ATLAS_TILE_SIZE = 128;
+// Tile size of a spot light covering the whole screen
+static constexpr std::uint32_t MAX_ATLAS_TILE_SIZE = 1024;
+// Lighting is accumulated in here, exposure and tonemapping bring it to the swapchain
+static constexpr vk::Format HDR_FORMAT = vk::Format::eR16G16B16A16Sfloat;
+// Length of the jitter sequence of TAA
+static constexpr std::uint32_t TAA_JITTER_SAMPLES = 8;
+// Below that, the upscaled image is too blurry to be worth the saved time
+static constexpr float MIN_RENDER_SCALE = 0.5f;
+// Fraction of the way to the estimated scale covered per frame, timings lag behind by the
+// amount of frames in flight, so jumping all the way makes the scale oscillate
+static constexpr float RENDER_SCALE_DAMPING = 0.2f;
+// Changes below that are noise, and every change disturbs TAA history a bit
+static constexpr float RENDER_SCALE_THRESHOLD = 0.02f;
+// Luminance range of the exposure histogram, in log2 units
+static constexpr float MIN_LOG_LUMINANCE = -10.0f;
+static constexpr float MAX_LOG_LUMINANCE = 2.0f;
+// 8 bytes per pixel on top of depth, see gbuffer.glsl
+static constexpr vk::Format GBUFFER_NORMAL_FORMAT = vk::Format::eR16G16Snorm;
+static constexpr vk::Format GBUFFER_ALBEDO_FORMAT = vk::Format::eR8G8B8A8Unorm;
+// Splitting queues into smaller chunks costs more in redundant binds than it gains
+static constexpr std::size_t MIN_DRAWS_PER_CHUNK = 256;
+// Constants take a few kilobytes, the rest is for the clustered light list
+static constexpr vk::DeviceSize UPLOAD_RING_FRAME_SIZE = 512 * 1024;
+// Main view depth covered by light clusters, lights further away land in the last slice
+static constexpr float CLUSTER_FAR_PLANE = 200.0f;
+// GPU profiler scopes of cascades, spelled out so that nothing is formatted every frame
+static constexpr std::array<std::string_view, MAX_SHADOW_CASCADES> CASCADE_STATIC_SCOPES{
+  "cascade0_static", "cascade1_static", "cascade2_static", "cascade3_static"};
+static constexpr std::array<std::string_view, MAX_SHADOW_CASCADES> CASCADE_DYNAMIC_SCOPES{
+  "cascade0_dynamic", "cascade1_dynamic", "cascade2_dynamic", "cascade3_dynamic"};
+
+// Low discrepancy sequence in [0, 1), consecutive samples are spread out evenly
+static float halton(std::uint32_t index, std::uint32_t base)
+{
+  float result = 0.0f;
+  float fraction = 1.0f;
+  while (index > 0)
+  {
+    fraction /= static_cast<float>(base);
+    result += fraction * static_cast<float>(index % base);
+    index /= base;
+  }
+  return result;
+}
 
-WorldRenderer::WorldRenderer()
-  : sceneMgr{std::make_unique<SceneManager>()}
+WorldRenderer::WorldRenderer(ThreadPool& thread_pool, GpuProfiler& gpu_profiler)
+  : threadPool{thread_pool}
+  , gpuProfiler{gpu_profiler}
+  , cmdRecorder{thread_pool}
+  , sceneMgr{std::make_unique<SceneManager>()}
+  , uploadRing{UploadRing::CreateInfo{
+      .perFrameSize = UPLOAD_RING_FRAME_SIZE,
+      .name = "shadowmap_upload_ring",
+    }}
+  , shadowAtlas{ShadowAtlas::CreateInfo{
+      .size = SHADOW_ATLAS_SIZE,
+      .minTileSize = MIN_ATLAS_TILE_SIZE,
+    }}
 {
 }
 
@@ -17,99 +86,554 @@ void WorldRenderer::allocateResources(glm::uvec2 swapchain_resolution)
 {
   resolution = swapchain_resolution;
 
-  auto& ctx = etna::get_context();
+  // Render targets of the old resolution are of no use anymore.
+  // NOTE: this is only called when the GPU is idle.
+  renderGraph.reset();
+  renderGraph.releaseUnusedImages();
 
-  mainViewDepth = ctx.createImage(etna::Image::CreateInfo{
-    .extent = vk::Extent3D{resolution.x, resolution.y, 1},
-    .name = "main_view_depth",
-    .format = vk::Format::eD32Sfloat,
-    .imageUsage = vk::ImageUsageFlagBits::eDepthStencilAttachment,
+  defaultSampler = etna::Sampler(etna::Sampler::CreateInfo{.name = "default_sampler"});
+  linearClampSampler = etna::Sampler(etna::Sampler::CreateInfo{
+    .filter = vk::Filter::eLinear,
+    .addressMode = vk::SamplerAddressMode::eClampToEdge,
+    .name = "linear_clamp_sampler",
   });
 
-  shadowMap = ctx.createImage(etna::Image::CreateInfo{
-    .extent = vk::Extent3D{2048, 2048, 1},
-    .name = "shadow_map",
+  for (std::size_t i = 0; i < taaHistory.size(); ++i)
+    taaHistory[i] = etna::get_context().createImage(etna::Image::CreateInfo{
+      .extent = vk::Extent3D{resolution.x, resolution.y, 1},
+      .name = fmt::format("taa_history{}", i),
+      .format = HDR_FORMAT,
+      .imageUsage =
+        vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eSampled,
+    });
+  taaHistoryValid = false;
+  renderExtent = resolution;
+  historyExtent = resolution;
+
+  shadowCache = etna::get_context().createImage(etna::Image::CreateInfo{
+    .extent = vk::Extent3D{SHADOW_MAP_SIZE, SHADOW_MAP_SIZE, 1},
+    .name = "shadow_cache",
+    .format = vk::Format::eD16Unorm,
+    .imageUsage = vk::ImageUsageFlagBits::eDepthStencilAttachment |
+      vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eSampled,
+    .layers = MAX_SHADOW_CASCADES,
+  });
+  shadowAtlasImage = etna::get_context().createImage(etna::Image::CreateInfo{
+    .extent = vk::Extent3D{SHADOW_ATLAS_SIZE, SHADOW_ATLAS_SIZE, 1},
+    .name = "shadow_atlas",
     .format = vk::Format::eD16Unorm,
     .imageUsage =
       vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eSampled,
   });
+  invalidateShadowCache();
 
-  defaultSampler = etna::Sampler(etna::Sampler::CreateInfo{.name = "default_sampler"});
-  constants = ctx.createBuffer(etna::Buffer::CreateInfo{
-    .size = sizeof(UniformParams),
-    .bufferUsage = vk::BufferUsageFlagBits::eUniformBuffer,
-    .memoryUsage = VMA_MEMORY_USAGE_CPU_ONLY,
-    .name = "constants",
+  clusterGrid = etna::get_context().createBuffer(etna::Buffer::CreateInfo{
+    .size = CLUSTER_COUNT * sizeof(glm::uvec2),
+    .bufferUsage = vk::BufferUsageFlagBits::eStorageBuffer,
+    .memoryUsage = VMA_MEMORY_USAGE_GPU_ONLY,
+    .name = "cluster_grid",
+  });
+  clusterLightIndices = etna::get_context().createBuffer(etna::Buffer::CreateInfo{
+    .size = (1 + MAX_CLUSTER_LIGHT_INDICES) * sizeof(std::uint32_t),
+    .bufferUsage =
+      vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+    .memoryUsage = VMA_MEMORY_USAGE_GPU_ONLY,
+    .name = "cluster_light_indices",
+  });
+
+  luminanceHistogram = etna::get_context().createBuffer(etna::Buffer::CreateInfo{
+    .size = LUMINANCE_HISTOGRAM_BINS * sizeof(std::uint32_t),
+    .bufferUsage =
+      vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+    .memoryUsage = VMA_MEMORY_USAGE_GPU_ONLY,
+    .name = "luminance_histogram",
+  });
+  exposureState = etna::get_context().createBuffer(etna::Buffer::CreateInfo{
+    .size = 2 * sizeof(float),
+    .bufferUsage =
+      vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+    .memoryUsage = VMA_MEMORY_USAGE_GPU_ONLY,
+    .name = "exposure_state",
+  });
+  resetExposure = true;
+}
+
+void WorldRenderer::invalidateShadowCache()
+{
+  for (auto& cascade : cascades)
+    cascade.cachedLightMatrix.reset();
+  // Tiles stay where they are, but their contents are gone
+  for (auto& light : spotLights)
+    light.renderedViewProj.reset();
+}
+
+void WorldRenderer::spawnSpotLights()
+{
+  for (const auto& light : spotLights)
+    if (light.tile.has_value())
+      shadowAtlas.free(*light.tile);
+  spotLights.clear();
+
+  if (sceneBounds.empty())
+    return;
+
+  // Same lights on every run, so that benchmarks stay comparable
+  std::mt19937 rng{42};
+  std::uniform_real_distribution<float> unit{0.0f, 1.0f};
+
+  const glm::vec3 extent = sceneBounds.max - sceneBounds.min;
+  const float range = std::clamp(0.25f * std::max(extent.x, extent.z), 2.0f, 30.0f);
+
+  spotLights.resize(std::clamp(spotLightCount, 0, MAX_SPOT_LIGHTS));
+  for (auto& light : spotLights)
+  {
+    // Lights hang above the upper half of the scene, looking down at a slight angle
+    const float x = unit(rng);
+    const float y = 0.5f + 0.5f * unit(rng);
+    const float z = unit(rng);
+    light.position = sceneBounds.min + extent * glm::vec3(x, y, z);
+
+    const float tiltX = unit(rng) - 0.5f;
+    const float tiltZ = unit(rng) - 0.5f;
+    light.direction = glm::normalize(glm::vec3(tiltX, -1.0f, tiltZ));
+
+    const float r = unit(rng);
+    const float g = unit(rng);
+    const float b = unit(rng);
+    light.color = glm::mix(glm::vec3(0.2f), glm::vec3(1.0f), glm::vec3(r, g, b));
+
+    light.range = range;
+    light.innerAngle = glm::radians(20.0f);
+    light.outerAngle = glm::radians(35.0f);
+
+    Camera lightCam;
+    lightCam.lookAt(light.position, light.position + light.direction, {1, 0, 0});
+    light.viewProj =
+      glm::perspectiveLH_ZO(-2.0f * light.outerAngle, 1.0f, 0.05f, light.range) *
+      lightCam.viewTm();
+  }
+}
+
+void WorldRenderer::spawnClusteredLights()
+{
+  clusteredLights.clear();
+
+  if (sceneBounds.empty())
+    return;
+
+  // Different seed than the spot lights, so that the two sets don't line up
+  std::mt19937 rng{1337};
+  std::uniform_real_distribution<float> unit{0.0f, 1.0f};
+
+  const glm::vec3 extent = sceneBounds.max - sceneBounds.min;
+  const float maxRange = std::clamp(0.05f * std::max(extent.x, extent.z), 1.0f, 10.0f);
+
+  clusteredLights.resize(std::clamp(clusteredLightCount, 0, MAX_CLUSTERED_LIGHTS));
+  for (std::size_t i = 0; i < clusteredLights.size(); ++i)
+  {
+    auto& light = clusteredLights[i];
+
+    // Lights are scattered close to the ground, where they light up the most
+    const float x = unit(rng);
+    const float y = 0.3f * unit(rng);
+    const float z = unit(rng);
+    light.position = sceneBounds.min + extent * glm::vec3(x, y, z);
+    light.range = maxRange * (0.5f + 0.5f * unit(rng));
+
+    const float r = unit(rng);
+    const float g = unit(rng);
+    const float b = unit(rng);
+    light.color = glm::vec3(r, g, b);
+
+    // Every other light is a spot light pointing down, the rest are point lights
+    light.direction = glm::vec3(0.0f, -1.0f, 0.0f);
+    const bool isSpot = i % 2 == 1;
+    light.cosOuterAngle = isSpot ? std::cos(glm::radians(45.0f)) : -2.0f;
+    light.cosInnerAngle = isSpot ? std::cos(glm::radians(30.0f)) : -1.5f;
+  }
+}
+
+void WorldRenderer::updateSpotLights(const Camera& main_cam)
+{
+  ZoneScoped;
+
+  const float tanHalfFov = std::tan(glm::radians(main_cam.fov) * 0.5f);
+
+  const auto desiredTileSize = [](const SpotLight& light) -> std::uint32_t {
+    if (light.screenCoverage <= 0.0f)
+      return 0;
+    const auto size = static_cast<std::uint32_t>(light.screenCoverage * MAX_ATLAS_TILE_SIZE);
+    return std::bit_ceil(std::clamp(size, MIN_ATLAS_TILE_SIZE, MAX_ATLAS_TILE_SIZE));
+  };
+
+  for (auto& light : spotLights)
+  {
+    const BoundingBox influence{
+      .min = light.position - light.range,
+      .max = light.position + light.range,
+    };
+    const float dist = glm::length(light.position - main_cam.position);
+
+    if (!is_box_visible(influence, worldViewProj))
+      light.screenCoverage = 0;
+    else if (dist <= light.range)
+      light.screenCoverage = 1;
+    else
+      light.screenCoverage = std::min(light.range / (dist * tanHalfFov), 1.0f);
+
+    // Tiles only shrink once they are 4 times too big, otherwise lights sitting on
+    // the boundary of two sizes would reallocate their tiles all the time
+    const std::uint32_t desired = desiredTileSize(light);
+    if (light.tile.has_value() &&
+        (desired == 0 || desired > light.tile->size || desired * 4 <= light.tile->size))
+    {
+      shadowAtlas.free(*light.tile);
+      light.tile.reset();
+      light.renderedViewProj.reset();
+    }
+  }
+
+  // Big tiles go first, smaller ones fit into the gaps left over
+  std::vector<std::uint32_t> needTiles;
+  for (std::uint32_t i = 0; i < spotLights.size(); ++i)
+    if (!spotLights[i].tile.has_value() && desiredTileSize(spotLights[i]) > 0)
+      needTiles.push_back(i);
+  std::ranges::sort(needTiles, std::greater{}, [&](std::uint32_t i) {
+    return desiredTileSize(spotLights[i]);
+  });
+
+  lightsWithoutTiles = 0;
+  for (auto idx : needTiles)
+  {
+    // When the atlas is crowded, a smaller tile is better than no shadow at all
+    auto& light = spotLights[idx];
+    for (std::uint32_t size = desiredTileSize(light);
+         size >= MIN_ATLAS_TILE_SIZE && !light.tile.has_value();
+         size /= 2)
+      light.tile = shadowAtlas.allocate(size);
+
+    if (!light.tile.has_value())
+      ++lightsWithoutTiles;
+  }
+
+  // Only a few tiles are rendered per frame, the most visible and the longest waiting first
+  std::vector<std::uint32_t> candidates;
+  for (std::uint32_t i = 0; i < spotLights.size(); ++i)
+    if (spotLights[i].tile.has_value() && spotLights[i].renderedViewProj != spotLights[i].viewProj)
+      candidates.push_back(i);
+  std::ranges::sort(candidates, std::greater{}, [&](std::uint32_t i) {
+    return spotLights[i].screenCoverage * static_cast<float>(1 + spotLights[i].staleFrames);
   });
 
-  constants.map();
+  const std::size_t updateCount =
+    std::min(candidates.size(), static_cast<std::size_t>(std::max(maxAtlasUpdates, 0)));
+  atlasUpdates.assign(candidates.begin(), candidates.begin() + updateCount);
+
+  for (std::size_t i = updateCount; i < candidates.size(); ++i)
+    ++spotLights[candidates[i]].staleFrames;
+
+  for (auto idx : atlasUpdates)
+  {
+    auto& light = spotLights[idx];
+    light.staleFrames = 0;
+    // The tile is rendered later this frame, before anything samples it
+    light.renderedViewProj = light.viewProj;
+    buildRenderQueue(light.queue, shadowPipelineId, light.viewProj);
+  }
+
+  // Uploaded in renderWorld together with the rest of the constants
+  spotLightTable.count = static_cast<std::uint32_t>(spotLights.size());
+  for (std::size_t i = 0; i < spotLights.size(); ++i)
+  {
+    const auto& light = spotLights[i];
+
+    // Lights waiting for their tile are drawn unshadowed for a few frames
+    glm::vec4 atlasRect{0.0f};
+    if (light.tile.has_value() && light.renderedViewProj == light.viewProj)
+      atlasRect = glm::vec4(glm::vec2(light.tile->offset), glm::vec2(float(light.tile->size))) /
+        float(SHADOW_ATLAS_SIZE);
+
+    spotLightTable.lights[i] = SpotLightData{
+      .viewProj = light.viewProj,
+      .atlasRect = atlasRect,
+      .position = light.position,
+      .range = light.range,
+      .direction = light.direction,
+      .cosOuterAngle = std::cos(light.outerAngle),
+      .color = light.color,
+      .cosInnerAngle = std::cos(light.innerAngle),
+    };
+  }
 }
 
 void WorldRenderer::loadScene(std::filesystem::path path)
 {
   sceneMgr->selectScene(path);
+  updateSceneBounds();
+  invalidateShadowCache();
+  spawnSpotLights();
+  spawnClusteredLights();
+}
+
+void WorldRenderer::updateSceneBounds()
+{
+  auto instanceMeshes = sceneMgr->getInstanceMeshes();
+  auto instanceMatrices = sceneMgr->getInstanceMatrices();
+  auto meshes = sceneMgr->getMeshes();
+
+  instanceBounds.resize(instanceMeshes.size());
+  sceneBounds = {};
+  for (std::size_t i = 0; i < instanceMeshes.size(); ++i)
+  {
+    instanceBounds[i] = meshes[instanceMeshes[i]].bounds.transformed(instanceMatrices[i]);
+    sceneBounds.extend(instanceBounds[i]);
+  }
+
+  instanceDynamic.assign(instanceMeshes.size(), false);
+  for (auto idx : sceneMgr->getDynamicInstances())
+    instanceDynamic[idx] = true;
 }
 
 void WorldRenderer::loadShaders()
 {
+  // See target_add_shader_variant calls in CMakeLists.txt
+  shaderVariants.registerProgram(
+    "scene",
+    {
+      {
+        .features = 0,
+        .shaders = {SHADOWMAP_SHADERS_ROOT "simple_depth.vert.spv"},
+      },
+      {
+        .features = FEATURE_SURFACE | FEATURE_SHADOWS | FEATURE_ANIMATED_LIGHT,
+        .shaders =
+          {SHADOWMAP_SHADERS_ROOT "simple_shadow.frag.spv",
+           SHADOWMAP_SHADERS_ROOT "simple.vert.spv"},
+      },
+      {
+        .features = FEATURE_SURFACE | FEATURE_SHADOWS,
+        .shaders =
+          {SHADOWMAP_SHADERS_ROOT "simple_static_light.frag.spv",
+           SHADOWMAP_SHADERS_ROOT "simple.vert.spv"},
+      },
+      {
+        .features = FEATURE_SURFACE | FEATURE_ANIMATED_LIGHT,
+        .shaders =
+          {SHADOWMAP_SHADERS_ROOT "simple_no_shadows.frag.spv",
+           SHADOWMAP_SHADERS_ROOT "simple.vert.spv"},
+      },
+      {
+        .features = FEATURE_SURFACE,
+        .shaders =
+          {SHADOWMAP_SHADERS_ROOT "simple_unshadowed_static.frag.spv",
+           SHADOWMAP_SHADERS_ROOT "simple.vert.spv"},
+      },
+    });
+
+  shaderVariants.registerProgram(
+    "gbuffer",
+    {
+      {
+        .features = FEATURE_SURFACE,
+        .shaders =
+          {SHADOWMAP_SHADERS_ROOT "gbuffer.frag.spv", SHADOWMAP_SHADERS_ROOT "simple.vert.spv"},
+      },
+    });
+
+  shaderVariants.registerProgram(
+    "deferred_lighting",
+    {
+      {
+        .features = FEATURE_SURFACE | FEATURE_SHADOWS | FEATURE_ANIMATED_LIGHT,
+        .shaders =
+          {SHADOWMAP_SHADERS_ROOT "deferred_lighting.frag.spv",
+           SHADOWMAP_SHADERS_ROOT "fullscreen.vert.spv"},
+      },
+      {
+        .features = FEATURE_SURFACE | FEATURE_SHADOWS,
+        .shaders =
+          {SHADOWMAP_SHADERS_ROOT "deferred_lighting_static_light.frag.spv",
+           SHADOWMAP_SHADERS_ROOT "fullscreen.vert.spv"},
+      },
+      {
+        .features = FEATURE_SURFACE | FEATURE_ANIMATED_LIGHT,
+        .shaders =
+          {SHADOWMAP_SHADERS_ROOT "deferred_lighting_no_shadows.frag.spv",
+           SHADOWMAP_SHADERS_ROOT "fullscreen.vert.spv"},
+      },
+      {
+        .features = FEATURE_SURFACE,
+        .shaders =
+          {SHADOWMAP_SHADERS_ROOT "deferred_lighting_unshadowed_static.frag.spv",
+           SHADOWMAP_SHADERS_ROOT "fullscreen.vert.spv"},
+      },
+    });
+
+  etna::create_program("light_clusters", {SHADOWMAP_SHADERS_ROOT "light_clusters.comp.spv"});
+  etna::create_program(
+    "luminance_histogram", {SHADOWMAP_SHADERS_ROOT "luminance_histogram.comp.spv"});
+  etna::create_program("exposure", {SHADOWMAP_SHADERS_ROOT "exposure.comp.spv"});
+  etna::create_program(
+    "tonemap",
+    {SHADOWMAP_SHADERS_ROOT "fullscreen.vert.spv", SHADOWMAP_SHADERS_ROOT "tonemap.frag.spv"});
   etna::create_program(
-    "simple_material",
-    {SHADOWMAP_SHADERS_ROOT "simple_shadow.frag.spv", SHADOWMAP_SHADERS_ROOT "simple.vert.spv"});
-  etna::create_program("simple_shadow", {SHADOWMAP_SHADERS_ROOT "simple.vert.spv"});
+    "taa_resolve",
+    {SHADOWMAP_SHADERS_ROOT "fullscreen.vert.spv", SHADOWMAP_SHADERS_ROOT "taa_resolve.frag.spv"});
+  etna::create_program(
+    "fxaa",
+    {SHADOWMAP_SHADERS_ROOT "fullscreen.vert.spv", SHADOWMAP_SHADERS_ROOT "fxaa.frag.spv"});
+  etna::create_program(
+    "upscale",
+    {SHADOWMAP_SHADERS_ROOT "fullscreen.vert.spv", SHADOWMAP_SHADERS_ROOT "upscale.frag.spv"});
 }
 
 void WorldRenderer::setupPipelines(vk::Format swapchain_format)
 {
+  targetFormat = swapchain_format;
+
   quadRenderer = std::make_unique<QuadRenderer>(QuadRenderer::CreateInfo{
     .format = swapchain_format,
     .rect = {{0, 0}, {512, 512}},
   });
 
-  etna::VertexShaderInputDescription sceneVertexInputDesc{
-    .bindings = {etna::VertexShaderInputDescription::Binding{
-      .byteStreamDescription = sceneMgr->getVertexFormatDescription(),
-    }},
+  // Pipelines are created lazily, but the default ones are better off created up front
+  // instead of hitching the first frame.
+  // NOTE: this is only called when the GPU is idle.
+  pipelines.clear();
+  requestPipeline(PipelineKind::Shadow, 0);
+  if (useDepthPrepass)
+    requestPipeline(PipelineKind::DepthPrepass, 0);
+  if (useDeferred)
+  {
+    requestPipeline(PipelineKind::GBuffer, FEATURE_SURFACE, useDepthPrepass);
+    requestPipeline(PipelineKind::DeferredLighting, getLightingFeatures());
+  }
+  else
+    requestPipeline(PipelineKind::Forward, getLightingFeatures(), useDepthPrepass);
+
+  auto& pipelineManager = etna::get_context().getPipelineManager();
+  clusterPipeline = pipelineManager.createComputePipeline("light_clusters", {});
+  histogramPipeline = pipelineManager.createComputePipeline("luminance_histogram", {});
+  exposurePipeline = pipelineManager.createComputePipeline("exposure", {});
+
+  auto createFullscreenPipeline = [&pipelineManager](const char* program, vk::Format format) {
+    return pipelineManager.createGraphicsPipeline(
+      program,
+      etna::GraphicsPipeline::CreateInfo{
+        .rasterizationConfig =
+          vk::PipelineRasterizationStateCreateInfo{
+            .polygonMode = vk::PolygonMode::eFill,
+            .cullMode = vk::CullModeFlagBits::eNone,
+            .lineWidth = 1.f,
+          },
+        .fragmentShaderOutput =
+          {
+            .colorAttachmentFormats = {format},
+          },
+      });
   };
+  tonemapPipeline = createFullscreenPipeline("tonemap", swapchain_format);
+  taaPipeline = createFullscreenPipeline("taa_resolve", HDR_FORMAT);
+  fxaaPipeline = createFullscreenPipeline("fxaa", swapchain_format);
+  upscalePipeline = createFullscreenPipeline("upscale", HDR_FORMAT);
+}
+
+std::uint32_t WorldRenderer::requestPipeline(
+  PipelineKind kind, ShaderVariants::FeatureMask features, bool after_prepass)
+{
+  for (std::uint32_t i = 0; i < pipelines.size(); ++i)
+    if (
+      pipelines[i].kind == kind && pipelines[i].features == features &&
+      pipelines[i].afterPrepass == after_prepass)
+      return i;
+
+  ZoneScoped;
+
+  ETNA_VERIFYF(
+    pipelines.size() < (std::size_t{1} << RenderQueue::PIPELINE_BITS),
+    "Too many pipelines for render queue sort keys!");
+
+  const char* programName = "scene";
+  if (kind == PipelineKind::GBuffer)
+    programName = "gbuffer";
+  else if (kind == PipelineKind::DeferredLighting)
+    programName = "deferred_lighting";
+  const auto& program = shaderVariants.request(programName, features);
 
+  // Variants without surface attributes only read positions
+  const bool positionOnly = (features & FEATURE_SURFACE) == 0;
+
+  etna::GraphicsPipeline::CreateInfo info{
+    .vertexShaderInput =
+      {
+        .bindings = {etna::VertexShaderInputDescription::Binding{
+          .byteStreamDescription = positionOnly ? sceneMgr->getPositionFormatDescription()
+                                                : sceneMgr->getVertexFormatDescription(),
+        }},
+      },
+    .rasterizationConfig =
+      vk::PipelineRasterizationStateCreateInfo{
+        .polygonMode = vk::PolygonMode::eFill,
+        .cullMode = vk::CullModeFlagBits::eBack,
+        .frontFace = vk::FrontFace::eCounterClockwise,
+        .lineWidth = 1.f,
+      },
+  };
+
+  switch (kind)
+  {
+  case PipelineKind::Shadow:
+    info.fragmentShaderOutput.depthAttachmentFormat = vk::Format::eD16Unorm;
+    break;
+  case PipelineKind::DepthPrepass:
+    info.fragmentShaderOutput.depthAttachmentFormat = vk::Format::eD32Sfloat;
+    break;
+  case PipelineKind::Forward:
+    info.fragmentShaderOutput.colorAttachmentFormats = {HDR_FORMAT};
+    info.fragmentShaderOutput.depthAttachmentFormat = vk::Format::eD32Sfloat;
+    break;
+  case PipelineKind::GBuffer:
+    info.fragmentShaderOutput.colorAttachmentFormats = {
+      GBUFFER_NORMAL_FORMAT, GBUFFER_ALBEDO_FORMAT};
+    info.fragmentShaderOutput.depthAttachmentFormat = vk::Format::eD32Sfloat;
+    break;
+  case PipelineKind::DeferredLighting:
+    // A fullscreen triangle, no vertices and nothing to cull
+    info.vertexShaderInput = {};
+    info.rasterizationConfig.cullMode = vk::CullModeFlagBits::eNone;
+    info.fragmentShaderOutput.colorAttachmentFormats = {HDR_FORMAT};
+    break;
+  }
+
+  if (after_prepass)
+    info.depthConfig = vk::PipelineDepthStencilStateCreateInfo{
+      .depthTestEnable = VK_TRUE,
+      .depthWriteEnable = VK_FALSE,
+      .depthCompareOp = vk::CompareOp::eEqual,
+      .maxDepthBounds = 1.0f,
+    };
 
   auto& pipelineManager = etna::get_context().getPipelineManager();
+  pipelines.push_back(PipelineEntry{
+    .kind = kind,
+    .features = features,
+    .afterPrepass = after_prepass,
+    .positionOnly = positionOnly,
+    .program = program,
+    .pipeline = pipelineManager.createGraphicsPipeline(program.c_str(), std::move(info)),
+  });
 
-  basicForwardPipeline = {};
-  basicForwardPipeline = pipelineManager.createGraphicsPipeline(
-    "simple_material",
-    etna::GraphicsPipeline::CreateInfo{
-      .vertexShaderInput = sceneVertexInputDesc,
-      .rasterizationConfig =
-        vk::PipelineRasterizationStateCreateInfo{
-          .polygonMode = vk::PolygonMode::eFill,
-          .cullMode = vk::CullModeFlagBits::eBack,
-          .frontFace = vk::FrontFace::eCounterClockwise,
-          .lineWidth = 1.f,
-        },
-      .fragmentShaderOutput =
-        {
-          .colorAttachmentFormats = {swapchain_format},
-          .depthAttachmentFormat = vk::Format::eD32Sfloat,
-        },
-    });
+  return static_cast<std::uint32_t>(pipelines.size() - 1);
+}
 
-  shadowPipeline = {};
-  shadowPipeline = pipelineManager.createGraphicsPipeline(
-    "simple_shadow",
-    etna::GraphicsPipeline::CreateInfo{
-      .vertexShaderInput = sceneVertexInputDesc,
-      .rasterizationConfig =
-        vk::PipelineRasterizationStateCreateInfo{
-          .polygonMode = vk::PolygonMode::eFill,
-          .cullMode = vk::CullModeFlagBits::eBack,
-          .frontFace = vk::FrontFace::eCounterClockwise,
-          .lineWidth = 1.f,
-        },
-      .fragmentShaderOutput =
-        {
-          .depthAttachmentFormat = vk::Format::eD16Unorm,
-        },
-    });
+ShaderVariants::FeatureMask WorldRenderer::getLightingFeatures() const
+{
+  ShaderVariants::FeatureMask result = FEATURE_SURFACE;
+  if (enableShadows)
+    result |= FEATURE_SHADOWS;
+  if (animateLight)
+    result |= FEATURE_ANIMATED_LIGHT;
+  return result;
 }
 
 void WorldRenderer::debugInput(const Keyboard& kb)
@@ -117,136 +641,1315 @@ void WorldRenderer::debugInput(const Keyboard& kb)
   if (kb[KeyboardKey::kQ] == ButtonState::Falling)
     drawDebugFSQuad = !drawDebugFSQuad;
 
-  if (kb[KeyboardKey::kP] == ButtonState::Falling)
-    lightProps.usePerspectiveM = !lightProps.usePerspectiveM;
+  if (kb[KeyboardKey::kG] == ButtonState::Falling)
+    dumpRenderGraph = true;
+}
+
+void WorldRenderer::updateRenderScale()
+{
+  if (!dynamicResolution)
+    return;
+
+  const auto frame = gpuProfiler.getResolvedFrame();
+  if (!frame.has_value() || frame == lastScaledFrame)
+    return;
+  lastScaledFrame = frame;
+
+  const auto scopes = gpuProfiler.getScopeStats();
+  const auto frameScope = std::ranges::find(scopes, "frame", &GpuProfiler::ScopeStats::name);
+  if (frameScope == scopes.end() || frameScope->lastMs <= 0)
+    return;
+
+  // Most of the frame is spent on per-pixel work, which scales with the area,
+  // i.e. with the square of the scale
+  const float frameMs = static_cast<float>(frameScope->lastMs);
+  const float estimate = renderScale * std::sqrt(targetFrameMs / frameMs);
+  const float next = std::clamp(
+    glm::mix(renderScale, estimate, RENDER_SCALE_DAMPING), MIN_RENDER_SCALE, 1.0f);
+  if (std::abs(next - renderScale) >= RENDER_SCALE_THRESHOLD || next == 1.0f)
+    renderScale = next;
 }
 
 void WorldRenderer::update(const FramePacket& packet)
 {
   ZoneScoped;
+  TRACE_CPU_SCOPE("update");
+
+  updateRenderScale();
+  renderExtent = glm::max(
+    glm::uvec2(glm::round(glm::vec2(resolution) * renderScale)), glm::uvec2(1));
+  upscaleParams.sourceUvScale = glm::vec2(renderExtent) / glm::vec2(resolution);
+  upscaleParams.sourceSize = glm::vec2(resolution);
 
   // calc camera matrix
   {
     const float aspect = float(resolution.x) / float(resolution.y);
-    worldViewProj = packet.mainCam.projTm(aspect) * packet.mainCam.viewTm();
-  }
 
-  // calc light matrix
-  {
-    const auto mProj = lightProps.usePerspectiveM
-      ? glm::perspectiveLH_ZO(
-          -glm::radians(packet.shadowCam.fov), 1.0f, 1.0f, lightProps.lightTargetDist * 2.0f)
-      : glm::orthoLH_ZO(
-          +lightProps.radius,
-          -lightProps.radius,
-          +lightProps.radius,
-          -lightProps.radius,
-          0.0f,
-          lightProps.lightTargetDist);
+    // Every frame of a TAA cycle samples pixels at a different subpixel offset
+    glm::vec2 jitter{0.0f};
+    if (antiAliasing == AntiAliasing::Taa)
+    {
+      taaFrame = (taaFrame + 1) % TAA_JITTER_SAMPLES;
+      const glm::vec2 offset{halton(taaFrame + 1, 2) - 0.5f, halton(taaFrame + 1, 3) - 0.5f};
+      jitter = 2.0f * offset / glm::vec2(renderExtent);
+    }
+
+    const glm::mat4x4 proj = packet.mainCam.projTm(aspect, jitter);
+    worldViewProj = proj * packet.mainCam.viewTm();
+    uniformParams.invProjView = glm::inverse(worldViewProj);
 
-    lightMatrix = mProj * packet.shadowCam.viewTm();
+    const glm::mat4x4 unjitteredViewProj = packet.mainCam.projTm(aspect) * packet.mainCam.viewTm();
+    taaParams.invViewProj = uniformParams.invProjView;
+    taaParams.prevViewProj = prevViewProj.value_or(unjitteredViewProj);
+    taaParams.resolution = glm::vec2(renderExtent);
+    taaParams.feedback = taaFeedback;
+    taaParams.depthTolerance = 0.05f;
+    taaParams.historyUvScale = glm::vec2(historyExtent) / glm::vec2(resolution);
+    historyExtent = renderExtent;
+    taaParams.resetHistory = taaHistoryValid && prevViewProj.has_value() ? 0 : 1;
+    prevViewProj = unjitteredViewProj;
+    // Whatever is rendered this frame is history for the next one, unless TAA is off
+    taaHistoryValid = antiAliasing == AntiAliasing::Taa;
 
-    lightPos = packet.shadowCam.position;
+    clusterParams.view = packet.mainCam.viewTm();
+    clusterParams.invProj = glm::inverse(proj);
+    clusterParams.screenSize = glm::vec2(renderExtent);
+    clusterParams.zNear = packet.mainCam.zNear;
+    clusterParams.zFar =
+      std::max(std::min(packet.mainCam.zFar, CLUSTER_FAR_PLANE), 2 * packet.mainCam.zNear);
+    clusterParams.lightCount = static_cast<std::uint32_t>(clusteredLights.size());
   }
 
-  // Upload everything to GPU-mapped memory
+  updateCascades(packet.mainCam, packet.shadowCam);
+  lightPos = packet.shadowCam.position;
+
+  // Uploaded in renderWorld, once the GPU is done with this frame's part of the upload ring
   {
-    uniformParams.lightMatrix = lightMatrix;
+    for (std::uint32_t i = 0; i < cascadeCount; ++i)
+      uniformParams.cascadeMatrices[i] = cascades[i].lightMatrix;
+    uniformParams.cascadeCount = cascadeCount;
     uniformParams.lightPos = lightPos;
     uniformParams.time = packet.currentTime;
+  }
+
+  {
+    // Exponential decay keeps adaptation speed independent of the framerate
+    const float dt = prevTime < 0 ? 0.0f : packet.currentTime - prevTime;
+    prevTime = packet.currentTime;
+
+    exposureParams.resolution = resolution;
+    exposureParams.minLogLuminance = MIN_LOG_LUMINANCE;
+    exposureParams.logLuminanceRange = MAX_LOG_LUMINANCE - MIN_LOG_LUMINANCE;
+    exposureParams.adaptationBlend = 1.0f - std::exp(-dt * adaptationSpeed);
+    exposureParams.exposureCompensation = exposureCompensation;
+  }
+
+  // Depth-only passes only need the cheapest variant
+  shadowPipelineId = requestPipeline(PipelineKind::Shadow, 0);
+  if (useDepthPrepass)
+    prepassPipelineId = requestPipeline(PipelineKind::DepthPrepass, 0);
+  if (useDeferred)
+  {
+    gbufferPipelineId =
+      requestPipeline(PipelineKind::GBuffer, FEATURE_SURFACE, useDepthPrepass);
+    deferredLightingPipelineId =
+      requestPipeline(PipelineKind::DeferredLighting, getLightingFeatures());
+  }
+  else
+    forwardPipelineId =
+      requestPipeline(PipelineKind::Forward, getLightingFeatures(), useDepthPrepass);
+
+  // Costs of static redraws are picked up whenever they show up in resolved timings
+  for (const auto& scope : gpuProfiler.getScopeStats())
+  {
+    const auto it = std::ranges::find(CASCADE_STATIC_SCOPES, scope.name);
+    if (it != CASCADE_STATIC_SCOPES.end())
+      cascades[std::distance(CASCADE_STATIC_SCOPES.begin(), it)].staticRenderMs = scope.lastMs;
+  }
+
+  for (std::uint32_t i = 0; i < cascadeCount; ++i)
+  {
+    auto& cascade = cascades[i];
 
-    std::memcpy(constants.data(), &uniformParams, sizeof(uniformParams));
+    // Snapping makes matrices of a cascade that did not move by a whole texel sideways,
+    // or by its radius along the light, bit-exact
+    cascade.redrawStatic = !useShadowCache || cascade.cachedLightMatrix != cascade.lightMatrix;
+    if (cascade.redrawStatic)
+      buildRenderQueue(
+        cascade.staticQueue, shadowPipelineId, cascade.lightMatrix, InstanceFilter::Static);
+    buildRenderQueue(
+      cascade.dynamicQueue, shadowPipelineId, cascade.lightMatrix, InstanceFilter::Dynamic);
   }
+
+  updateSpotLights(packet.mainCam);
+
+  buildRenderQueue(
+    mainViewQueue, useDeferred ? gbufferPipelineId : forwardPipelineId, worldViewProj);
+  if (useDepthPrepass)
+    buildRenderQueue(prepassQueue, prepassPipelineId, worldViewProj);
 }
 
-void WorldRenderer::renderScene(
-  vk::CommandBuffer cmd_buf, const glm::mat4x4& glob_tm, vk::PipelineLayout pipeline_layout)
+void WorldRenderer::updateCascades(const Camera& main_cam, const Camera& light_cam)
 {
-  if (!sceneMgr->getVertexBuffer())
-    return;
+  cascadeCount = static_cast<std::uint32_t>(
+    std::clamp(cascadeSettings.count, 1, static_cast<int>(MAX_SHADOW_CASCADES)));
 
-  cmd_buf.bindVertexBuffers(0, {sceneMgr->getVertexBuffer()}, {0});
-  cmd_buf.bindIndexBuffer(sceneMgr->getIndexBuffer(), 0, vk::IndexType::eUint32);
+  const float aspect = float(resolution.x) / float(resolution.y);
+  const float nearPlane = main_cam.zNear;
+  const float farPlane = std::max(std::min(main_cam.zFar, cascadeSettings.maxDistance), nearPlane);
 
-  pushConst2M.projView = glob_tm;
+  // Distance from the view axis to the corners of a slice grows linearly with depth
+  const float tanHalfFov = std::tan(glm::radians(main_cam.fov) * 0.5f);
+  const float cornerSlope = tanHalfFov * std::sqrt(1.0f + aspect * aspect);
+
+  const glm::mat4x4 lightView = light_cam.viewTm();
+
+  // Casters between the light and a cascade must not be clipped away by its near plane
+  const BoundingBox sceneLightSpace = sceneBounds.transformed(lightView);
+
+  float sliceNear = nearPlane;
+  for (std::uint32_t i = 0; i < cascadeCount; ++i)
+  {
+    const float t = float(i + 1) / float(cascadeCount);
+    const float uniformSplit = nearPlane + (farPlane - nearPlane) * t;
+    const float logSplit = nearPlane * std::pow(farPlane / nearPlane, t);
+    const float sliceFar = glm::mix(uniformSplit, logSplit, cascadeSettings.splitLambda);
+
+    // The bounding sphere of a slice does not depend on the camera orientation, so the
+    // cascade keeps its size and its texels keep their world space size while turning around.
+    // The center is equidistant from the near and far corners unless it ends up beyond the
+    // far plane, in which case the far corners alone define the sphere.
+    const float nearCorner = sliceNear * cornerSlope;
+    const float farCorner = sliceFar * cornerSlope;
+    const float centerDist = std::min(
+      (sliceNear + sliceFar) * 0.5f +
+        (farCorner * farCorner - nearCorner * nearCorner) /
+          (2.0f * std::max(sliceFar - sliceNear, 1e-4f)),
+      sliceFar);
+    float radius = std::max(
+      glm::length(glm::vec2(sliceFar - centerDist, farCorner)),
+      glm::length(glm::vec2(centerDist - sliceNear, nearCorner)));
+    // Float noise in the radius would change the texel size from frame to frame
+    radius = std::ceil(radius * 16.0f) / 16.0f;
+
+    const glm::vec3 center = main_cam.position + main_cam.forward() * centerDist;
+    glm::vec3 lightSpaceCenter = glm::vec3(lightView * glm::vec4(center, 1.0f));
+
+    // Moving the cascade by whole texels only keeps the rasterization of static geometry
+    // exactly the same, which is what stops shadow edges from shimmering
+    const float texelSize = 2.0f * radius / float(SHADOW_MAP_SIZE);
+    lightSpaceCenter.x = std::floor(lightSpaceCenter.x / texelSize) * texelSize;
+    lightSpaceCenter.y = std::floor(lightSpaceCenter.y / texelSize) * texelSize;
+
+    // Depth is snapped too, but coarsely, as it doesn't affect the rasterization. Otherwise
+    // any movement along the light direction would change the matrix and miss the shadow cache.
+    // The snapped range still contains the whole sphere.
+    const float depthCenter = std::floor(lightSpaceCenter.z / radius) * radius;
+    const float depthNear = std::min(sceneLightSpace.min.z, depthCenter - radius);
+    const float depthFar = depthCenter + 2.0f * radius;
+
+    const auto mProj = glm::orthoLH_ZO(
+      lightSpaceCenter.x + radius,
+      lightSpaceCenter.x - radius,
+      lightSpaceCenter.y + radius,
+      lightSpaceCenter.y - radius,
+      depthNear,
+      depthFar);
+
+    cascades[i].lightMatrix = mProj * lightView;
+    cascades[i].splitFar = sliceFar;
+
+    sliceNear = sliceFar;
+  }
+}
+
+const etna::GraphicsPipeline& WorldRenderer::getPipeline(std::uint32_t id) const
+{
+  ETNA_VERIFYF(id < pipelines.size(), "Unknown pipeline id {}", id);
+  return pipelines[id].pipeline;
+}
+
+void WorldRenderer::buildRenderQueue(
+  RenderQueue& queue,
+  std::uint32_t pipeline_id,
+  const glm::mat4x4& glob_tm,
+  InstanceFilter filter)
+{
+  ZoneScoped;
+  TRACE_CPU_SCOPE("buildRenderQueue");
+
+  queue.clear();
 
   auto instanceMeshes = sceneMgr->getInstanceMeshes();
   auto instanceMatrices = sceneMgr->getInstanceMatrices();
 
   auto meshes = sceneMgr->getMeshes();
+
+  for (std::uint32_t instIdx = 0; instIdx < instanceMeshes.size(); ++instIdx)
+  {
+    if (filter != InstanceFilter::All && instIdx < instanceDynamic.size() &&
+        instanceDynamic[instIdx] != (filter == InstanceFilter::Dynamic))
+      continue;
+
+    if (instIdx < instanceBounds.size() && !is_box_visible(instanceBounds[instIdx], glob_tm))
+      continue;
+
+    // NOTE: the instance origin is a crude approximation of its depth,
+    // bounding box centers would be better.
+    const glm::vec4 clipPos = glob_tm * instanceMatrices[instIdx][3];
+    const float depth = clipPos.w > 0 ? clipPos.z / clipPos.w : 0.0f;
+
+    // There are no materials yet, so everything uses material 0
+    const auto& mesh = meshes[instanceMeshes[instIdx]];
+    for (std::uint32_t j = 0; j < mesh.relemCount; ++j)
+    {
+      const std::uint32_t relemIdx = mesh.firstRelem + j;
+      queue.push(RenderQueue::make_key(pipeline_id, 0, relemIdx, depth), instIdx, relemIdx);
+    }
+  }
+
+  queue.sort(&threadPool);
+}
+
+void WorldRenderer::recordSecondaries(std::span<SecondaryPass* const> passes)
+{
+  ZoneScoped;
+  TRACE_CPU_SCOPE("recordSecondaries");
+
+  struct Chunk
+  {
+    SecondaryPass* pass;
+    std::size_t index;
+    std::size_t firstCommand;
+    std::size_t commandCount;
+  };
+
+  std::vector<Chunk> chunks;
+  for (auto* pass : passes)
+  {
+    const std::size_t commandCount = pass->queue->getCommands().size();
+    const std::size_t chunkCount = std::clamp<std::size_t>(
+      (commandCount + MIN_DRAWS_PER_CHUNK - 1) / MIN_DRAWS_PER_CHUNK, 1, threadPool.concurrency());
+
+    pass->chunks.resize(chunkCount);
+    for (std::size_t i = 0; i < chunkCount; ++i)
+    {
+      const std::size_t first = commandCount * i / chunkCount;
+      const std::size_t last = commandCount * (i + 1) / chunkCount;
+      chunks.push_back(Chunk{pass, i, first, last - first});
+    }
+  }
+
+  // Every chunk counts its own stats to avoid contention, they are summed up afterwards
+  std::vector<RenderStats> chunkStats(chunks.size());
+
+  threadPool.parallelFor(chunks.size(), [&](std::size_t i) {
+    ZoneScopedN("recordChunk");
+    TRACE_CPU_SCOPE("recordChunk");
+    ZoneValue(i);
+
+    const auto& chunk = chunks[i];
+    auto& pass = *chunk.pass;
+
+    auto cmdBuf = cmdRecorder.begin(pass.formats, pass.area);
+    renderScene(
+      cmdBuf,
+      *pass.queue,
+      chunk.firstCommand,
+      chunk.commandCount,
+      pass.globTm,
+      pass.materialSets,
+      chunkStats[i]);
+    ETNA_CHECK_VK_RESULT(cmdBuf.end());
+
+    pass.chunks[chunk.index] = cmdBuf;
+  });
+
+  for (const auto& chunk : chunkStats)
+  {
+    stats.drawCalls += chunk.drawCalls;
+    stats.instances += chunk.instances;
+    stats.pipelineBinds += chunk.pipelineBinds;
+    stats.descriptorBinds += chunk.descriptorBinds;
+    stats.triangles += chunk.triangles;
+  }
+}
+
+void WorldRenderer::renderScene(
+  vk::CommandBuffer cmd_buf,
+  const RenderQueue& queue,
+  std::size_t first_command,
+  std::size_t command_count,
+  const glm::mat4x4& glob_tm,
+  std::span<const vk::DescriptorSet> material_sets,
+  RenderStats& out_stats) const
+{
+  if (!sceneMgr->getVertexBuffer() || command_count == 0)
+    return;
+
+  // NOTE: nothing is inherited by secondary command buffers, so everything is bound anew.
+  // Vertex streams depend on the pipeline, so they are bound together with it.
+  cmd_buf.bindIndexBuffer(sceneMgr->getIndexBuffer(), 0, vk::IndexType::eUint32);
+
+  const PushConstants pushConstants{.projView = glob_tm};
+
   auto relems = sceneMgr->getRenderElements();
+  auto commands = queue.getCommands();
+
+  const std::size_t lastCommand = first_command + command_count;
+
+  constexpr std::uint32_t NONE = ~std::uint32_t{0};
+  std::uint32_t boundPipeline = NONE;
+  std::uint32_t boundMaterial = NONE;
+  vk::Buffer boundVertexBuffer;
 
-  for (std::size_t instIdx = 0; instIdx < instanceMeshes.size(); ++instIdx)
+  for (const auto& batch : queue.getBatches())
   {
-    pushConst2M.model = instanceMatrices[instIdx];
+    const std::size_t first = std::max<std::size_t>(batch.firstCommand, first_command);
+    const std::size_t last =
+      std::min<std::size_t>(batch.firstCommand + batch.commandCount, lastCommand);
+    if (first >= last)
+      continue;
 
-    cmd_buf.pushConstants<PushConstants>(
-      pipeline_layout, vk::ShaderStageFlagBits::eVertex, 0, {pushConst2M});
+    const auto& pipeline = getPipeline(batch.pipeline);
+    const auto layout = pipeline.getVkPipelineLayout();
 
-    const auto meshIdx = instanceMeshes[instIdx];
+    if (batch.pipeline != boundPipeline)
+    {
+      cmd_buf.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline.getVkPipeline());
+      // Conservatively assume that a new pipeline disturbs everything
+      cmd_buf.pushConstants<PushConstants>(
+        layout, vk::ShaderStageFlagBits::eVertex, 0, {pushConstants});
+      boundPipeline = batch.pipeline;
+      boundMaterial = NONE;
+      ++out_stats.pipelineBinds;
+
+      const vk::Buffer vertexBuffer = pipelines[batch.pipeline].positionOnly
+        ? sceneMgr->getPositionBuffer()
+        : sceneMgr->getVertexBuffer();
+      if (vertexBuffer != boundVertexBuffer)
+      {
+        cmd_buf.bindVertexBuffers(0, {vertexBuffer}, {0});
+        boundVertexBuffer = vertexBuffer;
+      }
+    }
+
+    if (batch.material != boundMaterial && batch.material < material_sets.size())
+    {
+      cmd_buf.bindDescriptorSets(
+        vk::PipelineBindPoint::eGraphics, layout, 0, {material_sets[batch.material]}, {});
+      boundMaterial = batch.material;
+      ++out_stats.descriptorBinds;
+    }
 
-    for (std::size_t j = 0; j < meshes[meshIdx].relemCount; ++j)
+    for (const auto& command : commands.subspan(first, last - first))
     {
-      const auto relemIdx = meshes[meshIdx].firstRelem + j;
-      const auto& relem = relems[relemIdx];
-      cmd_buf.drawIndexed(relem.indexCount, 1, relem.indexOffset, relem.vertexOffset, 0);
+      // Per-instance data is fetched by the vertex shader with gl_InstanceIndex
+      const auto& relem = relems[command.relemIdx];
+      cmd_buf.drawIndexed(
+        relem.indexCount, 1, relem.indexOffset, relem.vertexOffset, command.instanceIdx);
+      ++out_stats.drawCalls;
+      ++out_stats.instances;
+      out_stats.triangles += relem.indexCount / 3;
     }
   }
 }
 
+void WorldRenderer::drawFullscreen(
+  vk::CommandBuffer cmd_buf,
+  vk::ImageView target,
+  vk::Extent2D extent,
+  const etna::GraphicsPipeline& pipeline,
+  vk::DescriptorSet set)
+{
+  // Every pixel is written, so there is nothing to load or clear
+  const vk::RenderingAttachmentInfo colorAttachment{
+    .imageView = target,
+    .imageLayout = vk::ImageLayout::eColorAttachmentOptimal,
+    .loadOp = vk::AttachmentLoadOp::eDontCare,
+    .storeOp = vk::AttachmentStoreOp::eStore,
+  };
+  const vk::Rect2D area{{0, 0}, extent};
+  cmd_buf.beginRendering(vk::RenderingInfo{
+    .renderArea = area,
+    .layerCount = 1,
+    .colorAttachmentCount = 1,
+    .pColorAttachments = &colorAttachment,
+  });
+
+  cmd_buf.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline.getVkPipeline());
+  cmd_buf.setViewport(
+    0,
+    {vk::Viewport{
+      .x = 0.0f,
+      .y = 0.0f,
+      .width = static_cast<float>(extent.width),
+      .height = static_cast<float>(extent.height),
+      .minDepth = 0.0f,
+      .maxDepth = 1.0f,
+    }});
+  cmd_buf.setScissor(0, {area});
+  cmd_buf.bindDescriptorSets(
+    vk::PipelineBindPoint::eGraphics, pipeline.getVkPipelineLayout(), 0, {set}, {});
+  cmd_buf.draw(3, 1, 0, 0);
+  ++stats.drawCalls;
+
+  cmd_buf.endRendering();
+}
+
 void WorldRenderer::renderWorld(
   vk::CommandBuffer cmd_buf, vk::Image target_image, vk::ImageView target_image_view)
 {
   ETNA_PROFILE_GPU(cmd_buf, renderWorld);
+  TRACE_CPU_SCOPE("renderWorld");
+
+  prevFrameStats = std::exchange(stats, {});
 
-  // draw scene to shadowmap
+  uploadRing.beginFrame();
+  const auto constants = uploadRing.push(uniformParams);
+  const auto spotLightConstants = uploadRing.push(spotLightTable);
+  const auto clusterConstants = uploadRing.push(clusterParams);
+  const auto exposureConstants = uploadRing.push(exposureParams);
+  const auto taaConstants = uploadRing.push(taaParams);
+  const auto upscaleConstants = uploadRing.push(upscaleParams);
+  // Empty storage buffer bindings are not allowed, hence at least one light
+  const auto clusterLightData = uploadRing.allocate(
+    std::max<std::size_t>(clusteredLights.size(), 1) * sizeof(ClusteredLight));
+  std::memcpy(
+    clusterLightData.data, clusteredLights.data(), clusteredLights.size() * sizeof(ClusteredLight));
+  stats.bytesUploaded = uploadRing.getFrameUsage();
 
+  // Scene draws are recorded on worker threads ahead of graph execution,
+  // graph passes merely execute the resulting secondary command buffers.
+  std::array<SecondaryPass, MAX_SHADOW_CASCADES> staticPasses;
+  std::array<SecondaryPass, MAX_SHADOW_CASCADES> dynamicPasses;
+  bool anyStaticRedraws = false;
+  bool anyDynamicDraws = false;
+  for (std::uint32_t i = 0; i < cascadeCount; ++i)
   {
-    ETNA_PROFILE_GPU(cmd_buf, renderShadowMap);
+    const SecondaryPass cascadePass{
+      .queue = nullptr,
+      .globTm = cascades[i].lightMatrix,
+      .materialSets = {},
+      .formats = {.colorFormats = {}, .depthFormat = vk::Format::eD16Unorm},
+      .area = {{0, 0}, {SHADOW_MAP_SIZE, SHADOW_MAP_SIZE}},
+      .chunks = {},
+    };
+    staticPasses[i] = cascadePass;
+    staticPasses[i].queue = &cascades[i].staticQueue;
+    dynamicPasses[i] = cascadePass;
+    dynamicPasses[i].queue = &cascades[i].dynamicQueue;
 
-    etna::RenderTargetState renderTargets(
-      cmd_buf,
-      {{0, 0}, {2048, 2048}},
-      {},
-      {.image = shadowMap.get(), .view = shadowMap.getView({})});
+    anyStaticRedraws = anyStaticRedraws || cascades[i].redrawStatic;
+    anyDynamicDraws = anyDynamicDraws || !cascades[i].dynamicQueue.getCommands().empty();
+  }
+  std::vector<SecondaryPass> atlasPasses;
+  atlasPasses.reserve(atlasUpdates.size());
+  for (auto idx : atlasUpdates)
+  {
+    const auto& tile = *spotLights[idx].tile;
+    atlasPasses.push_back(SecondaryPass{
+      .queue = &spotLights[idx].queue,
+      .globTm = spotLights[idx].viewProj,
+      .materialSets = {},
+      .formats = {.colorFormats = {}, .depthFormat = vk::Format::eD16Unorm},
+      .area =
+        {{static_cast<std::int32_t>(tile.offset.x), static_cast<std::int32_t>(tile.offset.y)},
+         {tile.size, tile.size}},
+      .chunks = {},
+    });
+  }
+  SecondaryPass prepassPass{
+    .queue = &prepassQueue,
+    .globTm = worldViewProj,
+    .materialSets = {},
+    .formats = {.colorFormats = {}, .depthFormat = vk::Format::eD32Sfloat},
+    .area = {{0, 0}, {renderExtent.x, renderExtent.y}},
+    .chunks = {},
+  };
+  SecondaryPass mainViewPass{
+    .queue = &mainViewQueue,
+    .globTm = worldViewProj,
+    .materialSets = {},
+    .formats =
+      {
+        .colorFormats = useDeferred
+          ? std::vector{GBUFFER_NORMAL_FORMAT, GBUFFER_ALBEDO_FORMAT}
+          : std::vector{HDR_FORMAT},
+        .depthFormat = vk::Format::eD32Sfloat,
+      },
+    .area = {{0, 0}, {renderExtent.x, renderExtent.y}},
+    .chunks = {},
+  };
+
+  renderGraph.reset();
+
+  const auto backbuffer = renderGraph.importImage(
+    "backbuffer",
+    target_image,
+    target_image_view,
+    {.extent = {resolution.x, resolution.y, 1}, .format = targetFormat});
+  renderGraph.markOutput(backbuffer);
 
-    cmd_buf.bindPipeline(vk::PipelineBindPoint::eGraphics, shadowPipeline.getVkPipeline());
-    renderScene(cmd_buf, lightMatrix, shadowPipeline.getVkPipelineLayout());
+  // bin clustered lights into the froxel grid of the main view
+
+  auto clusterSet = etna::create_descriptor_set(
+    etna::get_shader_program("light_clusters").getDescriptorLayoutId(0),
+    cmd_buf,
+    {etna::Binding{0, uploadRing.genBinding(clusterConstants)},
+     etna::Binding{1, uploadRing.genBinding(clusterLightData)},
+     etna::Binding{2, clusterGrid.genBinding()},
+     etna::Binding{3, clusterLightIndices.genBinding()}},
+    etna::BarrierBehavoir::eSuppressBarriers);
+
+  // Nothing here depends on shadows, so light assignment overlaps with shadow rendering.
+  // The graph makes lighting passes wait for the lists, barriers against the previous frame
+  // are issued by hand.
+  const auto clusterGridBuffer = renderGraph.importBuffer("cluster_grid", clusterGrid);
+  const auto clusterIndicesBuffer =
+    renderGraph.importBuffer("cluster_light_indices", clusterLightIndices);
+  renderGraph.addPass(
+    "light_clusters",
+    [&](RenderGraph::PassBuilder& builder) {
+      builder.write(clusterGridBuffer, RenderGraph::Access::StorageInCompute);
+      builder.write(clusterIndicesBuffer, RenderGraph::Access::StorageInCompute);
+      builder.useAsyncCompute();
+    },
+    [&](vk::CommandBuffer cmd, const RenderGraph::PassResources&) {
+      ETNA_PROFILE_GPU(cmd, buildLightClusters);
+
+      // Previous frame's passes may still be using the lists
+      const vk::MemoryBarrier2 readToClear{
+        .srcStageMask =
+          vk::PipelineStageFlagBits2::eFragmentShader | vk::PipelineStageFlagBits2::eComputeShader,
+        .srcAccessMask =
+          vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite,
+        .dstStageMask = vk::PipelineStageFlagBits2::eTransfer,
+        .dstAccessMask = vk::AccessFlagBits2::eTransferWrite,
+      };
+      cmd.pipelineBarrier2(vk::DependencyInfo{
+        .memoryBarrierCount = 1,
+        .pMemoryBarriers = &readToClear,
+      });
+
+      // Reset the light index counter
+      cmd.fillBuffer(clusterLightIndices.get(), 0, sizeof(std::uint32_t), 0);
+
+      // Fragment stage is here so that the grid isn't overwritten while still being read
+      const vk::MemoryBarrier2 clearToBuild{
+        .srcStageMask =
+          vk::PipelineStageFlagBits2::eTransfer | vk::PipelineStageFlagBits2::eFragmentShader,
+        .srcAccessMask = vk::AccessFlagBits2::eTransferWrite,
+        .dstStageMask = vk::PipelineStageFlagBits2::eComputeShader,
+        .dstAccessMask =
+          vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite,
+      };
+      cmd.pipelineBarrier2(vk::DependencyInfo{
+        .memoryBarrierCount = 1,
+        .pMemoryBarriers = &clearToBuild,
+      });
+
+      const auto vkSet = clusterSet.getVkSet();
+      cmd.bindPipeline(vk::PipelineBindPoint::eCompute, clusterPipeline.getVkPipeline());
+      cmd.bindDescriptorSets(
+        vk::PipelineBindPoint::eCompute,
+        clusterPipeline.getVkPipelineLayout(),
+        0,
+        1,
+        &vkSet,
+        0,
+        nullptr);
+      cmd.dispatch((CLUSTER_COUNT + CLUSTER_WORKGROUP_SIZE - 1) / CLUSTER_WORKGROUP_SIZE, 1, 1);
+    });
+
+  // Static geometry is drawn into the cache, only for cascades that moved since last time
+
+  const auto cache = renderGraph.importImage("shadow_cache", shadowCache);
+  // Contents of the cache are needed by future frames, whether this frame reads them or not
+  renderGraph.markOutput(cache);
+
+  if (anyStaticRedraws)
+    renderGraph.addPass(
+      "shadow_cache",
+      [&](RenderGraph::PassBuilder& builder) {
+        // Layers of cascades which are still valid are kept as is
+        builder.modify(cache, RenderGraph::Access::DepthAttachment);
+      },
+      [&](vk::CommandBuffer cmd, const RenderGraph::PassResources& res) {
+        ETNA_PROFILE_GPU(cmd, renderShadowCache);
+
+        // Layers are disjoint, so no barriers are needed between cascades
+        for (std::uint32_t i = 0; i < cascadeCount; ++i)
+        {
+          if (!cascades[i].redrawStatic)
+            continue;
+
+          GpuProfiler::Scope scope{gpuProfiler, cmd, CASCADE_STATIC_SCOPES[i]};
+
+          SecondaryCmdRecorder::begin_rendering(
+            cmd,
+            staticPasses[i].area,
+            {},
+            SecondaryCmdRecorder::Attachment{
+              .view = res.getImage(cache).getView({.baseLayer = i, .layerCount = 1}),
+              .layout = vk::ImageLayout::eDepthStencilAttachmentOptimal,
+              .clearValue = vk::ClearDepthStencilValue{1.0f, 0},
+            });
+          cmd.executeCommands(staticPasses[i].chunks);
+          cmd.endRendering();
+        }
+      });
+
+  for (std::uint32_t i = 0; i < cascadeCount; ++i)
+    if (cascades[i].redrawStatic)
+      cascades[i].cachedLightMatrix = useShadowCache
+        ? std::optional{cascades[i].lightMatrix}
+        : std::nullopt;
+
+  // Dynamic geometry is composited on top of a copy of the cache,
+  // without any the cache itself is sampled
+
+  auto shadowMap = cache;
+  if (anyDynamicDraws)
+  {
+    renderGraph.addPass(
+      "shadow_copy",
+      [&](RenderGraph::PassBuilder& builder) {
+        // Always the maximum number of layers, so that the image stays an array image with
+        // a single cascade and changing the cascade count doesn't reallocate it
+        shadowMap = builder.create(
+          "shadow_map",
+          {
+            .extent = {SHADOW_MAP_SIZE, SHADOW_MAP_SIZE, 1},
+            .format = vk::Format::eD16Unorm,
+            .layers = MAX_SHADOW_CASCADES,
+          });
+        builder.read(cache, RenderGraph::Access::TransferSrc);
+        builder.write(shadowMap, RenderGraph::Access::TransferDst);
+      },
+      [&](vk::CommandBuffer cmd, const RenderGraph::PassResources& res) {
+        const vk::ImageSubresourceLayers layers{
+          .aspectMask = vk::ImageAspectFlagBits::eDepth,
+          .mipLevel = 0,
+          .baseArrayLayer = 0,
+          .layerCount = cascadeCount,
+        };
+        cmd.copyImage(
+          res.getVkImage(cache),
+          vk::ImageLayout::eTransferSrcOptimal,
+          res.getVkImage(shadowMap),
+          vk::ImageLayout::eTransferDstOptimal,
+          {vk::ImageCopy{
+            .srcSubresource = layers,
+            .srcOffset = {0, 0, 0},
+            .dstSubresource = layers,
+            .dstOffset = {0, 0, 0},
+            .extent = {SHADOW_MAP_SIZE, SHADOW_MAP_SIZE, 1},
+          }});
+      });
+
+    renderGraph.addPass(
+      "shadow_dynamic",
+      [&](RenderGraph::PassBuilder& builder) {
+        builder.modify(shadowMap, RenderGraph::Access::DepthAttachment);
+      },
+      [&](vk::CommandBuffer cmd, const RenderGraph::PassResources& res) {
+        ETNA_PROFILE_GPU(cmd, renderShadowDynamic);
+
+        for (std::uint32_t i = 0; i < cascadeCount; ++i)
+        {
+          if (cascades[i].dynamicQueue.getCommands().empty())
+            continue;
+
+          GpuProfiler::Scope scope{gpuProfiler, cmd, CASCADE_DYNAMIC_SCOPES[i]};
+
+          SecondaryCmdRecorder::begin_rendering(
+            cmd,
+            dynamicPasses[i].area,
+            {},
+            SecondaryCmdRecorder::Attachment{
+              .view = res.getImage(shadowMap).getView({.baseLayer = i, .layerCount = 1}),
+              .layout = vk::ImageLayout::eDepthStencilAttachmentOptimal,
+              .loadOp = vk::AttachmentLoadOp::eLoad,
+            });
+          cmd.executeCommands(dynamicPasses[i].chunks);
+          cmd.endRendering();
+        }
+      });
   }
 
+  // draw spot light shadows into their atlas tiles, the rest of the atlas is left as is
+
+  const auto atlas = renderGraph.importImage("shadow_atlas", shadowAtlasImage);
+  renderGraph.markOutput(atlas);
+
+  if (!atlasPasses.empty())
+    renderGraph.addPass(
+      "shadow_atlas",
+      [&](RenderGraph::PassBuilder& builder) {
+        builder.modify(atlas, RenderGraph::Access::DepthAttachment);
+      },
+      [&](vk::CommandBuffer cmd, const RenderGraph::PassResources& res) {
+        ETNA_PROFILE_GPU(cmd, renderShadowAtlas);
+
+        // Clears only touch the render area, i.e. the tile
+        for (const auto& pass : atlasPasses)
+        {
+          SecondaryCmdRecorder::begin_rendering(
+            cmd,
+            pass.area,
+            {},
+            SecondaryCmdRecorder::Attachment{
+              .view = res.getView(atlas),
+              .layout = vk::ImageLayout::eDepthStencilAttachmentOptimal,
+              .clearValue = vk::ClearDepthStencilValue{1.0f, 0},
+            });
+          cmd.executeCommands(pass.chunks);
+          cmd.endRendering();
+        }
+      });
+
   // draw final scene to screen
 
+  auto depth = RenderGraph::ResourceId::Invalid;
+  auto gbufferNormal = RenderGraph::ResourceId::Invalid;
+  auto gbufferAlbedo = RenderGraph::ResourceId::Invalid;
+  auto hdr = RenderGraph::ResourceId::Invalid;
+  // Created after graph compilation, but before execution
+  vk::DescriptorSet deferredLightingSet;
+  vk::DescriptorSet histogramSet;
+  vk::DescriptorSet exposureSet;
+  vk::DescriptorSet tonemapSet;
+  vk::DescriptorSet taaSet;
+  vk::DescriptorSet fxaaSet;
+  vk::DescriptorSet upscaleSet;
+  auto taaPrevHistory = RenderGraph::ResourceId::Invalid;
+
+  // With a prepass the color pass merely tests against its depth, otherwise it fills depth itself
+  auto setupMainViewDepth = [&](RenderGraph::PassBuilder& builder) {
+    if (useDepthPrepass)
+    {
+      builder.read(depth, RenderGraph::Access::DepthAttachmentReadOnly);
+      return;
+    }
+    depth = builder.create(
+      "main_view_depth",
+      {.extent = {resolution.x, resolution.y, 1}, .format = vk::Format::eD32Sfloat});
+    builder.write(depth, RenderGraph::Access::DepthAttachment);
+  };
+  auto mainViewDepthAttachment = [&](const RenderGraph::PassResources& res) {
+    return SecondaryCmdRecorder::Attachment{
+      .view = res.getView(depth),
+      .layout = vk::ImageLayout::eDepthStencilAttachmentOptimal,
+      .loadOp = useDepthPrepass ? vk::AttachmentLoadOp::eLoad : vk::AttachmentLoadOp::eClear,
+      .clearValue = vk::ClearDepthStencilValue{1.0f, 0},
+    };
+  };
+
+  if (useDepthPrepass)
+    renderGraph.addPass(
+      "depth_prepass",
+      [&](RenderGraph::PassBuilder& builder) {
+        depth = builder.create(
+          "main_view_depth",
+          {.extent = {resolution.x, resolution.y, 1}, .format = vk::Format::eD32Sfloat});
+        builder.write(depth, RenderGraph::Access::DepthAttachment);
+      },
+      [&](vk::CommandBuffer cmd, const RenderGraph::PassResources& res) {
+        ETNA_PROFILE_GPU(cmd, renderDepthPrepass);
+
+        SecondaryCmdRecorder::begin_rendering(
+          cmd,
+          prepassPass.area,
+          {},
+          SecondaryCmdRecorder::Attachment{
+            .view = res.getView(depth),
+            .layout = vk::ImageLayout::eDepthStencilAttachmentOptimal,
+            .clearValue = vk::ClearDepthStencilValue{1.0f, 0},
+          });
+        cmd.executeCommands(prepassPass.chunks);
+        cmd.endRendering();
+      });
+
+  if (!useDeferred)
+    renderGraph.addPass(
+      "forward",
+      [&](RenderGraph::PassBuilder& builder) {
+        setupMainViewDepth(builder);
+        hdr = builder.create(
+          "hdr_color", {.extent = {resolution.x, resolution.y, 1}, .format = HDR_FORMAT});
+        builder.write(hdr, RenderGraph::Access::ColorAttachment);
+        builder.read(shadowMap, RenderGraph::Access::SampledInFragment);
+        builder.read(atlas, RenderGraph::Access::SampledInFragment);
+        builder.read(clusterGridBuffer, RenderGraph::Access::StorageInFragment);
+        builder.read(clusterIndicesBuffer, RenderGraph::Access::StorageInFragment);
+      },
+      [&](vk::CommandBuffer cmd, const RenderGraph::PassResources& res) {
+        ETNA_PROFILE_GPU(cmd, renderForward);
+
+        const std::array colorAttachments{SecondaryCmdRecorder::Attachment{
+          .view = res.getView(hdr),
+          .layout = vk::ImageLayout::eColorAttachmentOptimal,
+          .clearValue = vk::ClearColorValue{std::array{0.0f, 0.0f, 0.0f, 1.0f}},
+        }};
+        SecondaryCmdRecorder::begin_rendering(
+          cmd,
+          mainViewPass.area,
+          colorAttachments,
+          mainViewDepthAttachment(res));
+        cmd.executeCommands(mainViewPass.chunks);
+        cmd.endRendering();
+      });
+  else
+  {
+    renderGraph.addPass(
+      "gbuffer",
+      [&](RenderGraph::PassBuilder& builder) {
+        const vk::Extent3D extent{resolution.x, resolution.y, 1};
+        gbufferNormal =
+          builder.create("gbuffer_normal", {.extent = extent, .format = GBUFFER_NORMAL_FORMAT});
+        gbufferAlbedo =
+          builder.create("gbuffer_albedo", {.extent = extent, .format = GBUFFER_ALBEDO_FORMAT});
+        builder.write(gbufferNormal, RenderGraph::Access::ColorAttachment);
+        builder.write(gbufferAlbedo, RenderGraph::Access::ColorAttachment);
+        setupMainViewDepth(builder);
+      },
+      [&](vk::CommandBuffer cmd, const RenderGraph::PassResources& res) {
+        ETNA_PROFILE_GPU(cmd, renderGBuffer);
+
+        const std::array colorAttachments{
+          SecondaryCmdRecorder::Attachment{
+            .view = res.getView(gbufferNormal),
+            .layout = vk::ImageLayout::eColorAttachmentOptimal,
+          },
+          SecondaryCmdRecorder::Attachment{
+            .view = res.getView(gbufferAlbedo),
+            .layout = vk::ImageLayout::eColorAttachmentOptimal,
+          },
+        };
+        SecondaryCmdRecorder::begin_rendering(
+          cmd,
+          mainViewPass.area,
+          colorAttachments,
+          mainViewDepthAttachment(res));
+        cmd.executeCommands(mainViewPass.chunks);
+        cmd.endRendering();
+      });
+
+    renderGraph.addPass(
+      "deferred_lighting",
+      [&](RenderGraph::PassBuilder& builder) {
+        builder.read(gbufferNormal, RenderGraph::Access::SampledInFragment);
+        builder.read(gbufferAlbedo, RenderGraph::Access::SampledInFragment);
+        builder.read(depth, RenderGraph::Access::SampledInFragment);
+        builder.read(shadowMap, RenderGraph::Access::SampledInFragment);
+        builder.read(atlas, RenderGraph::Access::SampledInFragment);
+        builder.read(clusterGridBuffer, RenderGraph::Access::StorageInFragment);
+        builder.read(clusterIndicesBuffer, RenderGraph::Access::StorageInFragment);
+        hdr = builder.create(
+          "hdr_color", {.extent = {resolution.x, resolution.y, 1}, .format = HDR_FORMAT});
+        builder.write(hdr, RenderGraph::Access::ColorAttachment);
+      },
+      [&](vk::CommandBuffer cmd, const RenderGraph::PassResources& res) {
+        ETNA_PROFILE_GPU(cmd, renderDeferredLighting);
+        drawFullscreen(
+          cmd,
+          res.getView(hdr),
+          mainViewPass.area.extent,
+          getPipeline(deferredLightingPipelineId),
+          deferredLightingSet);
+      });
+  }
+
+  // accumulate jittered frames, FXAA happens after tonemapping instead
+  auto resolved = hdr;
+  if (antiAliasing == AntiAliasing::Taa)
   {
-    ETNA_PROFILE_GPU(cmd_buf, renderForward);
+    const auto prevHistory =
+      renderGraph.importImage("taa_history_prev", taaHistory[taaHistoryIndex ^ 1]);
+    const auto curHistory = renderGraph.importImage("taa_history", taaHistory[taaHistoryIndex]);
+    // Becomes the previous history of the next frame
+    renderGraph.markOutput(curHistory);
+
+    renderGraph.addPass(
+      "taa_resolve",
+      [&](RenderGraph::PassBuilder& builder) {
+        builder.read(hdr, RenderGraph::Access::SampledInFragment);
+        builder.read(depth, RenderGraph::Access::SampledInFragment);
+        builder.read(prevHistory, RenderGraph::Access::SampledInFragment);
+        builder.write(curHistory, RenderGraph::Access::ColorAttachment);
+      },
+      [&, curHistory](vk::CommandBuffer cmd, const RenderGraph::PassResources& res) {
+        ETNA_PROFILE_GPU(cmd, resolveTaa);
+        drawFullscreen(
+          cmd, res.getView(curHistory), mainViewPass.area.extent, taaPipeline, taaSet);
+      });
+    resolved = curHistory;
+    taaPrevHistory = prevHistory;
+  }
+
+  // from here on everything runs at full resolution
+  const bool upscale = renderExtent != resolution;
+  auto upscaleSource = resolved;
+  if (upscale)
+    renderGraph.addPass(
+      "upscale",
+      [&](RenderGraph::PassBuilder& builder) {
+        builder.read(upscaleSource, RenderGraph::Access::SampledInFragment);
+        resolved = builder.create(
+          "upscaled_color", {.extent = {resolution.x, resolution.y, 1}, .format = HDR_FORMAT});
+        builder.write(resolved, RenderGraph::Access::ColorAttachment);
+      },
+      [&](vk::CommandBuffer cmd, const RenderGraph::PassResources& res) {
+        ETNA_PROFILE_GPU(cmd, upscale);
+        drawFullscreen(
+          cmd, res.getView(resolved), {resolution.x, resolution.y}, upscalePipeline, upscaleSet);
+      });
+
+  // measure average luminance of the image and adapt exposure to it
+
+  renderGraph.addPass(
+    "luminance_histogram",
+    [&](RenderGraph::PassBuilder& builder) {
+      builder.read(resolved, RenderGraph::Access::SampledInCompute);
+      builder.markSideEffect();
+    },
+    [&](vk::CommandBuffer cmd, const RenderGraph::PassResources&) {
+      ETNA_PROFILE_GPU(cmd, buildLuminanceHistogram);
 
-    auto simpleMaterialInfo = etna::get_shader_program("simple_material");
+      // Last frame's exposure pass may still be reading the histogram
+      const vk::MemoryBarrier2 readToClear{
+        .srcStageMask = vk::PipelineStageFlagBits2::eComputeShader,
+        .srcAccessMask = vk::AccessFlagBits2::eShaderStorageRead,
+        .dstStageMask = vk::PipelineStageFlagBits2::eTransfer,
+        .dstAccessMask = vk::AccessFlagBits2::eTransferWrite,
+      };
+      cmd.pipelineBarrier2(vk::DependencyInfo{
+        .memoryBarrierCount = 1,
+        .pMemoryBarriers = &readToClear,
+      });
 
-    auto set = etna::create_descriptor_set(
-      simpleMaterialInfo.getDescriptorLayoutId(0),
+      cmd.fillBuffer(luminanceHistogram.get(), 0, vk::WholeSize, 0);
+      // Memory of a fresh buffer is garbage, which the exposure pass would happily adapt from
+      if (std::exchange(resetExposure, false))
+        cmd.fillBuffer(exposureState.get(), 0, vk::WholeSize, 0);
+
+      const vk::MemoryBarrier2 clearToBuild{
+        .srcStageMask = vk::PipelineStageFlagBits2::eTransfer,
+        .srcAccessMask = vk::AccessFlagBits2::eTransferWrite,
+        .dstStageMask = vk::PipelineStageFlagBits2::eComputeShader,
+        .dstAccessMask =
+          vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite,
+      };
+      cmd.pipelineBarrier2(vk::DependencyInfo{
+        .memoryBarrierCount = 1,
+        .pMemoryBarriers = &clearToBuild,
+      });
+
+      cmd.bindPipeline(vk::PipelineBindPoint::eCompute, histogramPipeline.getVkPipeline());
+      cmd.bindDescriptorSets(
+        vk::PipelineBindPoint::eCompute,
+        histogramPipeline.getVkPipelineLayout(),
+        0,
+        {histogramSet},
+        {});
+      cmd.dispatch(
+        (resolution.x + HISTOGRAM_GROUP_SIZE - 1) / HISTOGRAM_GROUP_SIZE,
+        (resolution.y + HISTOGRAM_GROUP_SIZE - 1) / HISTOGRAM_GROUP_SIZE,
+        1);
+    });
+
+  renderGraph.addPass(
+    "exposure",
+    [&](RenderGraph::PassBuilder& builder) { builder.markSideEffect(); },
+    [&](vk::CommandBuffer cmd, const RenderGraph::PassResources&) {
+      // Histogram is complete, and last frame's tonemap is done with the exposure
+      const vk::MemoryBarrier2 histogramToExposure{
+        .srcStageMask =
+          vk::PipelineStageFlagBits2::eComputeShader | vk::PipelineStageFlagBits2::eFragmentShader,
+        .srcAccessMask = vk::AccessFlagBits2::eShaderStorageWrite,
+        .dstStageMask = vk::PipelineStageFlagBits2::eComputeShader,
+        .dstAccessMask =
+          vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite,
+      };
+      cmd.pipelineBarrier2(vk::DependencyInfo{
+        .memoryBarrierCount = 1,
+        .pMemoryBarriers = &histogramToExposure,
+      });
+
+      cmd.bindPipeline(vk::PipelineBindPoint::eCompute, exposurePipeline.getVkPipeline());
+      cmd.bindDescriptorSets(
+        vk::PipelineBindPoint::eCompute,
+        exposurePipeline.getVkPipelineLayout(),
+        0,
+        {exposureSet},
+        {});
+      cmd.dispatch(1, 1, 1);
+
+      const vk::MemoryBarrier2 exposureToTonemap{
+        .srcStageMask = vk::PipelineStageFlagBits2::eComputeShader,
+        .srcAccessMask = vk::AccessFlagBits2::eShaderStorageWrite,
+        .dstStageMask = vk::PipelineStageFlagBits2::eFragmentShader,
+        .dstAccessMask = vk::AccessFlagBits2::eShaderStorageRead,
+      };
+      cmd.pipelineBarrier2(vk::DependencyInfo{
+        .memoryBarrierCount = 1,
+        .pMemoryBarriers = &exposureToTonemap,
+      });
+    });
+
+  const bool useFxaa = antiAliasing == AntiAliasing::Fxaa;
+  auto ldr = backbuffer;
+  renderGraph.addPass(
+    "tonemap",
+    [&](RenderGraph::PassBuilder& builder) {
+      builder.read(resolved, RenderGraph::Access::SampledInFragment);
+      if (useFxaa)
+        ldr = builder.create(
+          "ldr_color", {.extent = {resolution.x, resolution.y, 1}, .format = targetFormat});
+      builder.write(ldr, RenderGraph::Access::ColorAttachment);
+    },
+    [&](vk::CommandBuffer cmd, const RenderGraph::PassResources& res) {
+      ETNA_PROFILE_GPU(cmd, tonemap);
+      drawFullscreen(
+        cmd,
+        useFxaa ? res.getView(ldr) : target_image_view,
+        {resolution.x, resolution.y},
+        tonemapPipeline,
+        tonemapSet);
+    });
+
+  if (useFxaa)
+    renderGraph.addPass(
+      "fxaa",
+      [&](RenderGraph::PassBuilder& builder) {
+        builder.read(ldr, RenderGraph::Access::SampledInFragment);
+        builder.write(backbuffer, RenderGraph::Access::ColorAttachment);
+      },
+      [&](vk::CommandBuffer cmd, const RenderGraph::PassResources&) {
+        ETNA_PROFILE_GPU(cmd, applyFxaa);
+        drawFullscreen(
+          cmd, target_image_view, {resolution.x, resolution.y}, fxaaPipeline, fxaaSet);
+      });
+
+  if (drawDebugFSQuad)
+    renderGraph.addPass(
+      "debug_quad",
+      [&](RenderGraph::PassBuilder& builder) {
+        builder.modify(backbuffer, RenderGraph::Access::ColorAttachment);
+        builder.read(debugShowAtlas ? atlas : shadowMap, RenderGraph::Access::SampledInFragment);
+      },
+      [&](vk::CommandBuffer cmd, const RenderGraph::PassResources& res) {
+        if (debugShowAtlas)
+        {
+          quadRenderer->render(
+            cmd, target_image, target_image_view, res.getImage(atlas), defaultSampler);
+          return;
+        }
+
+        const auto layer = static_cast<std::uint32_t>(
+          std::clamp(debugCascade, 0, static_cast<int>(cascadeCount) - 1));
+        quadRenderer->render(
+          cmd,
+          target_image,
+          target_image_view,
+          res.getImage(shadowMap),
+          defaultSampler,
+          {.baseLayer = layer, .layerCount = 1});
+      });
+
+  renderGraph.compile();
+
+  if (std::exchange(dumpRenderGraph, false))
+    spdlog::info("{}", renderGraph.dump());
+
+  // etna's descriptor allocation is not thread safe, so sets are created up front.
+  // The graph takes care of image layouts, hence no barriers from here.
+  auto shadowProgramInfo = etna::get_shader_program(pipelines[shadowPipelineId].program.c_str());
+  auto shadowSet = etna::create_descriptor_set(
+    shadowProgramInfo.getDescriptorLayoutId(0),
+    cmd_buf,
+    {etna::Binding{2, sceneMgr->getInstanceBuffer().genBinding()}},
+    etna::BarrierBehavoir::eSuppressBarriers);
+
+  // Bindings of lights and shadows, shared by forward shading and deferred lighting
+  std::vector<etna::Binding> lightingBindings{
+    etna::Binding{0, uploadRing.genBinding(constants)},
+    etna::Binding{
+      1,
+      renderGraph.getResources().getImage(shadowMap).genBinding(
+        defaultSampler.get(), vk::ImageLayout::eShaderReadOnlyOptimal)},
+    etna::Binding{
+      3,
+      shadowAtlasImage.genBinding(defaultSampler.get(), vk::ImageLayout::eShaderReadOnlyOptimal)},
+    etna::Binding{4, uploadRing.genBinding(spotLightConstants)},
+    etna::Binding{5, uploadRing.genBinding(clusterConstants)},
+    etna::Binding{6, uploadRing.genBinding(clusterLightData)},
+    etna::Binding{7, clusterGrid.genBinding()},
+    etna::Binding{8, clusterLightIndices.genBinding()},
+  };
+
+  std::optional<etna::DescriptorSet> mainViewSet;
+  std::optional<etna::DescriptorSet> lightingSet;
+  if (!useDeferred)
+  {
+    lightingBindings.push_back(etna::Binding{2, sceneMgr->getInstanceBuffer().genBinding()});
+    auto programInfo = etna::get_shader_program(pipelines[forwardPipelineId].program.c_str());
+    mainViewSet = etna::create_descriptor_set(
+      programInfo.getDescriptorLayoutId(0),
+      cmd_buf,
+      std::move(lightingBindings),
+      etna::BarrierBehavoir::eSuppressBarriers);
+  }
+  else
+  {
+    auto gbufferProgramInfo =
+      etna::get_shader_program(pipelines[gbufferPipelineId].program.c_str());
+    mainViewSet = etna::create_descriptor_set(
+      gbufferProgramInfo.getDescriptorLayoutId(0),
       cmd_buf,
-      {etna::Binding{0, constants.genBinding()},
+      {etna::Binding{0, uploadRing.genBinding(constants)},
+       etna::Binding{2, sceneMgr->getInstanceBuffer().genBinding()}},
+      etna::BarrierBehavoir::eSuppressBarriers);
+
+    // Texels are fetched directly, so the sampler doesn't matter
+    const auto& resources = renderGraph.getResources();
+    const std::array<std::pair<std::uint32_t, RenderGraph::ResourceId>, 3> gbufferImages{{
+      {9, gbufferNormal},
+      {10, gbufferAlbedo},
+      {11, depth},
+    }};
+    for (const auto& [binding, id] : gbufferImages)
+      lightingBindings.push_back(etna::Binding{
+        binding,
+        resources.getImage(id).genBinding(
+          defaultSampler.get(), vk::ImageLayout::eShaderReadOnlyOptimal)});
+
+    auto lightingProgramInfo =
+      etna::get_shader_program(pipelines[deferredLightingPipelineId].program.c_str());
+    lightingSet = etna::create_descriptor_set(
+      lightingProgramInfo.getDescriptorLayoutId(0),
+      cmd_buf,
+      std::move(lightingBindings),
+      etna::BarrierBehavoir::eSuppressBarriers);
+    deferredLightingSet = lightingSet->getVkSet();
+  }
+
+  const auto& resources = renderGraph.getResources();
+  const auto& resolvedImage = resources.getImage(resolved);
+  auto histogramDescriptors = etna::create_descriptor_set(
+    etna::get_shader_program("luminance_histogram").getDescriptorLayoutId(0),
+    cmd_buf,
+    {etna::Binding{0, uploadRing.genBinding(exposureConstants)},
+     etna::Binding{
+       1,
+       resolvedImage.genBinding(defaultSampler.get(), vk::ImageLayout::eShaderReadOnlyOptimal)},
+     etna::Binding{2, luminanceHistogram.genBinding()}},
+    etna::BarrierBehavoir::eSuppressBarriers);
+  auto exposureDescriptors = etna::create_descriptor_set(
+    etna::get_shader_program("exposure").getDescriptorLayoutId(0),
+    cmd_buf,
+    {etna::Binding{0, uploadRing.genBinding(exposureConstants)},
+     etna::Binding{1, luminanceHistogram.genBinding()},
+     etna::Binding{2, exposureState.genBinding()}},
+    etna::BarrierBehavoir::eSuppressBarriers);
+  auto tonemapDescriptors = etna::create_descriptor_set(
+    etna::get_shader_program("tonemap").getDescriptorLayoutId(0),
+    cmd_buf,
+    {etna::Binding{
+       0,
+       resolvedImage.genBinding(defaultSampler.get(), vk::ImageLayout::eShaderReadOnlyOptimal)},
+     etna::Binding{1, exposureState.genBinding()}},
+    etna::BarrierBehavoir::eSuppressBarriers);
+  histogramSet = histogramDescriptors.getVkSet();
+  exposureSet = exposureDescriptors.getVkSet();
+  tonemapSet = tonemapDescriptors.getVkSet();
+
+  std::optional<etna::DescriptorSet> taaDescriptors;
+  if (antiAliasing == AntiAliasing::Taa)
+  {
+    taaDescriptors = etna::create_descriptor_set(
+      etna::get_shader_program("taa_resolve").getDescriptorLayoutId(0),
+      cmd_buf,
+      {etna::Binding{0, uploadRing.genBinding(taaConstants)},
+       etna::Binding{
+         1,
+         resources.getImage(hdr).genBinding(
+           defaultSampler.get(), vk::ImageLayout::eShaderReadOnlyOptimal)},
        etna::Binding{
-         1, shadowMap.genBinding(defaultSampler.get(), vk::ImageLayout::eShaderReadOnlyOptimal)}});
+         2,
+         resources.getImage(depth).genBinding(
+           defaultSampler.get(), vk::ImageLayout::eShaderReadOnlyOptimal)},
+       etna::Binding{
+         3,
+         resources.getImage(taaPrevHistory)
+           .genBinding(linearClampSampler.get(), vk::ImageLayout::eShaderReadOnlyOptimal)}},
+      etna::BarrierBehavoir::eSuppressBarriers);
+    taaSet = taaDescriptors->getVkSet();
 
-    etna::RenderTargetState renderTargets(
+    // History written this frame is read by the next one
+    taaHistoryIndex ^= 1;
+  }
+
+  std::optional<etna::DescriptorSet> upscaleDescriptors;
+  if (upscale)
+  {
+    upscaleDescriptors = etna::create_descriptor_set(
+      etna::get_shader_program("upscale").getDescriptorLayoutId(0),
+      cmd_buf,
+      {etna::Binding{0, uploadRing.genBinding(upscaleConstants)},
+       etna::Binding{
+         1,
+         resources.getImage(upscaleSource)
+           .genBinding(linearClampSampler.get(), vk::ImageLayout::eShaderReadOnlyOptimal)}},
+      etna::BarrierBehavoir::eSuppressBarriers);
+    upscaleSet = upscaleDescriptors->getVkSet();
+  }
+
+  std::optional<etna::DescriptorSet> fxaaDescriptors;
+  if (useFxaa)
+  {
+    fxaaDescriptors = etna::create_descriptor_set(
+      etna::get_shader_program("fxaa").getDescriptorLayoutId(0),
       cmd_buf,
-      {{0, 0}, {resolution.x, resolution.y}},
-      {{.image = target_image, .view = target_image_view}},
-      {.image = mainViewDepth.get(), .view = mainViewDepth.getView({})});
+      {etna::Binding{
+        0,
+        resources.getImage(ldr).genBinding(
+          linearClampSampler.get(), vk::ImageLayout::eShaderReadOnlyOptimal)}},
+      etna::BarrierBehavoir::eSuppressBarriers);
+    fxaaSet = fxaaDescriptors->getVkSet();
+  }
 
-    cmd_buf.bindPipeline(vk::PipelineBindPoint::eGraphics, basicForwardPipeline.getVkPipeline());
-    cmd_buf.bindDescriptorSets(
-      vk::PipelineBindPoint::eGraphics,
-      basicForwardPipeline.getVkPipelineLayout(),
-      0,
-      {set.getVkSet()},
-      {});
+  const std::array shadowMaterialSets{shadowSet.getVkSet()};
+  const std::array mainViewMaterialSets{mainViewSet->getVkSet()};
+  mainViewPass.materialSets = mainViewMaterialSets;
+  // Position-only variants of the scene program share the layout of shadow passes
+  prepassPass.materialSets = shadowMaterialSets;
 
-    renderScene(cmd_buf, worldViewProj, basicForwardPipeline.getVkPipelineLayout());
+  std::vector<SecondaryPass*> secondaryPasses;
+  for (std::uint32_t i = 0; i < cascadeCount; ++i)
+  {
+    staticPasses[i].materialSets = shadowMaterialSets;
+    dynamicPasses[i].materialSets = shadowMaterialSets;
+    if (cascades[i].redrawStatic)
+      secondaryPasses.push_back(&staticPasses[i]);
+    if (!cascades[i].dynamicQueue.getCommands().empty())
+      secondaryPasses.push_back(&dynamicPasses[i]);
   }
+  for (auto& pass : atlasPasses)
+  {
+    pass.materialSets = shadowMaterialSets;
+    secondaryPasses.push_back(&pass);
+  }
+  if (useDepthPrepass)
+    secondaryPasses.push_back(&prepassPass);
+  secondaryPasses.push_back(&mainViewPass);
 
-  if (drawDebugFSQuad)
-    quadRenderer->render(cmd_buf, target_image, target_image_view, shadowMap, defaultSampler);
+  cmdRecorder.beginFrame();
+  recordSecondaries(secondaryPasses);
+
+  renderGraph.setAsyncComputeEnabled(asyncLightClusters);
+  renderGraph.execute(cmd_buf, &gpuProfiler);
 }
 
 void WorldRenderer::drawGui()
@@ -258,6 +1961,130 @@ void WorldRenderer::drawGui()
     "Meshes base color", color, ImGuiColorEditFlags_PickerHueWheel | ImGuiColorEditFlags_NoInputs);
   uniformParams.baseColor = {color[0], color[1], color[2]};
 
+  ImGui::Checkbox("Shadows", &enableShadows);
+  ImGui::Checkbox("Animated light color", &animateLight);
+
+  if (ImGui::CollapsingHeader("Shading path"))
+  {
+    ImGui::Checkbox("Deferred shading", &useDeferred);
+    ImGui::Checkbox("Depth prepass", &useDepthPrepass);
+    ImGui::SliderFloat("Roughness", &uniformParams.roughness, 0.0f, 1.0f);
+    ImGui::SliderFloat("Metalness", &uniformParams.metalness, 0.0f, 1.0f);
+
+    // Passes that are not active are gone from the profiler, so only active ones are shown
+    if (useDepthPrepass)
+      ImGui::Text("Depth prepass: %.3f ms", gpuProfiler.getAverageMs("depth_prepass"));
+    if (useDeferred)
+      ImGui::Text(
+        "G-buffer: %.3f ms, lighting: %.3f ms",
+        gpuProfiler.getAverageMs("gbuffer"),
+        gpuProfiler.getAverageMs("deferred_lighting"));
+    else
+      ImGui::Text("Forward: %.3f ms", gpuProfiler.getAverageMs("forward"));
+  }
+
+  if (ImGui::CollapsingHeader("Shadow cascades"))
+  {
+    ImGui::SliderInt("Cascade count", &cascadeSettings.count, 1, MAX_SHADOW_CASCADES);
+    ImGui::SliderFloat("Split distribution", &cascadeSettings.splitLambda, 0.0f, 1.0f);
+    ImGui::SliderFloat("Shadow distance", &cascadeSettings.maxDistance, 1.0f, 500.0f);
+    ImGui::SliderInt("Debug quad cascade", &debugCascade, 0, cascadeSettings.count - 1);
+
+    ImGui::Checkbox("Cache static shadows", &useShadowCache);
+
+    // A cached cascade saves its static redraw, but copying the cache isn't free
+    double savedMs = -gpuProfiler.getAverageMs("shadow_copy");
+    for (std::uint32_t i = 0; i < cascadeCount; ++i)
+    {
+      const auto& cascade = cascades[i];
+      if (!cascade.redrawStatic)
+        savedMs += cascade.staticRenderMs;
+
+      ImGui::Text(
+        "Cascade %u: up to %.1f, %zu static draws (%s, %.3f ms), %zu dynamic draws",
+        i,
+        cascade.splitFar,
+        cascade.staticQueue.getCommands().size(),
+        cascade.redrawStatic ? "redrawn" : "cached",
+        cascade.staticRenderMs,
+        cascade.dynamicQueue.getCommands().size());
+    }
+    ImGui::Text("GPU time saved by the cache: %.3f ms", savedMs);
+  }
+
+  if (ImGui::CollapsingHeader("Resolution"))
+  {
+    ImGui::Checkbox("Dynamic resolution", &dynamicResolution);
+    if (dynamicResolution)
+      ImGui::SliderFloat("Target GPU frame time, ms", &targetFrameMs, 4.0f, 50.0f);
+    else
+      ImGui::SliderFloat("Render scale", &renderScale, MIN_RENDER_SCALE, 1.0f);
+    ImGui::Text(
+      "Rendering at %ux%u, %.0f%% of %ux%u",
+      renderExtent.x,
+      renderExtent.y,
+      renderScale * 100.0f,
+      resolution.x,
+      resolution.y);
+    ImGui::Text("GPU frame: %.3f ms", gpuProfiler.getAverageMs("frame"));
+    if (renderExtent != resolution)
+      ImGui::Text("Upscale: %.3f ms", gpuProfiler.getAverageMs("upscale"));
+  }
+
+  if (ImGui::CollapsingHeader("Anti-aliasing"))
+  {
+    int mode = static_cast<int>(antiAliasing);
+    ImGui::Combo("Mode", &mode, "None\0FXAA\0TAA\0");
+    antiAliasing = static_cast<AntiAliasing>(mode);
+    ImGui::SliderFloat("TAA current frame weight", &taaFeedback, 0.02f, 1.0f);
+
+    // Passes that are not active are gone from the profiler
+    if (antiAliasing == AntiAliasing::Fxaa)
+      ImGui::Text("FXAA: %.3f ms", gpuProfiler.getAverageMs("fxaa"));
+    else if (antiAliasing == AntiAliasing::Taa)
+      ImGui::Text("TAA resolve: %.3f ms", gpuProfiler.getAverageMs("taa_resolve"));
+  }
+
+  if (ImGui::CollapsingHeader("Exposure"))
+  {
+    ImGui::SliderFloat("Exposure compensation", &exposureCompensation, -5.0f, 5.0f);
+    ImGui::SliderFloat("Adaptation speed", &adaptationSpeed, 0.1f, 10.0f);
+    ImGui::Text(
+      "Histogram: %.3f ms, tonemap: %.3f ms",
+      gpuProfiler.getAverageMs("luminance_histogram"),
+      gpuProfiler.getAverageMs("tonemap"));
+  }
+
+  if (ImGui::CollapsingHeader("Clustered lights"))
+  {
+    if (ImGui::SliderInt("Clustered light count", &clusteredLightCount, 0, MAX_CLUSTERED_LIGHTS))
+      spawnClusteredLights();
+
+    ImGui::Text(
+      "Grid: %ux%ux%u clusters, up to %u lights each",
+      CLUSTER_GRID_X,
+      CLUSTER_GRID_Y,
+      CLUSTER_GRID_Z,
+      MAX_LIGHTS_PER_CLUSTER);
+    ImGui::Text("Light assignment: %.3f ms", gpuProfiler.getAverageMs("light_clusters"));
+    // Off serializes light assignment with shadow rendering
+    ImGui::Checkbox("Overlap with shadows (async compute)", &asyncLightClusters);
+  }
+
+  if (ImGui::CollapsingHeader("Spot lights"))
+  {
+    if (ImGui::SliderInt("Spot light count", &spotLightCount, 0, MAX_SPOT_LIGHTS))
+      spawnSpotLights();
+    ImGui::SliderInt("Atlas tile updates per frame", &maxAtlasUpdates, 0, 16);
+    ImGui::Checkbox("Debug quad shows the atlas", &debugShowAtlas);
+
+    ImGui::Text(
+      "Atlas occupancy: %.1f%%, tiles rendered: %zu, lights without a tile: %u",
+      shadowAtlas.getOccupancy() * 100.0f,
+      atlasUpdates.size(),
+      lightsWithoutTiles);
+  }
+
   float pos[3]{uniformParams.lightPos.x, uniformParams.lightPos.y, uniformParams.lightPos.z};
   ImGui::SliderFloat3("Light source position", pos, -10.f, 10.f);
   uniformParams.lightPos = {pos[0], pos[1], pos[2]};
@@ -267,8 +2094,18 @@ void WorldRenderer::drawGui()
     1000.0f / ImGui::GetIO().Framerate,
     ImGui::GetIO().Framerate);
 
+  ImGui::Text(
+    "Draw calls: %u, pipeline binds: %u, descriptor binds: %u",
+    prevFrameStats.drawCalls,
+    prevFrameStats.pipelineBinds,
+    prevFrameStats.descriptorBinds);
+  ImGui::Text("Triangles: %llu", static_cast<unsigned long long>(prevFrameStats.triangles));
+
   ImGui::NewLine();
 
-  ImGui::TextColored(ImVec4(1.0f, 1.0f, 0.0f, 1.0f), "Press 'B' to recompile and reload shaders");
+  ImGui::TextColored(
+    ImVec4(1.0f, 1.0f, 0.0f, 1.0f), "Shaders reload on save, press 'B' to recompile all of them");
+  ImGui::TextColored(ImVec4(1.0f, 1.0f, 0.0f, 1.0f), "Press 'G' to dump the render graph");
+  ImGui::TextColored(ImVec4(1.0f, 1.0f, 0.0f, 1.0f), "Press 'F1' to toggle the stats overlay");
   ImGui::End();
 }
@@ -1,14 +1,28 @@
 #pragma once
 
+#include <array>
+#include <deque>
+#include <optional>
+
 #include <etna/Image.hpp>
 #include <etna/Sampler.hpp>
 #include <etna/Buffer.hpp>
 #include <etna/GraphicsPipeline.hpp>
+#include <etna/ComputePipeline.hpp>
 #include <glm/glm.hpp>
 
 #include "shaders/UniformParams.h"
 #include "scene/SceneManager.hpp"
+#include "scene/BoundingBox.hpp"
 #include "render_utils/QuadRenderer.hpp"
+#include "render_utils/RenderQueue.hpp"
+#include "render_utils/RenderStats.hpp"
+#include "render_utils/SecondaryCmdRecorder.hpp"
+#include "render_utils/UploadRing.hpp"
+#include "render_utils/ShaderVariants.hpp"
+#include "render_utils/ShadowAtlas.hpp"
+#include "render_graph/RenderGraph.hpp"
+#include "profiling/GpuProfiler.hpp"
 #include "wsi/Keyboard.hpp"
 
 #include "FramePacket.hpp"
@@ -21,7 +35,7 @@
 class WorldRenderer
 {
 public:
-  WorldRenderer();
+  WorldRenderer(ThreadPool& thread_pool, GpuProfiler& gpu_profiler);
 
   void loadScene(std::filesystem::path path);
 
@@ -35,48 +49,307 @@ public:
   void renderWorld(
     vk::CommandBuffer cmd_buf, vk::Image target_image, vk::ImageView target_image_view);
 
+  // Counters of the last renderWorld call
+  const RenderStats& getFrameStats() const { return stats; }
+
 private:
+  // Toggles of shader variants, see target_add_shader_variant calls in CMakeLists.txt
+  enum ShaderFeature : ShaderVariants::FeatureMask
+  {
+    // Normals, tangents and texture coordinates, i.e. anything beyond depth
+    FEATURE_SURFACE = 1 << 0,
+    FEATURE_SHADOWS = 1 << 1,
+    FEATURE_ANIMATED_LIGHT = 1 << 2,
+  };
+
+  enum class PipelineKind
+  {
+    Shadow,
+    DepthPrepass,
+    Forward,
+    GBuffer,
+    // Fullscreen pass shading the G-buffer, never goes into render queues
+    DeferredLighting,
+  };
+
+  // Returns the index of a pipeline, creating it on first request.
+  // Indices go into the pipeline field of render queue sort keys.
+  // Color passes after a depth prepass only draw fragments with exactly the prepass depth.
+  std::uint32_t requestPipeline(
+    PipelineKind kind, ShaderVariants::FeatureMask features, bool after_prepass = false);
+  const etna::GraphicsPipeline& getPipeline(std::uint32_t id) const;
+  // Features of the pass computing lighting, either forward or deferred
+  ShaderVariants::FeatureMask getLightingFeatures() const;
+
+  // Draws of a render queue recorded into secondary command buffers,
+  // large queues are split into several chunks recorded on different threads
+  struct SecondaryPass
+  {
+    const RenderQueue* queue = nullptr;
+    glm::mat4x4 globTm;
+    std::span<const vk::DescriptorSet> materialSets;
+    SecondaryCmdRecorder::RenderingFormats formats;
+    vk::Rect2D area;
+    std::vector<vk::CommandBuffer> chunks;
+  };
+
+  enum class InstanceFilter
+  {
+    All,
+    Static,
+    Dynamic,
+  };
+
+  void updateSceneBounds();
+  void updateCascades(const Camera& main_cam, const Camera& light_cam);
+  // Forgets cached static shadows, e.g. when static geometry changes
+  void invalidateShadowCache();
+  void spawnSpotLights();
+  void spawnClusteredLights();
+  // Assigns atlas tiles to spot lights and picks the tiles to be rendered this frame
+  void updateSpotLights(const Camera& main_cam);
+  // Only instances intersecting the clip volume of glob_tm end up in the queue
+  void buildRenderQueue(
+    RenderQueue& queue,
+    std::uint32_t pipeline_id,
+    const glm::mat4x4& glob_tm,
+    InstanceFilter filter = InstanceFilter::All);
+  void recordSecondaries(std::span<SecondaryPass* const> passes);
+  // Picks the render scale from the GPU time of the most recently resolved frame
+  void updateRenderScale();
+  // Draws a single triangle covering the top left extent of the target,
+  // inside a rendering scope of its own
+  void drawFullscreen(
+    vk::CommandBuffer cmd_buf,
+    vk::ImageView target,
+    vk::Extent2D extent,
+    const etna::GraphicsPipeline& pipeline,
+    vk::DescriptorSet set);
+  // Draws the commands [first_command, first_command + command_count) of the queue
   void renderScene(
-    vk::CommandBuffer cmd_buf, const glm::mat4x4& glob_tm, vk::PipelineLayout pipeline_layout);
+    vk::CommandBuffer cmd_buf,
+    const RenderQueue& queue,
+    std::size_t first_command,
+    std::size_t command_count,
+    const glm::mat4x4& glob_tm,
+    std::span<const vk::DescriptorSet> material_sets,
+    RenderStats& out_stats) const;
 
 
 private:
+  ThreadPool& threadPool;
+  GpuProfiler& gpuProfiler;
+  SecondaryCmdRecorder cmdRecorder;
   std::unique_ptr<SceneManager> sceneMgr;
 
-  etna::Image mainViewDepth;
-  etna::Image shadowMap;
+  // Depth buffers and the cascaded shadow map are transient images living in here
+  RenderGraph renderGraph;
+  bool dumpRenderGraph = false;
+
   etna::Sampler defaultSampler;
-  etna::Buffer constants;
+  // For post-processing, which samples between texels and must not wrap around
+  etna::Sampler linearClampSampler;
+  // Per-frame constants live here, so frames in flight never overwrite each other's data
+  UploadRing uploadRing;
 
   struct PushConstants
   {
     glm::mat4x4 projView;
-    glm::mat4x4 model;
-  } pushConst2M;
+  };
 
   glm::mat4x4 worldViewProj;
-  glm::mat4x4 lightMatrix;
   glm::vec3 lightPos;
 
-  struct ShadowMapCam
+  struct CascadeSettings
+  {
+    int count = MAX_SHADOW_CASCADES;
+    // Blend between uniform (0) and logarithmic (1) distribution of the splits
+    float splitLambda = 0.75f;
+    // Shadows end this far from the camera
+    float maxDistance = 60.0f;
+  } cascadeSettings;
+
+  struct Cascade
+  {
+    glm::mat4x4 lightMatrix;
+    // Distance from the camera at which the cascade ends
+    float splitFar = 0;
+
+    // Static geometry is only redrawn into the cache when the cascade moves
+    RenderQueue staticQueue;
+    RenderQueue dynamicQueue;
+    // Matrix the cached layer was rendered with, empty if the layer is invalid
+    std::optional<glm::mat4x4> cachedLightMatrix;
+    bool redrawStatic = true;
+    // Last measured cost of redrawing static geometry, i.e. what a cache hit saves
+    double staticRenderMs = 0;
+  };
+
+  std::array<Cascade, MAX_SHADOW_CASCADES> cascades;
+  std::uint32_t cascadeCount = 0;
+  // Which cascade is shown by the debug quad
+  int debugCascade = 0;
+
+  // Depth of static geometry for every cascade, persists between frames.
+  // Every frame it is copied into the shadow map and dynamic geometry is drawn on top.
+  etna::Image shadowCache;
+  bool useShadowCache = true;
+
+  // World space bounds of every instance, instances never move so these are computed on load
+  std::vector<BoundingBox> instanceBounds;
+  BoundingBox sceneBounds;
+  std::vector<bool> instanceDynamic;
+
+  struct SpotLight
   {
-    float radius = 10;
-    float lightTargetDist = 24;
-    bool usePerspectiveM = false;
-  } lightProps;
+    glm::vec3 position;
+    glm::vec3 direction;
+    glm::vec3 color;
+    float range;
+    // Half-angles of the cone, the light fades out between the two
+    float innerAngle;
+    float outerAngle;
+
+    glm::mat4x4 viewProj;
+    // Fraction of the screen height covered by the light's sphere of influence
+    float screenCoverage = 0;
+    std::optional<ShadowAtlas::Tile> tile;
+    // Matrix the tile was rendered with, empty if the tile is yet to be rendered
+    std::optional<glm::mat4x4> renderedViewProj;
+    // Frames the light has been waiting for its tile to be rendered, starved lights win
+    std::uint32_t staleFrames = 0;
+    RenderQueue queue;
+  };
+
+  std::vector<SpotLight> spotLights;
+  int spotLightCount = 16;
+  // Tiles beyond the budget keep their old contents or wait without shadows
+  int maxAtlasUpdates = 4;
+  // Indices of lights whose tiles are rendered this frame
+  std::vector<std::uint32_t> atlasUpdates;
+  std::uint32_t lightsWithoutTiles = 0;
+
+  ShadowAtlas shadowAtlas;
+  // Persists between frames, tiles are only re-rendered when needed
+  etna::Image shadowAtlasImage;
+  bool debugShowAtlas = false;
+
+  SpotLightTable spotLightTable{};
+
+  // Unshadowed lights, binned into a froxel grid by a compute pass every frame,
+  // so that every fragment only iterates the lights of its cluster
+  std::vector<ClusteredLight> clusteredLights;
+  // Crank it up to stress test light assignment
+  int clusteredLightCount = 256;
+  ClusterParams clusterParams{};
+  // Lighting passes wait for the light lists with an event instead of a barrier right
+  // after building them, so that shadow passes recorded in between run concurrently
+  bool asyncLightClusters = true;
+  etna::ComputePipeline clusterPipeline;
+  // Offset and count of every cluster's light list within the index buffer
+  etna::Buffer clusterGrid;
+  // Light count followed by all light lists
+  etna::Buffer clusterLightIndices;
+
+  // The scene is lit into an HDR target, a luminance histogram of which drives exposure
+  ExposureParams exposureParams{};
+  etna::ComputePipeline histogramPipeline;
+  etna::ComputePipeline exposurePipeline;
+  etna::GraphicsPipeline tonemapPipeline;
+  etna::Buffer luminanceHistogram;
+  // Adapted luminance and resulting exposure, persists between frames
+  etna::Buffer exposureState;
+  bool resetExposure = true;
+  // Per second, higher adapts faster
+  float adaptationSpeed = 1.5f;
+  // In stops
+  float exposureCompensation = 0.0f;
+  float prevTime = -1.0f;
+
+  enum class AntiAliasing
+  {
+    None,
+    Fxaa,
+    Taa,
+  };
+  AntiAliasing antiAliasing = AntiAliasing::None;
+
+  // Jittered frames are accumulated into the history, the two images are read and written
+  // in turns. Alpha of the history is the view depth, it is used to reject stale history.
+  std::array<etna::Image, 2> taaHistory;
+  std::uint32_t taaHistoryIndex = 0;
+  bool taaHistoryValid = false;
+  std::uint32_t taaFrame = 0;
+  float taaFeedback = 0.1f;
+  // Without jitter, camera motion is reprojected with it
+  std::optional<glm::mat4x4> prevViewProj;
+  TaaParams taaParams{};
+  etna::GraphicsPipeline taaPipeline;
+  etna::GraphicsPipeline fxaaPipeline;
+
+  // Scene passes render into the top left renderExtent of targets sized by the resolution,
+  // so changing the scale never reallocates anything. The result is upscaled afterwards.
+  float renderScale = 1.0f;
+  glm::uvec2 renderExtent{};
+  // Extent of the frame that wrote the TAA history
+  glm::uvec2 historyExtent{};
+  // Scale is picked by a controller holding the target GPU frame time, otherwise set by hand
+  bool dynamicResolution = false;
+  float targetFrameMs = 16.0f;
+  // The controller reacts to every resolved frame once
+  std::optional<std::uint64_t> lastScaledFrame;
+  UpscaleParams upscaleParams{};
+  etna::GraphicsPipeline upscalePipeline;
 
   UniformParams uniformParams{
-    .lightMatrix = {},
+    .cascadeMatrices = {},
+    .invProjView = {},
     .lightPos = {},
     .time = {},
     .baseColor = {0.9f, 0.92f, 1.0f},
+    .cascadeCount = 0,
+    .roughness = 0.5f,
+    .metalness = 0.0f,
+    .padding0 = 0,
+    .padding1 = 0,
   };
 
-  etna::GraphicsPipeline basicForwardPipeline{};
-  etna::GraphicsPipeline shadowPipeline{};
+  struct PipelineEntry
+  {
+    PipelineKind kind;
+    ShaderVariants::FeatureMask features;
+    bool afterPrepass;
+    // Fed with the position stream instead of full vertices
+    bool positionOnly;
+    std::string program;
+    etna::GraphicsPipeline pipeline;
+  };
+
+  ShaderVariants shaderVariants;
+  // NOTE: deque, so that adding pipelines never moves existing ones
+  std::deque<PipelineEntry> pipelines;
+  std::uint32_t shadowPipelineId = 0;
+  std::uint32_t prepassPipelineId = 0;
+  std::uint32_t forwardPipelineId = 0;
+  std::uint32_t gbufferPipelineId = 0;
+  std::uint32_t deferredLightingPipelineId = 0;
+  bool enableShadows = true;
+  bool animateLight = true;
+
+  // Switches the main view between forward shading and a G-buffer with a lighting pass
+  bool useDeferred = false;
+  // Main view draws, either forward shaded or into the G-buffer
+  RenderQueue mainViewQueue;
+  // Fills main view depth ahead of the color pass, so that overdraw is never shaded
+  bool useDepthPrepass = false;
+  RenderQueue prepassQueue;
+  RenderStats stats;
+  // drawGui runs before renderWorld, so the GUI shows the numbers of the previous frame
+  RenderStats prevFrameStats;
 
   std::unique_ptr<QuadRenderer> quadRenderer;
   bool drawDebugFSQuad = false;
 
   glm::uvec2 resolution;
+  vk::Format targetFormat = vk::Format::eUndefined;
 };
@@ -1,10 +1,10 @@
 #include "App.hpp"
 
 
-int main()
+int main(int argc, char** argv)
 {
   {
-    App app;
+    App app(parse_headless_options(argc, argv), parse_benchmark_options(argc, argv));
     app.run();
   }
 
@@ -4,13 +4,133 @@
 #include "cpp_glsl_compat.h"
 
 
+// Size of the cascade arrays, the number of cascades actually used is cascadeCount
+#define MAX_SHADOW_CASCADES 4
+
 struct UniformParams
 {
-  shader_mat4 lightMatrix;
+  // World to light clip space, cascades are ordered from nearest to farthest
+  shader_mat4 cascadeMatrices[MAX_SHADOW_CASCADES];
+  // Clip to world space of the main camera, deferred lighting reconstructs positions with it
+  shader_mat4 invProjView;
   shader_vec3 lightPos;
   shader_float time;
   shader_vec3 baseColor;
+  shader_uint cascadeCount;
+  // There are no materials yet, so the whole scene shares these
+  shader_float roughness;
+  shader_float metalness;
+  shader_uint padding0;
+  shader_uint padding1;
+};
+
+#define MAX_SPOT_LIGHTS 64
+
+struct SpotLightData
+{
+  // World to light clip space
+  shader_mat4 viewProj;
+  // Offset in xy and scale in zw of the light's shadow atlas tile, in atlas texture coordinates.
+  // Zero scale means that the light has no valid tile and casts no shadows.
+  shader_vec4 atlasRect;
+  shader_vec3 position;
+  shader_float range;
+  shader_vec3 direction;
+  shader_float cosOuterAngle;
+  shader_vec3 color;
+  shader_float cosInnerAngle;
+};
+
+struct SpotLightTable
+{
+  SpotLightData lights[MAX_SPOT_LIGHTS];
+  shader_uint count;
+  // The size of a uniform block is rounded up to 16 bytes, this keeps the C++ side in sync
+  shader_uint padding0;
+  shader_uint padding1;
+  shader_uint padding2;
+};
+
+// Clustered lights are binned into a froxel grid, slices are distributed exponentially in depth
+#define CLUSTER_GRID_X 16
+#define CLUSTER_GRID_Y 9
+#define CLUSTER_GRID_Z 24
+#define CLUSTER_COUNT (CLUSTER_GRID_X * CLUSTER_GRID_Y * CLUSTER_GRID_Z)
+#define CLUSTER_WORKGROUP_SIZE 64
+// Lights beyond this are dropped from a cluster
+#define MAX_LIGHTS_PER_CLUSTER 128
+// Capacity of the light index list shared by all clusters
+#define MAX_CLUSTER_LIGHT_INDICES (CLUSTER_COUNT * 32)
+#define MAX_CLUSTERED_LIGHTS 4096
+
+// Unshadowed point or spot light, point lights have a cone covering the whole sphere
+struct ClusteredLight
+{
+  shader_vec3 position;
+  shader_float range;
+  shader_vec3 color;
+  shader_float cosOuterAngle;
+  shader_vec3 direction;
+  shader_float cosInnerAngle;
 };
 
+struct ClusterParams
+{
+  // Of the main camera
+  shader_mat4 view;
+  shader_mat4 invProj;
+  shader_vec2 screenSize;
+  // View space depth range covered by the slices
+  shader_float zNear;
+  shader_float zFar;
+  shader_uint lightCount;
+  shader_uint padding0;
+  shader_uint padding1;
+  shader_uint padding2;
+};
+
+// Log-luminance histogram of the HDR image, bin 0 collects pixels that are too dark to count
+#define LUMINANCE_HISTOGRAM_BINS 256
+// Histogram workgroups are squares with an invocation per bin
+#define HISTOGRAM_GROUP_SIZE 16
+
+struct ExposureParams
+{
+  shader_uvec2 resolution;
+  // Luminance range covered by the histogram, in log2 units
+  shader_float minLogLuminance;
+  shader_float logLuminanceRange;
+  // How far the adapted luminance moves towards the measured one this frame, 1 means instantly
+  shader_float adaptationBlend;
+  // In stops, applied on top of the automatic exposure
+  shader_float exposureCompensation;
+  shader_uint padding0;
+  shader_uint padding1;
+};
+struct TaaParams
+{
+  // Clip to world space of the current frame, jitter included
+  shader_mat4 invViewProj;
+  // World to clip space of the previous frame, without jitter
+  shader_mat4 prevViewProj;
+  shader_vec2 resolution;
+  // Weight of the current frame in the accumulated history
+  shader_float feedback;
+  // Relative difference of view depths above which history is thrown away
+  shader_float depthTolerance;
+  // Part of the history image that the previous frame was rendered into
+  shader_vec2 historyUvScale;
+  // Nonzero when there is no usable history, e.g. after a resize
+  shader_uint resetHistory;
+  shader_uint padding0;
+};
+
+struct UpscaleParams
+{
+  // Part of the source image that was actually rendered into
+  shader_vec2 sourceUvScale;
+  // Size of the whole source image, which is also the size of the output
+  shader_vec2 sourceSize;
+};
 
 #endif // UNIFORM_PARAMS_H_INCLUDED
@@ -0,0 +1,44 @@
+#ifndef CLUSTERS_GLSL_INCLUDED
+#define CLUSTERS_GLSL_INCLUDED
+
+#include "UniformParams.h"
+
+// Shared by cluster assignment and shading, see ClusterParams in UniformParams.h
+
+
+float cluster_slice_depth(ClusterParams params, uint slice)
+{
+  return params.zNear * pow(params.zFar / params.zNear, float(slice) / float(CLUSTER_GRID_Z));
+}
+
+uint cluster_slice(ClusterParams params, float view_depth)
+{
+  const float t = log(max(view_depth, params.zNear) / params.zNear) / log(params.zFar / params.zNear);
+  return min(uint(max(t, 0.0f) * float(CLUSTER_GRID_Z)), uint(CLUSTER_GRID_Z - 1));
+}
+
+uint cluster_index(ClusterParams params, vec2 frag_coord, float view_depth)
+{
+  const uvec2 tile = min(
+    uvec2(frag_coord / params.screenSize * vec2(CLUSTER_GRID_X, CLUSTER_GRID_Y)),
+    uvec2(CLUSTER_GRID_X - 1, CLUSTER_GRID_Y - 1));
+  return tile.x + CLUSTER_GRID_X * (tile.y + CLUSTER_GRID_Y * cluster_slice(params, view_depth));
+}
+
+// Lighting of a spot light without shadows, point lights are spot lights with a wide enough cone
+vec3 spot_light_radiance(
+  vec3 light_pos, float range, vec3 direction, float cos_outer, float cos_inner, vec3 color,
+  vec3 w_pos, vec3 w_norm)
+{
+  const vec3 toLight = light_pos - w_pos;
+  const float dist = length(toLight);
+  if (dist > range)
+    return vec3(0.0f);
+
+  const vec3 lightDir = toLight/dist;
+  const float cone = smoothstep(cos_outer, cos_inner, dot(-lightDir, direction));
+  const float falloff = 1.0f - (dist*dist)/(range*range);
+  return color * max(dot(w_norm, lightDir), 0.0f) * cone * falloff * falloff;
+}
+
+#endif // CLUSTERS_GLSL_INCLUDED
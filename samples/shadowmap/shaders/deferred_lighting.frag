@@ -0,0 +1,37 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : require
+
+#include "lighting.glsl"
+#include "gbuffer.glsl"
+
+// Shades every pixel of the G-buffer with the same lights as forward shading
+
+
+layout(location = 0) out vec4 out_fragColor;
+
+layout(binding = 9) uniform sampler2D gbufferNormal;
+layout(binding = 10) uniform sampler2D gbufferAlbedo;
+layout(binding = 11) uniform sampler2D gbufferDepth;
+
+void main()
+{
+  const ivec2 texel = ivec2(gl_FragCoord.xy);
+  const float depth = texelFetch(gbufferDepth, texel, 0).x;
+
+  // Nothing was drawn here, same as the clear color of the forward pass
+  if (depth >= 1.0f)
+  {
+    out_fragColor = vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    return;
+  }
+
+  const vec2 ndc = gl_FragCoord.xy / clusterParams.screenSize * 2.0f - 1.0f;
+  const vec4 wPos = params.invProjView * vec4(ndc, depth, 1.0f);
+
+  const vec3 wNorm = decode_octahedral(texelFetch(gbufferNormal, texel, 0).xy);
+  // Roughness and metalness are stored for future BRDFs, the current light formula ignores them
+  const vec3 albedo = texelFetch(gbufferAlbedo, texel, 0).rgb;
+
+  out_fragColor = vec4(shade_surface(wPos.xyz / wPos.w, wNorm, albedo), 1.0f);
+}
@@ -0,0 +1,11 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// A single triangle covering the whole screen, drawn without any vertex buffers
+
+out gl_PerVertex { vec4 gl_Position; };
+void main()
+{
+  const vec2 xy = gl_VertexIndex == 0 ? vec2(-1, -1) : (gl_VertexIndex == 1 ? vec2(3, -1) : vec2(-1, 3));
+  gl_Position = vec4(xy, 0, 1);
+}
@@ -0,0 +1,136 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// Fast approximate anti-aliasing in the spirit of FXAA 3.11 by Timothy Lottes:
+// finds the local edge direction from luma, walks along the edge to its ends
+// and blends across it depending on how far the pixel is from the ends.
+
+
+layout(location = 0) out vec4 out_fragColor;
+
+// Tonemapped image, must be sampled with a linear clamping sampler
+layout(binding = 0) uniform sampler2D ldrColor;
+
+const float EDGE_THRESHOLD = 0.125f;
+const float EDGE_THRESHOLD_MIN = 0.0312f;
+const float SUBPIXEL_QUALITY = 0.75f;
+const int SEARCH_STEPS = 10;
+
+float luma(vec3 color)
+{
+  // Perceptual rather than linear, FXAA thresholds are tuned for gamma space
+  return sqrt(dot(color, vec3(0.299f, 0.587f, 0.114f)));
+}
+
+float luma_at(vec2 uv)
+{
+  return luma(textureLod(ldrColor, uv, 0).rgb);
+}
+
+void main()
+{
+  const vec2 texelSize = 1.0f / vec2(textureSize(ldrColor, 0));
+  const vec2 uv = gl_FragCoord.xy * texelSize;
+  const vec3 center = textureLod(ldrColor, uv, 0).rgb;
+
+  const float lumaM = luma(center);
+  const float lumaN = luma_at(uv + vec2(0, -1) * texelSize);
+  const float lumaS = luma_at(uv + vec2(0, 1) * texelSize);
+  const float lumaW = luma_at(uv + vec2(-1, 0) * texelSize);
+  const float lumaE = luma_at(uv + vec2(1, 0) * texelSize);
+
+  const float lumaMin = min(lumaM, min(min(lumaN, lumaS), min(lumaW, lumaE)));
+  const float lumaMax = max(lumaM, max(max(lumaN, lumaS), max(lumaW, lumaE)));
+  const float range = lumaMax - lumaMin;
+
+  if (range < max(EDGE_THRESHOLD_MIN, lumaMax * EDGE_THRESHOLD))
+  {
+    out_fragColor = vec4(center, 1.0f);
+    return;
+  }
+
+  const float lumaNW = luma_at(uv + vec2(-1, -1) * texelSize);
+  const float lumaNE = luma_at(uv + vec2(1, -1) * texelSize);
+  const float lumaSW = luma_at(uv + vec2(-1, 1) * texelSize);
+  const float lumaSE = luma_at(uv + vec2(1, 1) * texelSize);
+
+  const float edgeHorizontal = abs(lumaNW + lumaNE - 2.0f * lumaN)
+    + 2.0f * abs(lumaW + lumaE - 2.0f * lumaM) + abs(lumaSW + lumaSE - 2.0f * lumaS);
+  const float edgeVertical = abs(lumaNW + lumaSW - 2.0f * lumaW)
+    + 2.0f * abs(lumaN + lumaS - 2.0f * lumaM) + abs(lumaNE + lumaSE - 2.0f * lumaE);
+  const bool horizontal = edgeHorizontal >= edgeVertical;
+
+  // Pick the side of the edge with the steeper gradient
+  const float luma1 = horizontal ? lumaN : lumaW;
+  const float luma2 = horizontal ? lumaS : lumaE;
+  const float gradient1 = abs(luma1 - lumaM);
+  const float gradient2 = abs(luma2 - lumaM);
+  const bool steeper1 = gradient1 >= gradient2;
+  const float gradientScaled = 0.25f * max(gradient1, gradient2);
+
+  float stepLength = horizontal ? texelSize.y : texelSize.x;
+  float lumaLocalAverage;
+  if (steeper1)
+  {
+    stepLength = -stepLength;
+    lumaLocalAverage = 0.5f * (luma1 + lumaM);
+  }
+  else
+    lumaLocalAverage = 0.5f * (luma2 + lumaM);
+
+  vec2 edgeUv = uv;
+  if (horizontal)
+    edgeUv.y += stepLength * 0.5f;
+  else
+    edgeUv.x += stepLength * 0.5f;
+
+  // Walk along the edge in both directions until its luma changes
+  const vec2 offset = horizontal ? vec2(texelSize.x, 0.0f) : vec2(0.0f, texelSize.y);
+  vec2 uv1 = edgeUv - offset;
+  vec2 uv2 = edgeUv + offset;
+  float lumaEnd1 = luma_at(uv1) - lumaLocalAverage;
+  float lumaEnd2 = luma_at(uv2) - lumaLocalAverage;
+  bool reached1 = abs(lumaEnd1) >= gradientScaled;
+  bool reached2 = abs(lumaEnd2) >= gradientScaled;
+
+  for (int i = 0; i < SEARCH_STEPS && !(reached1 && reached2); ++i)
+  {
+    if (!reached1)
+    {
+      uv1 -= offset;
+      lumaEnd1 = luma_at(uv1) - lumaLocalAverage;
+      reached1 = abs(lumaEnd1) >= gradientScaled;
+    }
+    if (!reached2)
+    {
+      uv2 += offset;
+      lumaEnd2 = luma_at(uv2) - lumaLocalAverage;
+      reached2 = abs(lumaEnd2) >= gradientScaled;
+    }
+  }
+
+  const float distance1 = horizontal ? uv.x - uv1.x : uv.y - uv1.y;
+  const float distance2 = horizontal ? uv2.x - uv.x : uv2.y - uv.y;
+  const bool closer1 = distance1 < distance2;
+  const float edgeLength = distance1 + distance2;
+
+  // Only blend when the pixel lies on the side the edge bends towards
+  const bool centerSmaller = lumaM < lumaLocalAverage;
+  const bool correctVariation = ((closer1 ? lumaEnd1 : lumaEnd2) < 0.0f) != centerSmaller;
+  float edgeOffset = correctVariation ? 0.5f - min(distance1, distance2) / edgeLength : 0.0f;
+
+  // Sub-pixel aliasing, e.g. thin lines, is handled with the 3x3 average
+  const float lumaAverage = (2.0f * (lumaN + lumaS + lumaW + lumaE)
+    + lumaNW + lumaNE + lumaSW + lumaSE) / 12.0f;
+  const float subPixel = clamp(abs(lumaAverage - lumaM) / range, 0.0f, 1.0f);
+  const float subPixelSmooth = (-2.0f * subPixel + 3.0f) * subPixel * subPixel;
+  edgeOffset = max(edgeOffset, subPixelSmooth * subPixelSmooth * SUBPIXEL_QUALITY);
+
+  vec2 finalUv = uv;
+  if (horizontal)
+    finalUv.y += edgeOffset * stepLength;
+  else
+    finalUv.x += edgeOffset * stepLength;
+
+  out_fragColor = vec4(textureLod(ldrColor, finalUv, 0).rgb, 1.0f);
+}
@@ -0,0 +1,29 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : require
+
+#include "UniformParams.h"
+#include "gbuffer.glsl"
+
+
+layout(location = 0) out vec2 out_normal;
+layout(location = 1) out vec4 out_albedo;
+
+layout(location = 0) in VS_OUT
+{
+  vec3 wPos;
+  vec3 wNorm;
+  vec3 wTangent;
+  vec2 texCoord;
+} surf;
+
+layout(binding = 0, set = 0) uniform AppData
+{
+  UniformParams params;
+};
+
+void main()
+{
+  out_normal = encode_octahedral(normalize(surf.wNorm));
+  out_albedo = vec4(params.baseColor, pack_roughness_metalness(params.roughness, params.metalness));
+}
@@ -0,0 +1,42 @@
+#ifndef GBUFFER_GLSL_INCLUDED
+#define GBUFFER_GLSL_INCLUDED
+
+// G-buffer layout, 8 bytes per pixel on top of depth:
+//   0: RG16_SNORM, octahedral encoded world space normal
+//   1: RGBA8_UNORM, albedo in rgb, roughness and metalness packed into 4 bits each in alpha
+// World positions are reconstructed from depth.
+
+
+vec2 oct_wrap(vec2 v)
+{
+  return (1.0f - abs(v.yx)) * mix(vec2(-1.0f), vec2(1.0f), greaterThanEqual(v, vec2(0.0f)));
+}
+
+vec2 encode_octahedral(vec3 n)
+{
+  n /= abs(n.x) + abs(n.y) + abs(n.z);
+  return n.z >= 0.0f ? n.xy : oct_wrap(n.xy);
+}
+
+vec3 decode_octahedral(vec2 e)
+{
+  vec3 n = vec3(e, 1.0f - abs(e.x) - abs(e.y));
+  if (n.z < 0.0f)
+    n.xy = oct_wrap(n.xy);
+  return normalize(n);
+}
+
+float pack_roughness_metalness(float roughness, float metalness)
+{
+  const uint r = uint(clamp(roughness, 0.0f, 1.0f) * 15.0f + 0.5f);
+  const uint m = uint(clamp(metalness, 0.0f, 1.0f) * 15.0f + 0.5f);
+  return float((r << 4) | m) / 255.0f;
+}
+
+vec2 unpack_roughness_metalness(float packed)
+{
+  const uint bits = uint(packed * 255.0f + 0.5f);
+  return vec2(bits >> 4, bits & 15u) / 15.0f;
+}
+
+#endif // GBUFFER_GLSL_INCLUDED
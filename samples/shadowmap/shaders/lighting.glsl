@@ -0,0 +1,145 @@
+#ifndef LIGHTING_GLSL_INCLUDED
+#define LIGHTING_GLSL_INCLUDED
+
+#include "UniformParams.h"
+#include "clusters.glsl"
+
+// Lights, shadows and their bindings, shared by forward shading and deferred lighting
+
+// Feature toggles, variants with them switched off are baked at build time
+layout(constant_id = 0) const bool ENABLE_SHADOWS = true;
+layout(constant_id = 1) const bool ANIMATED_LIGHT = true;
+
+
+layout(binding = 0, set = 0) uniform AppData
+{
+  UniformParams params;
+};
+
+layout(binding = 1) uniform sampler2DArray shadowMap;
+layout(binding = 3) uniform sampler2D shadowAtlas;
+
+layout(binding = 4, set = 0) uniform SpotLights
+{
+  SpotLightTable spotLights;
+};
+
+layout(binding = 5, set = 0) uniform Clusters
+{
+  ClusterParams clusterParams;
+};
+
+layout(binding = 6, std430) readonly buffer ClusteredLights
+{
+  ClusteredLight clusteredLights[];
+};
+
+layout(binding = 7, std430) readonly buffer ClusterGrid
+{
+  uvec2 clusters[];
+};
+
+layout(binding = 8, std430) readonly buffer ClusterIndices
+{
+  uint lightIndexCount;
+  uint lightIndices[];
+};
+
+float sample_shadow(vec3 w_pos)
+{
+  // Cascades are sorted by distance, so the first one containing the point has the most detail
+  for (uint i = 0; i < params.cascadeCount; ++i)
+  {
+    const vec4 posLightClipSpace = params.cascadeMatrices[i]*vec4(w_pos, 1.0f);
+
+    // for orto matrix, we don't need perspective division, you can remove it if you want; this is general case;
+    const vec3 posLightSpaceNDC = posLightClipSpace.xyz/posLightClipSpace.w;
+
+    // just shift coords from [-1,1] to [0,1]
+    const vec2 shadowTexCoord = posLightSpaceNDC.xy*0.5f + vec2(0.5f, 0.5f);
+
+    const bool outOfView = (shadowTexCoord.x < 0.0001f || shadowTexCoord.x > 0.9999f || shadowTexCoord.y < 0.0001f || shadowTexCoord.y > 0.9999f || posLightSpaceNDC.z > 1.0f);
+    if (outOfView)
+      continue;
+
+    return posLightSpaceNDC.z < textureLod(shadowMap, vec3(shadowTexCoord, i), 0).x + 0.001f ? 1.0f : 0.0f;
+  }
+
+  // Beyond the last cascade nothing is shadowed
+  return 1.0f;
+}
+
+float sample_spot_shadow(SpotLightData light, vec3 w_pos)
+{
+  if (!ENABLE_SHADOWS || light.atlasRect.z == 0.0f)
+    return 1.0f;
+
+  const vec4 posLightClipSpace = light.viewProj*vec4(w_pos, 1.0f);
+  const vec3 posLightSpaceNDC = posLightClipSpace.xyz/posLightClipSpace.w;
+  const vec2 tileTexCoord = posLightSpaceNDC.xy*0.5f + vec2(0.5f, 0.5f);
+
+  if (any(lessThan(tileTexCoord, vec2(0.0f))) || any(greaterThan(tileTexCoord, vec2(1.0f))) || posLightSpaceNDC.z > 1.0f)
+    return 1.0f;
+
+  // Keep filtering from picking up texels of neighbouring tiles
+  const vec2 halfTexel = 0.5f / vec2(textureSize(shadowAtlas, 0));
+  const vec2 atlasTexCoord = clamp(
+    light.atlasRect.xy + tileTexCoord*light.atlasRect.zw,
+    light.atlasRect.xy + halfTexel,
+    light.atlasRect.xy + light.atlasRect.zw - halfTexel);
+
+  return posLightSpaceNDC.z < textureLod(shadowAtlas, atlasTexCoord, 0).x + 0.0005f ? 1.0f : 0.0f;
+}
+
+vec3 spot_lights(vec3 w_pos, vec3 w_norm)
+{
+  vec3 result = vec3(0.0f);
+  for (uint i = 0; i < spotLights.count; ++i)
+  {
+    const SpotLightData light = spotLights.lights[i];
+
+    const vec3 radiance = spot_light_radiance(
+      light.position, light.range, light.direction, light.cosOuterAngle, light.cosInnerAngle,
+      light.color, w_pos, w_norm);
+    if (all(equal(radiance, vec3(0.0f))))
+      continue;
+
+    result += radiance * sample_spot_shadow(light, w_pos);
+  }
+  return result;
+}
+
+vec3 clustered_lights(vec3 w_pos, vec3 w_norm)
+{
+  const float viewDepth = (clusterParams.view * vec4(w_pos, 1.0f)).z;
+  const uvec2 cluster = clusters[cluster_index(clusterParams, gl_FragCoord.xy, viewDepth)];
+
+  vec3 result = vec3(0.0f);
+  for (uint i = 0; i < cluster.y; ++i)
+  {
+    const ClusteredLight light = clusteredLights[lightIndices[cluster.x + i]];
+    result += spot_light_radiance(
+      light.position, light.range, light.direction, light.cosOuterAngle, light.cosInnerAngle,
+      light.color, w_pos, w_norm);
+  }
+  return result;
+}
+
+// Light formula is pretty arbitrary and most definitely wrong
+vec3 shade_surface(vec3 w_pos, vec3 w_norm, vec3 albedo)
+{
+  const float shadow = ENABLE_SHADOWS ? sample_shadow(w_pos) : 1.0f;
+
+  const vec3 dark_violet = vec3(0.59f, 0.0f, 0.82f);
+  const vec3 chartreuse  = vec3(0.5f, 1.0f, 0.0f);
+
+  const vec3 lightColor1 = ANIMATED_LIGHT ? mix(dark_violet, chartreuse, abs(sin(params.time))) : chartreuse;
+
+  const vec3 lightDir   = normalize(params.lightPos - w_pos);
+  const vec3 lightColor = max(dot(w_norm, lightDir), 0.0f) * lightColor1;
+  const float ambient = 0.05;
+  const vec3 localLights = spot_lights(w_pos, w_norm) + clustered_lights(w_pos, w_norm);
+  return (lightColor * shadow + ambient + localLights) * albedo;
+}
+
+#endif // LIGHTING_GLSL_INCLUDED
@@ -3,18 +3,31 @@
 #extension GL_GOOGLE_include_directive : require
 
 #include "unpack_attributes.glsl"
+#include "scene_instances.glsl"
 
+// NOTE: DEPTH_ONLY builds a position-only variant for passes that don't shade anything,
+// it is fed with the tightly packed position stream of SceneManager
 
+
+#ifdef DEPTH_ONLY
+layout(location = 0) in vec3 vPos;
+#else
 layout(location = 0) in vec4 vPosNorm;
 layout(location = 1) in vec4 vTexCoordAndTang;
+#endif
 
 layout(push_constant) uniform params_t
 {
   mat4 mProjView;
-  mat4 mModel;
 } params;
 
+layout(binding = 2, std430) readonly buffer instances_t
+{
+  InstanceData instances[];
+};
+
 
+#ifndef DEPTH_ONLY
 layout (location = 0 ) out VS_OUT
 {
   vec3 wPos;
@@ -22,17 +35,27 @@ layout (location = 0 ) out VS_OUT
   vec3 wTangent;
   vec2 texCoord;
 } vOut;
+#endif
 
-out gl_PerVertex { vec4 gl_Position; };
+// Depth of the prepass has to match the depth of the color pass exactly for the EQUAL test,
+// so both variants compute the position with the same expression
+out gl_PerVertex { invariant vec4 gl_Position; };
 void main(void)
 {
+  const InstanceData instance = instances[gl_InstanceIndex];
+
+#ifdef DEPTH_ONLY
+  gl_Position = params.mProjView * (instance.model * vec4(vPos, 1.0f));
+#else
   const vec4 wNorm = vec4(decode_normal(floatBitsToInt(vPosNorm.w)),     0.0f);
   const vec4 wTang = vec4(decode_normal(floatBitsToInt(vTexCoordAndTang.z)), 0.0f);
 
-  vOut.wPos = (params.mModel * vec4(vPosNorm.xyz, 1.0f)).xyz;
-  vOut.wNorm = normalize(mat3(transpose(inverse(params.mModel))) * wNorm.xyz);
-  vOut.wTangent = normalize(mat3(transpose(inverse(params.mModel))) * wTang.xyz);
+  const vec4 wPos = instance.model * vec4(vPosNorm.xyz, 1.0f);
+  vOut.wPos = wPos.xyz;
+  vOut.wNorm = normalize(mat3(instance.normalMatrix) * wNorm.xyz);
+  vOut.wTangent = normalize(mat3(instance.model) * wTang.xyz);
   vOut.texCoord = vTexCoordAndTang.xy;
 
-  gl_Position   = params.mProjView * vec4(vOut.wPos, 1.0);
+  gl_Position = params.mProjView * wPos;
+#endif
 }
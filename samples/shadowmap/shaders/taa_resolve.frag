@@ -0,0 +1,71 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : require
+
+#include "UniformParams.h"
+
+// Blends the jittered current frame into the history reprojected with camera motion.
+// The scene is static, so camera motion is all the motion there is.
+// History stores view depth in alpha, a mismatch with the reprojected depth means
+// the history pixel belongs to a different surface and is thrown away.
+
+
+layout(location = 0) out vec4 out_history;
+
+layout(binding = 0) uniform Params
+{
+  TaaParams params;
+};
+
+layout(binding = 1) uniform sampler2D currentColor;
+layout(binding = 2) uniform sampler2D currentDepth;
+layout(binding = 3) uniform sampler2D history;
+
+void main()
+{
+  const ivec2 texel = ivec2(gl_FragCoord.xy);
+  const vec3 current = texelFetch(currentColor, texel, 0).rgb;
+  const float depth = texelFetch(currentDepth, texel, 0).x;
+
+  const vec2 ndc = gl_FragCoord.xy / params.resolution * 2.0f - 1.0f;
+  const vec4 wPos = params.invViewProj * vec4(ndc, depth, 1.0f);
+  const vec4 prevClip = params.prevViewProj * vec4(wPos.xyz / wPos.w, 1.0f);
+  const vec2 prevUv = (prevClip.xy / prevClip.w) * 0.5f + 0.5f;
+  // Unprojecting divides everything by clip w, which is view depth
+  const float viewDepth = 1.0f / wPos.w;
+
+  // Neighbourhood of the current frame bounds what history may look like
+  const ivec2 maxTexel = ivec2(params.resolution) - 1;
+  vec3 minColor = current;
+  vec3 maxColor = current;
+  for (int y = -1; y <= 1; ++y)
+    for (int x = -1; x <= 1; ++x)
+    {
+      const ivec2 neighbourTexel = clamp(texel + ivec2(x, y), ivec2(0), maxTexel);
+      const vec3 neighbour = texelFetch(currentColor, neighbourTexel, 0).rgb;
+      minColor = min(minColor, neighbour);
+      maxColor = max(maxColor, neighbour);
+    }
+
+  const bool valid = params.resetHistory == 0
+    && all(greaterThanEqual(prevUv, vec2(0.0f))) && all(lessThanEqual(prevUv, vec2(1.0f)))
+    && prevClip.w > 0.0f;
+
+  vec3 result = current;
+  if (valid)
+  {
+    // Previous frame may have been rendered at a different scale, filtering must not
+    // pick up anything beyond the part it covered
+    const vec2 historySize = vec2(textureSize(history, 0));
+    const vec2 historyUv =
+      min(prevUv * params.historyUvScale, params.historyUvScale - 0.5f / historySize);
+    const vec4 prev = textureLod(history, historyUv, 0);
+    // Nothing to reject against for the background
+    const bool sameSurface =
+      depth >= 1.0f || abs(prev.a - prevClip.w) <= params.depthTolerance * prevClip.w;
+    if (sameSurface)
+      result = mix(clamp(prev.rgb, minColor, maxColor), current, params.feedback);
+  }
+
+  out_history = vec4(result, depth >= 1.0f ? 0.0f : viewDepth);
+}
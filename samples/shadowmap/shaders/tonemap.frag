@@ -0,0 +1,27 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// Applies exposure to the HDR image and maps it into the displayable range
+
+
+layout(location = 0) out vec4 out_fragColor;
+
+layout(binding = 0) uniform sampler2D hdrColor;
+
+layout(binding = 1, std430) readonly buffer Exposure
+{
+  float adaptedLuminance;
+  float exposure;
+};
+
+// Fit of the ACES filmic curve by Krzysztof Narkowicz
+vec3 aces_filmic(vec3 x)
+{
+  return clamp((x*(2.51f*x + 0.03f)) / (x*(2.43f*x + 0.59f) + 0.14f), 0.0f, 1.0f);
+}
+
+void main()
+{
+  const vec3 color = texelFetch(hdrColor, ivec2(gl_FragCoord.xy), 0).rgb;
+  out_fragColor = vec4(aces_filmic(color * exposure), 1.0f);
+}
@@ -0,0 +1,59 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : require
+
+#include "UniformParams.h"
+
+// Stretches the rendered part of the source over the whole output with a Catmull-Rom filter.
+// Its 16 taps are folded into 9 bilinear ones, the result is a lot sharper than
+// plain bilinear upscaling at the same resolution.
+
+
+layout(location = 0) out vec4 out_fragColor;
+
+layout(binding = 0) uniform Params
+{
+  UpscaleParams params;
+};
+
+layout(binding = 1) uniform sampler2D source;
+
+void main()
+{
+  // Output and source are of the same size, only a part of the source is rendered into
+  const vec2 samplePos = gl_FragCoord.xy * params.sourceUvScale;
+  const vec2 texPos1 = floor(samplePos - 0.5f) + 0.5f;
+  const vec2 f = samplePos - texPos1;
+
+  const vec2 w0 = f * (-0.5f + f * (1.0f - 0.5f * f));
+  const vec2 w1 = 1.0f + f * f * (-2.5f + 1.5f * f);
+  const vec2 w2 = f * (0.5f + f * (2.0f - 1.5f * f));
+  const vec2 w3 = f * f * (-0.5f + 0.5f * f);
+
+  // The middle two taps are merged into a single bilinear fetch between them
+  const vec2 w12 = w1 + w2;
+  const vec2 offset12 = w2 / w12;
+
+  // Texels beyond the rendered part hold whatever an earlier frame left in there
+  const vec2 minPos = vec2(0.5f);
+  const vec2 maxPos = params.sourceUvScale * params.sourceSize - 0.5f;
+  const vec2 uv0 = clamp(texPos1 - 1.0f, minPos, maxPos) / params.sourceSize;
+  const vec2 uv12 = clamp(texPos1 + offset12, minPos, maxPos) / params.sourceSize;
+  const vec2 uv3 = clamp(texPos1 + 2.0f, minPos, maxPos) / params.sourceSize;
+
+  vec3 result = vec3(0.0f);
+  result += textureLod(source, vec2(uv0.x, uv0.y), 0).rgb * w0.x * w0.y;
+  result += textureLod(source, vec2(uv12.x, uv0.y), 0).rgb * w12.x * w0.y;
+  result += textureLod(source, vec2(uv3.x, uv0.y), 0).rgb * w3.x * w0.y;
+
+  result += textureLod(source, vec2(uv0.x, uv12.y), 0).rgb * w0.x * w12.y;
+  result += textureLod(source, vec2(uv12.x, uv12.y), 0).rgb * w12.x * w12.y;
+  result += textureLod(source, vec2(uv3.x, uv12.y), 0).rgb * w3.x * w12.y;
+
+  result += textureLod(source, vec2(uv0.x, uv3.y), 0).rgb * w0.x * w3.y;
+  result += textureLod(source, vec2(uv12.x, uv3.y), 0).rgb * w12.x * w3.y;
+  result += textureLod(source, vec2(uv3.x, uv3.y), 0).rgb * w3.x * w3.y;
+
+  // Negative lobes of the filter overshoot next to sharp edges
+  out_fragColor = vec4(max(result, vec3(0.0f)), 1.0f);
+}
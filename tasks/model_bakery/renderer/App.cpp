@@ -1,23 +1,36 @@
 #include "App.hpp"
 
+#include <spdlog/spdlog.h>
 #include <tracy/Tracy.hpp>
 
 
-App::App()
+App::App(const HeadlessOptions& headless_options)
+  : headless{headless_options}
 {
   glm::uvec2 initialRes = {1280, 720};
-  mainWindow = windowing.createWindow(OsWindow::CreateInfo{
-    .resolution = initialRes,
-  });
 
   renderer.reset(new Renderer(initialRes));
 
-  auto instExts = windowing.getRequiredVulkanInstanceExtensions();
-  renderer->initVulkan(instExts);
+  if (headless.enabled)
+  {
+    renderer->initVulkan({}, true);
+    renderer->initHeadlessFrameDelivery(headless);
+  }
+  else
+  {
+    windowing = std::make_unique<OsWindowingManager>();
+    mainWindow = windowing->createWindow(OsWindow::CreateInfo{
+      .resolution = initialRes,
+    });
+
+    auto instExts = windowing->getRequiredVulkanInstanceExtensions();
+    renderer->initVulkan(instExts);
 
-  auto surface = mainWindow->createVkSurface(etna::get_context().getInstance());
+    auto surface = mainWindow->createVkSurface(etna::get_context().getInstance());
 
-  renderer->initFrameDelivery(std::move(surface), [this]() { return mainWindow->getResolution(); });
+    renderer->initFrameDelivery(
+      std::move(surface), [this]() { return mainWindow->getResolution(); });
+  }
 
   mainCam.lookAt({0, 10, 10}, {0, 0, 0}, {0, 1, 0});
 
@@ -26,14 +39,20 @@ App::App()
 
 void App::run()
 {
-  double lastTime = windowing.getTime();
+  if (headless.enabled)
+  {
+    runHeadless();
+    return;
+  }
+
+  double lastTime = windowing->getTime();
   while (!mainWindow->isBeingClosed())
   {
-    const double currTime = windowing.getTime();
+    const double currTime = windowing->getTime();
     const float diffTime = static_cast<float>(currTime - lastTime);
     lastTime = currTime;
 
-    windowing.poll();
+    windowing->poll();
 
     processInput(diffTime);
 
@@ -43,6 +62,20 @@ void App::run()
   }
 }
 
+void App::runHeadless()
+{
+  for (std::uint32_t i = 0; i < headless.frameCount; ++i)
+  {
+    headlessTime = i * static_cast<double>(headless.timeStep);
+
+    drawFrame();
+
+    FrameMark;
+  }
+
+  spdlog::info("Rendered {} frames headless", headless.frameCount);
+}
+
 void App::processInput(float dt)
 {
   ZoneScoped;
@@ -71,11 +104,16 @@ void App::drawFrame()
 
   renderer->update(FramePacket{
     .mainCam = mainCam,
-    .currentTime = static_cast<float>(windowing.getTime()),
+    .currentTime = getTime(),
   });
   renderer->drawFrame();
 }
 
+float App::getTime() const
+{
+  return static_cast<float>(windowing ? windowing->getTime() : headlessTime);
+}
+
 void App::moveCam(Camera& cam, const Keyboard& kb, float dt)
 {
   // Move position of camera based on WASD keys, and FR keys for up and down
@@ -2,6 +2,7 @@
 
 #include "wsi/OsWindowingManager.hpp"
 #include "scene/Camera.hpp"
+#include "render_utils/HeadlessOptions.hpp"
 
 #include "Renderer.hpp"
 
@@ -9,19 +10,25 @@
 class App
 {
 public:
-  App();
+  explicit App(const HeadlessOptions& headless_options = {});
 
   void run();
 
 private:
+  void runHeadless();
   void processInput(float dt);
   void drawFrame();
+  float getTime() const;
 
   void moveCam(Camera& cam, const Keyboard& kb, float dt);
   void rotateCam(Camera& cam, const Mouse& ms, float dt);
 
 private:
-  OsWindowingManager windowing;
+  HeadlessOptions headless;
+  double headlessTime = 0;
+
+  // Both are null in headless mode
+  std::unique_ptr<OsWindowingManager> windowing;
   std::unique_ptr<OsWindow> mainWindow;
 
   float camMoveSpeed = 1;
@@ -12,7 +12,7 @@ Renderer::Renderer(glm::uvec2 res)
 {
 }
 
-void Renderer::initVulkan(std::span<const char*> instance_extensions)
+void Renderer::initVulkan(std::span<const char*> instance_extensions, bool headless)
 {
   std::vector<const char*> instanceExtensions;
 
@@ -21,7 +21,8 @@ void Renderer::initVulkan(std::span<const char*> instance_extensions)
 
   std::vector<const char*> deviceExtensions;
 
-  deviceExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+  if (!headless)
+    deviceExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
 
   etna::initialize(etna::InitParams{
     .applicationName = "model_bakery_renderer",
@@ -60,6 +61,25 @@ void Renderer::initFrameDelivery(vk::UniqueSurfaceKHR a_surface, ResolutionProvi
   worldRenderer->setupPipelines(window->getCurrentFormat());
 }
 
+void Renderer::initHeadlessFrameDelivery(const HeadlessOptions& options)
+{
+  commandManager = etna::get_context().createPerFrameCmdMgr();
+
+  threadPool = std::make_unique<ThreadPool>();
+
+  offscreenTarget = std::make_unique<OffscreenTarget>(OffscreenTarget::CreateInfo{
+    .resolution = resolution,
+    .dumpDir = options.dumpDir,
+    .threadPool = threadPool.get(),
+  });
+
+  worldRenderer = std::make_unique<WorldRenderer>();
+
+  worldRenderer->allocateResources(resolution);
+  worldRenderer->loadShaders();
+  worldRenderer->setupPipelines(offscreenTarget->getFormat());
+}
+
 void Renderer::loadScene(std::filesystem::path path)
 {
   worldRenderer->loadScene(path);
@@ -93,6 +113,12 @@ void Renderer::drawFrame()
 {
   ZoneScoped;
 
+  if (offscreenTarget)
+  {
+    drawOffscreenFrame();
+    return;
+  }
+
   auto currentCmdBuf = commandManager->acquireNext();
 
   etna::begin_frame();
@@ -143,7 +169,37 @@ void Renderer::drawFrame()
   etna::end_frame();
 }
 
+void Renderer::drawOffscreenFrame()
+{
+  auto currentCmdBuf = commandManager->acquireNext();
+
+  etna::begin_frame();
+
+  auto [image, view, availableSem] = offscreenTarget->acquireNext();
+
+  ETNA_CHECK_VK_RESULT(currentCmdBuf.begin(vk::CommandBufferBeginInfo{}));
+  {
+    ETNA_PROFILE_GPU(currentCmdBuf, renderFrame);
+
+    worldRenderer->renderWorld(currentCmdBuf, image, view);
+
+    offscreenTarget->recordReadback(currentCmdBuf);
+
+    ETNA_READ_BACK_GPU_PROFILING(currentCmdBuf);
+  }
+  ETNA_CHECK_VK_RESULT(currentCmdBuf.end());
+
+  auto renderingDone = commandManager->submit(std::move(currentCmdBuf), availableSem);
+
+  offscreenTarget->present(renderingDone);
+
+  etna::end_frame();
+}
+
 Renderer::~Renderer()
 {
   ETNA_CHECK_VK_RESULT(etna::get_context().getDevice().waitIdle());
+
+  if (offscreenTarget)
+    offscreenTarget->finish();
 }
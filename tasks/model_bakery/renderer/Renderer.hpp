@@ -6,6 +6,9 @@
 #include <function2/function2.hpp>
 
 #include "wsi/Keyboard.hpp"
+#include "threading/ThreadPool.hpp"
+#include "render_utils/HeadlessOptions.hpp"
+#include "render_utils/OffscreenTarget.hpp"
 
 #include "FramePacket.hpp"
 #include "WorldRenderer.hpp"
@@ -19,8 +22,9 @@ public:
   explicit Renderer(glm::uvec2 resolution);
   ~Renderer();
 
-  void initVulkan(std::span<const char*> instance_extensions);
+  void initVulkan(std::span<const char*> instance_extensions, bool headless = false);
   void initFrameDelivery(vk::UniqueSurfaceKHR surface, ResolutionProvider res_provider);
+  void initHeadlessFrameDelivery(const HeadlessOptions& options);
   void recreateSwapchain(glm::uvec2 res);
   void loadScene(std::filesystem::path path);
 
@@ -28,10 +32,16 @@ public:
   void update(const FramePacket& packet);
   void drawFrame();
 
+private:
+  void drawOffscreenFrame();
+
 private:
   ResolutionProvider resolutionProvider;
 
   std::unique_ptr<etna::Window> window;
+  // Used instead of the window in headless mode, PNG encoding runs on the pool
+  std::unique_ptr<ThreadPool> threadPool;
+  std::unique_ptr<OffscreenTarget> offscreenTarget;
   std::unique_ptr<etna::PerFrameCmdMgr> commandManager;
 
   glm::uvec2 resolution;
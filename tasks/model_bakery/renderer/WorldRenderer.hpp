@@ -43,8 +43,7 @@ private:
   struct PushConstants
   {
     glm::mat4x4 projView;
-    glm::mat4x4 model;
-  } pushConst2M;
+  } pushConst;
 
   glm::mat4x4 worldViewProj;
   glm::mat4x4 lightMatrix;